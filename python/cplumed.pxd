@@ -27,11 +27,18 @@ from libcpp cimport bool
 
 # Some of these functions are noexcept.
 # We anyway use except + in case this changes later.
+cdef extern from "Plumed.h":
+     ctypedef struct plumed_cmd_handle:
+         pass
+
 cdef extern from "Plumed.h" namespace "PLMD":
      cdef cppclass Plumed:
          Plumed() except +
          void cmd(const char*key, const void*val) except +
          void cmd(const char*key) except +
+         plumed_cmd_handle resolve(const char*key) except +
+         # overload of cmd, renamed to avoid ambiguities when passing python objects as keys
+         void cmd_resolved "cmd"(const plumed_cmd_handle&h, const void*val) except +
          bool valid() except +
          @staticmethod
          Plumed dlopen(const char*path) except +
@@ -45,6 +45,17 @@ try:
 except ImportError:
      HAS_NUMPY=False
 
+cdef class CmdHandle:
+     """ Handle to a command resolved with Plumed.resolve().
+
+         It can be passed to Plumed.cmd() in place of the command name,
+         so that the command is executed without any string parsing within PLUMED.
+     """
+     cdef cplumed.plumed_cmd_handle c_handle
+     # PLUMED does not copy the key, so we keep a reference here
+     cdef bytes py_key
+     cdef readonly str key
+
 cdef class Plumed:
      cdef cplumed.Plumed c_plumed
      def __cinit__(self,kernel=None):
@@ -90,47 +101,80 @@ cdef class Plumed:
      def cmd_ndarray_int(self, ckey, val):
          cdef long [:] abuffer = val.ravel()
          self.c_plumed.cmd( ckey, <void*>&abuffer[0])
-     cdef cmd_float(self, ckey, double val ):
-         self.c_plumed.cmd( ckey, <void*>&val )
-     cdef cmd_int(self, ckey, int val):
-         self.c_plumed.cmd( ckey, <void*>&val)
+     def resolve(self, key):
+         """ Resolve a command once, so that it can be executed many times.
+
+             Returns a CmdHandle that can be passed to cmd() in place of key.
+             This is useful for commands called at every step, e.g.:
+             ````
+             setPositions=p.resolve("setPositions")
+             for step in range(nsteps):
+                 p.cmd(setPositions,pos)
+             ````
+         """
+         cdef CmdHandle h = CmdHandle()
+         h.key = key
+         h.py_key = key.encode()
+         h.c_handle = self.c_plumed.resolve(h.py_key)
+         return h
      def cmd( self, key, val=None ):
-         cdef bytes py_bytes = key.encode()
-         cdef char* ckey = py_bytes
+         cdef CmdHandle handle = None
+         cdef bytes py_bytes
+         cdef bytes py_val
+         cdef char* ckey = NULL
          cdef char* cval
          cdef array.array ar
+         cdef double dval
+         cdef int ival
+         cdef double [:] dbuffer
+         cdef long [:] lbuffer
+         cdef void* ptr = NULL
+         if isinstance(key, CmdHandle):
+            handle = key
+            key = handle.key
+         else:
+            py_bytes = key.encode()
+            ckey = py_bytes
          if val is None :
-            self.c_plumed.cmd( ckey, NULL )
+            ptr = NULL
          elif isinstance(val, (int,long) ):
             if key=="getDataRank" :
                raise ValueError("when using cmd with getDataRank option value must a size one ndarray")
-            self.cmd_int(ckey, val)
+            ival = val
+            ptr = <void*>&ival
          elif isinstance(val, float ) :
             if key=="getBias" :
                raise ValueError("when using cmd with getBias option value must be a size one ndarray")
-            self.cmd_float(ckey, val)
+            dval = val
+            ptr = <void*>&dval
          elif HAS_NUMPY and isinstance(val, np.ndarray) :
             if( val.dtype=="float64" ):
-               self.cmd_ndarray_real(ckey, val)
+               dbuffer = val.ravel()
+               ptr = <void*>&dbuffer[0]
             elif( val.dtype=="int64" ) :
-               self.cmd_ndarray_int(ckey, val)
+               lbuffer = val.ravel()
+               ptr = <void*>&lbuffer[0]
             else :
                raise ValueError("ndarrys should be float64 or int64")
          elif isinstance(val, array.array) :
             if( (val.typecode=="d" or val.typecode=="f") and val.itemsize==8):
                ar = val
-               self.c_plumed.cmd( ckey, <void*> ar.data.as_voidptr)
+               ptr = <void*> ar.data.as_voidptr
             elif( (val.typecode=="i" or val.typecode=="I") ) :
                ar = val
-               self.c_plumed.cmd( ckey, <void*> ar.data.as_voidptr)
+               ptr = <void*> ar.data.as_voidptr
             else :
                raise ValueError("ndarrays should be double (size=8) or int")
          elif isinstance(val, str ) :
-              py_bytes = val.encode()
-              cval = py_bytes
-              self.c_plumed.cmd( ckey, <void*>cval )
+              py_val = val.encode()
+              cval = py_val
+              ptr = <void*>cval
          else :
             raise ValueError("Unknown value type ({})".format(str(type(val))))
+         if handle is None :
+            self.c_plumed.cmd( ckey, ptr )
+         else :
+            self.c_plumed.cmd_resolved( handle.c_handle, ptr )
 
 
 class FormatError(Exception):
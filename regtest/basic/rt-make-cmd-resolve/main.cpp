@@ -0,0 +1,80 @@
+#include "plumed/wrapper/Plumed.h"
+#include "plumed/tools/Exception.h"
+#include <fstream>
+#include <vector>
+
+// This test checks that commands resolved once and executed many times
+// give the same result as the usual string-based cmd()
+
+void testmecpp(PLMD::Plumed p,const std::string & file){
+  int natoms=10;
+  std::vector<double> positions(3*natoms,0.0);
+  std::vector<double> masses(natoms,1.0);
+  std::vector<double> forces(3*natoms,0.0);
+  std::vector<double> virial(9,0.0);
+  for(unsigned i=0;i<positions.size();i++) positions[i]=0.1*i;
+
+  const PLMD::Plumed::CmdHandle setStep=p.resolve("setStep");
+  const PLMD::Plumed::CmdHandle setPositions=p.resolve("setPositions");
+  const PLMD::Plumed::CmdHandle setMasses=p.resolve("setMasses");
+  const PLMD::Plumed::CmdHandle setForces=p.resolve("setForces");
+  const PLMD::Plumed::CmdHandle setVirial=p.resolve("setVirial");
+  const PLMD::Plumed::CmdHandle calc=p.resolve("calc");
+  const PLMD::Plumed::CmdHandle readInputLine=p.resolve("readInputLine");
+  if(setStep.index<0 || calc.index<0) plumed_error();
+
+  p.cmd("setNatoms",&natoms);
+  p.cmd("init");
+  p.cmd(readInputLine,"d: DISTANCE ATOMS=1,2");
+  p.cmd(readInputLine,("PRINT ARG=d FILE="+file).c_str());
+  for(int step=0;step<5;step++){
+    positions[0]+=0.1;
+    p.cmd(setStep,&step);
+    p.cmd(setPositions,&positions[0]);
+    p.cmd(setMasses,&masses[0]);
+    p.cmd(setForces,&forces[0]);
+    p.cmd(setVirial,&virial[0]);
+    p.cmd(calc);
+  }
+}
+
+int main(){
+  std::ofstream of("finished");
+
+  {
+    PLMD::Plumed p;
+    testmecpp(p,"COLVAR");
+  }
+
+// errors raised through a resolved command should be rethrown
+  {
+    PLMD::Plumed p;
+    const PLMD::Plumed::CmdHandle setStep=p.resolve("setStep");
+    try {
+      p.cmd(setStep,NULL);
+      plumed_error();
+    } catch(PLMD::Plumed::ExceptionError & e) {
+      of<<"caught exception\n";
+    }
+  }
+
+// C interface, including a command that cannot be resolved
+  {
+    plumed p=plumed_create();
+    plumed_cmd_handle h=plumed_cmd_resolve(p,"GREX init");
+    if(h.index>=0) plumed_error();
+// commands that read further words cannot be resolved either
+    if(plumed_cmd_resolve(p,"GREX").index>=0) plumed_error();
+    if(plumed_cmd_resolve(p,"CLTool").index>=0) plumed_error();
+    if(plumed_cmd_resolve(p,"checkAction").index>=0) plumed_error();
+    int natoms=10;
+    plumed_cmd_handle setNatoms=plumed_cmd_resolve(p,"setNatoms");
+    if(setNatoms.index<0) plumed_error();
+    plumed_cmd_resolved(p,setNatoms,&natoms);
+    plumed_cmd(p,"init",NULL);
+    plumed_finalize(p);
+  }
+
+  of<<"finished\n";
+  return 0;
+}
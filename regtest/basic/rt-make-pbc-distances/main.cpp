@@ -0,0 +1,80 @@
+#include "plumed/tools/Pbc.h"
+#include "plumed/tools/Random.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+using namespace PLMD;
+
+// check that batched distances are identical to those computed one pair at a time
+int run(int boxtype){
+  Random r;
+  int failures=0;
+  r.setSeed(-20);
+  int nbox=200;
+  int npos=50;
+  int npairs=300;
+  for(int i=0;i<nbox;i++){
+    Tensor box;
+    for(int j=0;j<3;j++) for(int k=0;k<3;k++) if(r.U01()>0.2){
+      box[j][k]=2.0*r.U01()-1.0;
+    }
+    switch(boxtype){
+      case 0:
+// no pbc
+        box.zero();
+        break;
+      case 1:
+// orthorombic
+        for(int j=0;j<3;j++) for(int k=0;k<3;k++) if(j!=k) box[j][k]=0.0;
+        for(int j=0;j<3;j++) box[j][j]=1.0+r.U01();
+        break;
+      default:
+// triclinic
+        break;
+    }
+    Pbc pbc;
+    pbc.setBox(box);
+
+    std::vector<Vector> pos(npos);
+    for(auto & p : pos) {
+      p=Vector(r.U01()-0.5,r.U01()-0.5,r.U01()-0.5);
+      p*=5;
+    }
+    std::vector<unsigned> i1(npairs),i2(npairs);
+    std::vector<Vector> v1(npairs),v2(npairs);
+    for(int j=0;j<npairs;j++){
+      i1[j]=r.U01()*npos;
+      i2[j]=r.U01()*npos;
+      v1[j]=pos[i1[j]];
+      v2[j]=pos[i2[j]];
+    }
+
+    std::vector<Vector> d(npairs),dind(npairs);
+    pbc.distances(v1.data(),v2.data(),npairs,d.data());
+    pbc.distances(pos.data(),i1.data(),i2.data(),npairs,dind.data());
+
+    std::vector<Vector> dapply(npairs);
+    for(int j=0;j<npairs;j++) dapply[j]=delta(v1[j],v2[j]);
+    pbc.apply(dapply);
+
+    for(int j=0;j<npairs;j++){
+      Vector ref=pbc.distance(v1[j],v2[j]);
+      for(int k=0;k<3;k++) {
+        if(d[j][k]!=ref[k]) failures++;
+        if(dind[j][k]!=ref[k]) failures++;
+        if(dapply[j][k]!=ref[k]) failures++;
+      }
+    }
+  }
+  return failures;
+}
+
+int main(){
+  std::ofstream ofs("logfile");
+  for(int type=0;type<3;type++){
+    ofs<<"Box type "<<type<<"\n";
+    ofs<<"Failures "<<run(type)<<"\n\n";
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include "plumed/tools/SwitchingFunction.h"
+#include "plumed/tools/OFile.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// lepton switching functions evaluated on arrays of distances
+// must be identical to those evaluated one distance at a time
+int main () {
+  const std::vector<std::string> definitions {
+// function of x
+    "CUSTOM FUNC=1/(1+x^6) R_0=0.3",
+// function of x2 only
+    "CUSTOM FUNC=1/(1+x2^3) R_0=0.3",
+// with d0>0, distances below d0 are not passed to lepton
+    "CUSTOM FUNC=1/(1+x^6) R_0=0.3 D_0=0.1",
+// with d_max, stretched
+    "CUSTOM FUNC=exp(-x) R_0=0.2 D_0=0.05 D_MAX=0.8",
+    "CUSTOM FUNC=exp(-x2) R_0=0.2 D_MAX=0.8 NOSTRETCH"
+  };
+
+  std::vector<double> distance2;
+  for(unsigned i=0; i<100; i++) {
+    const double d=0.01+0.011*i;
+    distance2.push_back(d*d);
+  }
+  const unsigned n=distance2.size();
+
+  OFile out;
+  out.open("output");
+  for(const auto & def : definitions) {
+    SwitchingFunction sf;
+    std::string errors;
+    sf.set(def,errors);
+    if(errors.length()>0) {
+      out<<def<<" : "<<errors<<"\n";
+      continue;
+    }
+    std::vector<double> result(n),dfunc(n);
+    sf.calculateSqr(distance2.data(),result.data(),dfunc.data(),n);
+    unsigned nonzero=0,different=0;
+    for(unsigned k=0; k<n; k++) {
+      double df;
+      const double f=sf.calculateSqr(distance2[k],df);
+      if(f!=0.0) nonzero++;
+      if(std::fabs(f-result[k])>1e-12 || std::fabs(df-dfunc[k])>1e-12) different++;
+    }
+    out<<def<<" : "<<nonzero<<" non zero values, "<<different<<" different\n";
+  }
+  out.close();
+  return 0;
+}
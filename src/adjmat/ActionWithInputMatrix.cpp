@@ -85,12 +85,18 @@ double ActionWithInputMatrix::retrieveConnectionValue( const unsigned& i, const
   return vals[0]*vals[1];       // (mymatrix->function)->transformStoredValues( vals, vi, df );
 }
 
+double ActionWithInputMatrix::retrieveStoredConnectionValue( const unsigned& istore, std::vector<double>& vals ) const {
+  mymatrix->retrieveSequentialValue( istore, false, vals );
+  return vals[0]*vals[1];
+}
+
 void ActionWithInputMatrix::getInputData( const unsigned& ind, const bool& normed, const multicolvar::AtomValuePack& myatoms, std::vector<double>& orient0 ) const {
   if( (mymatrix->function)->mybasemulticolvars.size()==0  ) {
     std::vector<double> tvals( mymatrix->getNumberOfComponents() ); orient0.assign(orient0.size(),0);
-    for(unsigned i=0; i<mymatrix->getNumberOfColumns(); ++i) {
-      if( mymatrix->undirectedGraph() && ind==i ) continue;
-      orient0[1]+=retrieveConnectionValue( ind, i, tvals );
+    // Only the non-zero elements in the row are visited
+    for(unsigned k=0; k<mymatrix->getNumberOfElementsInRow(ind); ++k) {
+      unsigned i, istore; mymatrix->getElementInRow( ind, k, i, istore );
+      orient0[1]+=retrieveStoredConnectionValue( istore, tvals );
     }
     orient0[0]=1.0; return;
   }
@@ -108,6 +114,14 @@ void ActionWithInputMatrix::addConnectionDerivatives( const unsigned& i, const u
   }
 }
 
+void ActionWithInputMatrix::addStoredConnectionDerivatives( const unsigned& istore, MultiValue& myvals, MultiValue& myvout ) const {
+  mymatrix->retrieveSequentialDerivatives( istore, false, myvals );
+  for(unsigned jd=0; jd<myvals.getNumberActive(); ++jd) {
+    unsigned ider=myvals.getActiveIndex(jd);
+    myvout.addDerivative( 1, ider, myvals.getDerivative( 1, ider ) );
+  }
+}
+
 MultiValue& ActionWithInputMatrix::getInputDerivatives( const unsigned& ind, const bool& normed, const multicolvar::AtomValuePack& myatoms ) const {
   if( (mymatrix->function)->mybasemulticolvars.size()==0  ) {
     MultiValue& myder=mymatrix->getTemporyMultiValue(0);
@@ -116,9 +130,9 @@ MultiValue& ActionWithInputMatrix::getInputDerivatives( const unsigned& ind, con
     }
     myder.clearAll();
     MultiValue myvals( (mymatrix->function)->getNumberOfQuantities(), (mymatrix->function)->getNumberOfDerivatives() );
-    for(unsigned i=0; i<mymatrix->getNumberOfColumns(); ++i) {
-      if( mymatrix->undirectedGraph() && ind==i ) continue;
-      addConnectionDerivatives( ind, i, myvals, myder );
+    for(unsigned k=0; k<mymatrix->getNumberOfElementsInRow(ind); ++k) {
+      unsigned i, istore; mymatrix->getElementInRow( ind, k, i, istore );
+      addStoredConnectionDerivatives( istore, myvals, myder );
     }
     myder.updateDynamicList(); return myder;
   }
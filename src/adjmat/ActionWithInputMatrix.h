@@ -48,10 +48,14 @@ public:
   AdjacencyMatrixVessel* getAdjacencyVessel() const ;
 /// Retrieve the value of the connection
   double retrieveConnectionValue( const unsigned& i, const unsigned& j, std::vector<double>& vals ) const ;
+/// Retrieve the value of the connection from its position in the store of the adjacency matrix vessel
+  double retrieveStoredConnectionValue( const unsigned& istore, std::vector<double>& vals ) const ;
 /// Get the vector for task ind
   void getInputData( const unsigned& ind, const bool& normed, const multicolvar::AtomValuePack& myatoms, std::vector<double>& orient0 ) const override;
 /// Add the derivatives on a connection
   void addConnectionDerivatives( const unsigned& i, const unsigned& j, MultiValue& myvals, MultiValue& myvout ) const ;
+/// Add the derivatives on a connection from its position in the store of the adjacency matrix vessel
+  void addStoredConnectionDerivatives( const unsigned& istore, MultiValue& myvals, MultiValue& myvout ) const ;
 /// Get vector derivatives
   MultiValue& getInputDerivatives( const unsigned& ind, const bool& normed, const multicolvar::AtomValuePack& myatoms ) const override;
   unsigned getNumberOfDerivatives() override;
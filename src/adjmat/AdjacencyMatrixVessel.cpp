@@ -22,6 +22,7 @@
 #include "AdjacencyMatrixVessel.h"
 #include "AdjacencyMatrixBase.h"
 #include "vesselbase/ActionWithVessel.h"
+#include <algorithm>
 
 namespace PLMD {
 namespace adjmat {
@@ -41,6 +42,8 @@ AdjacencyMatrixVessel::AdjacencyMatrixVessel( const vesselbase::VesselOptions& d
   if( symmetric && hbonds ) error("matrix should be either symmetric or hbonds");
   if( symmetric && function->ablocks[0].size()!=function->ablocks[1].size() ) error("matrix is supposed to be symmetric but nrows!=ncols");
   if( hbonds &&  function->ablocks[0].size()!=function->ablocks[1].size() ) error("matrix is supposed to be hbonds but nrows!=ncols");
+  row_start.assign( getNumberOfRows()+1, 0 );
+  if( !symmetric ) col_start.assign( getNumberOfColumns()+1, 0 );
 }
 
 bool AdjacencyMatrixVessel::isSymmetric() const {
@@ -84,53 +87,112 @@ void AdjacencyMatrixVessel::getMatrixIndices( const unsigned& code, unsigned& i,
   if( !undirectedGraph() ) j -= function->ablocks[0].size(); // Have to remove number of columns as returns number in ablocks[1]
 }
 
-void AdjacencyMatrixVessel::retrieveMatrix( DynamicList<unsigned>& myactive_elements, Matrix<double>& mymatrix ) {
-  myactive_elements.deactivateAll(); std::vector<double> vals( getNumberOfComponents() );
-  for(unsigned i=0; i<getNumberOfStoredValues(); ++i) {
-    retrieveSequentialValue( i, false, vals );
-    if( vals[0]<epsilon ) continue ;
-
-    myactive_elements.activate(i);
-    unsigned j, k; getMatrixIndices( function->getPositionInFullTaskList(i), k, j );
+void AdjacencyMatrixVessel::finish( const std::vector<double>& buffer ) {
+  StoreDataVessel::finish( buffer );
+  buildSparseMatrix();
+}
 
-    if( symmetric ) mymatrix(k,j)=mymatrix(j,k)=vals[0]*vals[1];
-    else mymatrix(k,j)=vals[0]*vals[1];
+/// Sort the elements of each row of a sparse matrix by column
+static void sortSparseRows( const std::vector<unsigned>& start, std::vector<unsigned>& cols, std::vector<unsigned>& store ) {
+  for(unsigned i=0; i+1<start.size(); ++i) {
+    for(unsigned k=start[i]+1; k<start[i+1]; ++k) {
+      for(unsigned l=k; l>start[i] && cols[l-1]>cols[l]; --l) { std::swap( cols[l-1], cols[l] ); std::swap( store[l-1], store[l] ); }
+    }
   }
-  myactive_elements.updateActiveMembers();
 }
 
-void AdjacencyMatrixVessel::retrieveAdjacencyLists( std::vector<unsigned>& nneigh, Matrix<unsigned>& adj_list ) {
-  plumed_dbg_assert( undirectedGraph() );
-  // Currently everything has zero neighbors
-  for(unsigned i=0; i<nneigh.size(); ++i) nneigh[i]=0;
-
-  // And set up the adjacency list
-  std::vector<double> myvals( getNumberOfComponents() );
-  for(unsigned i=0; i<getNumberOfStoredValues(); ++i) {
-    // Check if atoms are connected
-    retrieveSequentialValue( i, false, myvals );
-    if( myvals[0]<epsilon || myvals[1]<epsilon ) continue ;
+void AdjacencyMatrixVessel::buildSparseMatrix() {
+  unsigned nrows=getNumberOfRows(), ncols=getNumberOfColumns();
+  row_start.assign( nrows+1, 0 );
+  if( !symmetric ) col_start.assign( ncols+1, 0 );
+
+  // Only the elements that are non-zero are kept in the store, count the number of elements in each row and column
+  std::vector<unsigned> nz_rows, nz_cols, nz_store, myatoms;
+  for(unsigned n=0; n<getNumberOfNonZeroValues(); ++n) {
+    unsigned i=getNonZeroValueIndex(n);
+    function->decodeIndexToAtoms( function->getTaskCode( function->getPositionInFullTaskList(i) ), myatoms );
+    unsigned k=myatoms[0], j=myatoms[1];
+    if( !undirectedGraph() ) j -= nrows;
+    nz_rows.push_back(k); nz_cols.push_back(j); nz_store.push_back(i);
+    row_start[k+1]++;
+    // Symmetric matrices only store one of (k,j) and (j,k) so the element goes in both rows
+    if( symmetric ) row_start[j+1]++;
+    else col_start[j+1]++;
+  }
 
-    unsigned j, k; getMatrixIndices( function->getPositionInFullTaskList(i), k, j );
+  // And put them in their rows and columns
+  for(unsigned i=0; i<nrows; ++i) row_start[i+1]+=row_start[i];
+  row_cols.resize( row_start[nrows] ); row_store.resize( row_start[nrows] );
+  std::vector<unsigned> rpos( row_start.begin(), row_start.end()-1 );
+  if( symmetric ) {
+    for(unsigned n=0; n<nz_store.size(); ++n) {
+      row_cols[rpos[nz_rows[n]]]=nz_cols[n]; row_store[rpos[nz_rows[n]]]=nz_store[n]; rpos[nz_rows[n]]++;
+      row_cols[rpos[nz_cols[n]]]=nz_rows[n]; row_store[rpos[nz_cols[n]]]=nz_store[n]; rpos[nz_cols[n]]++;
+    }
+  } else {
+    for(unsigned j=0; j<ncols; ++j) col_start[j+1]+=col_start[j];
+    col_rows.resize( col_start[ncols] ); col_store.resize( col_start[ncols] );
+    std::vector<unsigned> cpos( col_start.begin(), col_start.end()-1 );
+    for(unsigned n=0; n<nz_store.size(); ++n) {
+      row_cols[rpos[nz_rows[n]]]=nz_cols[n]; row_store[rpos[nz_rows[n]]]=nz_store[n]; rpos[nz_rows[n]]++;
+      col_rows[cpos[nz_cols[n]]]=nz_rows[n]; col_store[cpos[nz_cols[n]]]=nz_store[n]; cpos[nz_cols[n]]++;
+    }
+    sortSparseRows( col_start, col_rows, col_store );
+  }
+  // Sorting ensures that sums over rows and columns are done in the same order as with a dense matrix
+  sortSparseRows( row_start, row_cols, row_store );
+}
+
+void AdjacencyMatrixVessel::retrieveMatrix( Matrix<double>& mymatrix ) {
+  mymatrix=0; std::vector<double> vals( getNumberOfComponents() );
+  for(unsigned i=0; i<getNumberOfRows(); ++i) {
+    for(unsigned k=0; k<getNumberOfElementsInRow(i); ++k) {
+      unsigned j, istore; getElementInRow( i, k, j, istore );
+      retrieveSequentialValue( istore, false, vals );
+      mymatrix(i,j)=vals[0]*vals[1];
+    }
+  }
+}
 
-    if( nneigh[j]>=adj_list.ncols() || nneigh[k]>=adj_list.ncols() ) error("adjacency lists are not large enough, increase maxconnections");
-    // Store if atoms are connected
-    // unsigned j, k; getMatrixIndices( i, k, j );
-    adj_list(k,nneigh[k])=j; nneigh[k]++;
-    adj_list(j,nneigh[j])=k; nneigh[j]++;
+void AdjacencyMatrixVessel::retrieveAdjacencyLists( std::vector<unsigned>& start, std::vector<unsigned>& adj_list ) {
+  plumed_dbg_assert( undirectedGraph() );
+  start.resize( getNumberOfRows()+1 ); adj_list.resize( row_cols.size() + col_rows.size() );
+
+  // Only keep the elements of each row for which the atoms are connected
+  unsigned n=0; start[0]=0; std::vector<double> myvals( getNumberOfComponents() );
+  for(unsigned i=0; i<getNumberOfRows(); ++i) {
+    // For hbonds node i is connected to the nodes in both row and column i, the two sorted lists are merged
+    unsigned nrow=getNumberOfElementsInRow(i), ncol=( symmetric ? 0 : getNumberOfElementsInColumn(i) );
+    unsigned kr=0, kc=0;
+    while( kr<nrow || kc<ncol ) {
+      unsigned j=0, istore=0, jc=0, istorec=0;
+      if( kr<nrow ) getElementInRow( i, kr, j, istore );
+      if( kc<ncol ) getElementInColumn( i, kc, jc, istorec );
+      if( kr==nrow || ( kc<ncol && jc<j ) ) { j=jc; istore=istorec; kc++; }
+      else kr++;
+      retrieveSequentialValue( istore, false, myvals );
+      if( myvals[0]<epsilon || myvals[1]<epsilon ) continue ;
+      if( n>start[i] && adj_list[n-1]==j ) continue ;
+      adj_list[n]=j; n++;
+    }
+    start[i+1]=n;
   }
 }
 
 void AdjacencyMatrixVessel::retrieveEdgeList( unsigned& nedge, std::vector<std::pair<unsigned,unsigned> >& edge_list ) {
   plumed_dbg_assert( undirectedGraph() ); nedge=0;
   std::vector<double> myvals( getNumberOfComponents() );
-  if( getNumberOfStoredValues()>edge_list.size() ) error("adjacency lists are not large enough, increase maxconnections");
+  // The list is enlarged if there are more edges than it can hold
+  unsigned nstored=( symmetric ? row_store.size()/2 : row_store.size() );
+  if( edge_list.size()<nstored ) edge_list.resize( nstored );
 
-  for(unsigned i=0; i<getNumberOfStoredValues(); ++i) {
+  for(unsigned n=0; n<getNumberOfNonZeroValues(); ++n) {
     // Check if atoms are connected
+    unsigned i=getNonZeroValueIndex(n);
     retrieveSequentialValue( i, false, myvals );
     if( myvals[0]<epsilon || myvals[1]<epsilon ) continue ;
 
+    if( nedge==edge_list.size() ) edge_list.resize( nedge+1 );
     getMatrixIndices( function->getPositionInFullTaskList(i), edge_list[nedge].first, edge_list[nedge].second );
     nedge++;
   }
@@ -44,6 +44,14 @@ private:
   AdjacencyMatrixBase* function;
 /// Is the matrix symmetric and are we calculating hbonds
   bool symmetric, hbonds;
+/// The elements that are currently non-zero in compressed sparse row format: the columns of the elements
+/// in row i and their positions in the store are in row_cols and row_store from row_start[i] to row_start[i+1].
+/// For symmetric matrices each element is in both its row and its column
+  std::vector<unsigned> row_start, row_cols, row_store;
+/// The same for the columns of the matrix, only used when the matrix is not symmetric
+  std::vector<unsigned> col_start, col_rows, col_store;
+/// Build the sparse representation of the matrix from the stored values
+  void buildSparseMatrix();
 public:
   static void registerKeywords( Keywords& keys );
 /// Constructor
@@ -55,9 +63,9 @@ public:
 /// Get the index that a particular element is stored in from the matrix indices
   unsigned getStoreIndexFromMatrixIndices( const unsigned& ielem, const unsigned& jelem ) const ;
 /// Get the adjacency matrix
-  void retrieveMatrix( DynamicList<unsigned>& myactive_elements, Matrix<double>& mymatrix );
-/// Get the neighbour list based on the adjacency matrix
-  void retrieveAdjacencyLists( std::vector<unsigned>& nneigh, Matrix<unsigned>& adj_list );
+  void retrieveMatrix( Matrix<double>& mymatrix );
+/// Get the neighbour list based on the adjacency matrix: the neighbours of node i are in positions start[i] to start[i+1] of adj_list
+  void retrieveAdjacencyLists( std::vector<unsigned>& start, std::vector<unsigned>& adj_list );
 /// Retrieve the list of edges in the adjacency matrix/graph
   void retrieveEdgeList( unsigned& nedge, std::vector<std::pair<unsigned,unsigned> >& edge_list );
 ///
@@ -74,10 +82,46 @@ public:
   bool nodesAreConnected( const unsigned& iatom, const unsigned& jatom ) const ;
 /// Get the cutoff that we are using for connections
   double getCutoffForConnection() const ;
+/// Get the number of non-zero elements in row i
+  unsigned getNumberOfElementsInRow( const unsigned& i ) const ;
+/// Get the column and the position in the store of the k th non-zero element in row i
+  void getElementInRow( const unsigned& i, const unsigned& k, unsigned& j, unsigned& istore ) const ;
+/// Get the number of non-zero elements in column j
+  unsigned getNumberOfElementsInColumn( const unsigned& j ) const ;
+/// Get the row and the position in the store of the k th non-zero element in column j
+  void getElementInColumn( const unsigned& j, const unsigned& k, unsigned& i, unsigned& istore ) const ;
+/// Build the sparse representation of the matrix once all the data has been gathered
+  void finish( const std::vector<double>& buffer ) override;
 ///
   Vector getNodePosition( const unsigned& taskIndex ) const ;
 };
 
+inline
+unsigned AdjacencyMatrixVessel::getNumberOfElementsInRow( const unsigned& i ) const {
+  plumed_dbg_assert( i+1<row_start.size() );
+  return row_start[i+1] - row_start[i];
+}
+
+inline
+void AdjacencyMatrixVessel::getElementInRow( const unsigned& i, const unsigned& k, unsigned& j, unsigned& istore ) const {
+  plumed_dbg_assert( k<getNumberOfElementsInRow(i) );
+  j=row_cols[row_start[i]+k]; istore=row_store[row_start[i]+k];
+}
+
+inline
+unsigned AdjacencyMatrixVessel::getNumberOfElementsInColumn( const unsigned& j ) const {
+  if( symmetric ) return getNumberOfElementsInRow( j );
+  plumed_dbg_assert( j+1<col_start.size() );
+  return col_start[j+1] - col_start[j];
+}
+
+inline
+void AdjacencyMatrixVessel::getElementInColumn( const unsigned& j, const unsigned& k, unsigned& i, unsigned& istore ) const {
+  if( symmetric ) { getElementInRow( j, k, i, istore ); return; }
+  plumed_dbg_assert( k<getNumberOfElementsInColumn(j) );
+  i=col_rows[col_start[j]+k]; istore=col_store[col_start[j]+k];
+}
+
 }
 }
 #endif
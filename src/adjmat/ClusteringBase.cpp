@@ -62,13 +62,17 @@ void ClusteringBase::calculate() {
   performClustering();
   // Order the clusters in the system by size (this returns ascending order )
   std::sort( cluster_sizes.begin(), cluster_sizes.end() );
+  // Store the atoms in each cluster so they can be retrieved without searching
+  cluster_start.assign( cluster_sizes.size()+1, 0 ); cluster_atoms.resize( which_cluster.size() );
+  for(unsigned i=0; i<which_cluster.size(); ++i) cluster_start[which_cluster[i]+1]++;
+  for(unsigned i=0; i<cluster_sizes.size(); ++i) cluster_start[i+1]+=cluster_start[i];
+  std::vector<unsigned> pos( cluster_start.begin(), cluster_start.end()-1 );
+  for(unsigned i=0; i<which_cluster.size(); ++i) { cluster_atoms[pos[which_cluster[i]]]=i; pos[which_cluster[i]]++; }
 }
 
 void ClusteringBase::retrieveAtomsInCluster( const unsigned& clust, std::vector<unsigned>& myatoms ) const {
-  unsigned n=0; myatoms.resize( cluster_sizes[cluster_sizes.size() - clust].first );
-  for(unsigned i=0; i<getNumberOfNodes(); ++i) {
-    if( which_cluster[i]==cluster_sizes[cluster_sizes.size() - clust].second ) { myatoms[n]=i; n++; }
-  }
+  unsigned iclust=cluster_sizes[cluster_sizes.size() - clust].second;
+  myatoms.assign( cluster_atoms.begin()+cluster_start[iclust], cluster_atoms.begin()+cluster_start[iclust+1] );
 }
 
 bool ClusteringBase::areConnected( const unsigned& iatom, const unsigned& jatom ) const {
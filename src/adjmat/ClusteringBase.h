@@ -36,6 +36,11 @@ protected:
   int number_of_cluster;
 /// Vector that identifies the cluster each atom belongs to
   std::vector<unsigned> which_cluster;
+private:
+/// The position of the first atom of each cluster in cluster_atoms
+  std::vector<unsigned> cluster_start;
+/// The atoms in each of the clusters (in ascending order)
+  std::vector<unsigned> cluster_atoms;
 public:
 /// Create manual
   static void registerKeywords( Keywords& keys );
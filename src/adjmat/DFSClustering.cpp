@@ -23,12 +23,6 @@
 #include "AdjacencyMatrixVessel.h"
 #include "core/ActionRegister.h"
 
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/connected_components.hpp>
-#include <boost/graph/graph_utility.hpp>
-#endif
-
 //+PLUMEDOC MATRIXF DFSCLUSTERING
 /*
 Find the connected components of the matrix using the depth first search clustering algorithm.
@@ -41,6 +35,11 @@ a depth first search clustering to find the connected components of this graph.
 
 https://en.wikipedia.org/wiki/Depth-first_search
 
+The connected components are found using a union-find (disjoint set) data structure that is kept from one step to the next.
+When the only change in the graph is that new edges have formed, only these new edges are added to the structure, which
+is only rebuilt from scratch when some edges have been broken.  The clusters are numbered exactly as they would be by a depth
+first search, i.e. in order of the lowest index of the atoms they contain.
+
 This action is useful if you are looking at a phenomenon such as nucleation where the aim is to detect the sizes of the crystalline nuclei that have formed
 in your simulation cell.
 
@@ -69,19 +68,20 @@ namespace adjmat {
 
 class DFSClustering : public ClusteringBase {
 private:
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-/// The list of edges in the graph
-  std::vector<std::pair<unsigned,unsigned> > edge_list;
-#else
-/// The number of neighbors each atom has
+/// The position of the first neighbor of each atom in the adjacency list
   std::vector<unsigned> nneigh;
 /// The adjacency list
-  Matrix<unsigned> adj_list;
-/// The color that tells us whether a node has been visited
-  std::vector<unsigned> color;
-/// The recursive function at the heart of this method
-  int explore( const unsigned& index );
-#endif
+  std::vector<unsigned> adj_list;
+/// The edges of the graph at the previous step (ordered pairs with first<second)
+  std::vector<std::pair<unsigned,unsigned> > old_edges, new_edges;
+/// The parent and the size of the tree of each node in the union-find structure
+  std::vector<unsigned> parent, treesize;
+/// The cluster each root of the union-find structure corresponds to
+  std::vector<int> root_cluster;
+/// Find the root of the tree that contains a node
+  unsigned findRoot( unsigned index );
+/// Join the trees that contain two nodes
+  void joinTrees( const unsigned& i, const unsigned& j );
 public:
 /// Create manual
   static void registerKeywords( Keywords& keys );
@@ -95,10 +95,8 @@ PLUMED_REGISTER_ACTION(DFSClustering,"DFSCLUSTERING")
 
 void DFSClustering::registerKeywords( Keywords& keys ) {
   ClusteringBase::registerKeywords( keys );
-  keys.add("compulsory","MAXCONNECT","0","maximum number of connections that can be formed by any given node in the graph. "
-           "By default this is set equal to zero and the number of connections is set equal to the number "
-           "of nodes.  You only really need to set this if you are working with a very large system and "
-           "memory is at a premium");
+  keys.add("compulsory","MAXCONNECT","0","this keyword is no longer needed. The memory used to store the connections "
+           "now grows with the number of connections that are actually formed");
 }
 
 DFSClustering::DFSClustering(const ActionOptions&ao):
@@ -106,56 +104,63 @@ DFSClustering::DFSClustering(const ActionOptions&ao):
   ClusteringBase(ao)
 {
   unsigned maxconnections; parse("MAXCONNECT",maxconnections);
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-  if( maxconnections>0 ) edge_list.resize( getNumberOfNodes()*maxconnections );
-  else edge_list.resize(0.5*getNumberOfNodes()*(getNumberOfNodes()-1));
-#else
-  nneigh.resize( getNumberOfNodes() ); color.resize(getNumberOfNodes());
-  if( maxconnections>0 ) adj_list.resize(getNumberOfNodes(),maxconnections);
-  else adj_list.resize(getNumberOfNodes(),getNumberOfNodes());
-#endif
+  parent.resize(getNumberOfNodes()); treesize.resize(getNumberOfNodes()); root_cluster.resize(getNumberOfNodes());
+  for(unsigned i=0; i<getNumberOfNodes(); ++i) { parent[i]=i; treesize[i]=1; }
 }
 
-void DFSClustering::performClustering() {
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-  // Get the list of edges
-  unsigned nedges=0; getAdjacencyVessel()->retrieveEdgeList( nedges, edge_list );
-
-  // Build the graph using boost
-  boost::adjacency_list<boost::vecS,boost::vecS,boost::undirectedS> sg(&edge_list[0],&edge_list[nedges],getNumberOfNodes());
+unsigned DFSClustering::findRoot( unsigned index ) {
+  // Path halving keeps the trees shallow
+  while( parent[index]!=index ) { parent[index]=parent[parent[index]]; index=parent[index]; }
+  return index;
+}
 
-  // Find the connected components using boost (-1 here for compatibility with non-boost version)
-  number_of_cluster=boost::connected_components(sg,&which_cluster[0]) - 1;
+void DFSClustering::joinTrees( const unsigned& i, const unsigned& j ) {
+  unsigned ri=findRoot(i), rj=findRoot(j);
+  if( ri==rj ) return;
+  if( treesize[ri]<treesize[rj] ) std::swap( ri, rj );
+  parent[rj]=ri; treesize[ri]+=treesize[rj];
+}
 
-  // And work out the size of each cluster
-  for(unsigned i=0; i<which_cluster.size(); ++i) cluster_sizes[which_cluster[i]].first++;
-#else
-  // Get the adjacency matrix
+void DFSClustering::performClustering() {
+  // Get the adjacency lists and extract the edges (these are sorted as the neighbors of each atom are sorted)
   getAdjacencyVessel()->retrieveAdjacencyLists( nneigh, adj_list );
-
-  // Perform clustering
-  number_of_cluster=-1; color.assign(color.size(),0);
+  new_edges.resize(0);
   for(unsigned i=0; i<getNumberOfNodes(); ++i) {
-    if( color[i]==0 ) { number_of_cluster++; color[i]=explore(i); }
+    for(unsigned k=nneigh[i]; k<nneigh[i+1]; ++k) {
+      if( adj_list[k]>i ) new_edges.push_back( std::pair<unsigned,unsigned>( i, adj_list[k] ) );
+    }
   }
-#endif
-}
 
-#ifndef __PLUMED_HAS_BOOST_GRAPH
-int DFSClustering::explore( const unsigned& index ) {
+  // Check if any of the edges that were there at the previous step have been broken
+  bool broken=false; unsigned n=0;
+  for(unsigned k=0; k<old_edges.size(); ++k) {
+    while( n<new_edges.size() && new_edges[n]<old_edges[k] ) n++;
+    if( n==new_edges.size() || new_edges[n]!=old_edges[k] ) { broken=true; break; }
+  }
 
-  color[index]=1;
-  for(unsigned i=0; i<nneigh[index]; ++i) {
-    unsigned j=adj_list(index,i);
-    if( color[j]==0 ) color[j]=explore(j);
+  if( broken ) {
+    // Edges cannot be removed from the union-find structure so we rebuild it
+    for(unsigned i=0; i<getNumberOfNodes(); ++i) { parent[i]=i; treesize[i]=1; }
+    for(unsigned k=0; k<new_edges.size(); ++k) joinTrees( new_edges[k].first, new_edges[k].second );
+  } else {
+    // Only the edges that have formed since the last step need to be added
+    n=0;
+    for(unsigned k=0; k<new_edges.size(); ++k) {
+      while( n<old_edges.size() && old_edges[n]<new_edges[k] ) n++;
+      if( n<old_edges.size() && old_edges[n]==new_edges[k] ) continue;
+      joinTrees( new_edges[k].first, new_edges[k].second );
+    }
   }
+  old_edges.swap( new_edges );
 
-  // Count the size of the cluster
-  cluster_sizes[number_of_cluster].first++;
-  which_cluster[index] = number_of_cluster;
-  return color[index];
+  // Number the clusters in order of the lowest index of the atoms they contain as is done in depth first search
+  number_of_cluster=-1; root_cluster.assign( root_cluster.size(), -1 );
+  for(unsigned i=0; i<getNumberOfNodes(); ++i) {
+    unsigned root=findRoot(i);
+    if( root_cluster[root]<0 ) { number_of_cluster++; root_cluster[root]=number_of_cluster; }
+    which_cluster[i]=root_cluster[root]; cluster_sizes[which_cluster[i]].first++;
+  }
 }
-#endif
 
 }
 }
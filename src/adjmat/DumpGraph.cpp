@@ -42,8 +42,6 @@ Write out the connectivity of the nodes in the graph in dot format.
 
 class DumpGraph : public ActionPilot {
 private:
-///
-  unsigned maxconnections;
 /// The vessel that contains the graph
   AdjacencyMatrixVessel* mymatrix;
 /// The name of the file on which we are outputting the graph
@@ -67,10 +65,8 @@ void DumpGraph::registerKeywords( Keywords& keys ) {
   keys.add("compulsory","MATRIX","the action that calculates the adjacency matrix vessel we would like to analyze");
   keys.add("compulsory","STRIDE","1","the frequency with which you would like to output the graph");
   keys.add("compulsory","FILE","the name of the file on which to output the data");
-  keys.add("compulsory","MAXCONNECT","0","maximum number of connections that can be formed by any given node in the graph. "
-           "By default this is set equal to zero and the number of connections is set equal to the number "
-           "of nodes.  You only really need to set this if you are working with a very large system and "
-           "memory is at a premium");
+  keys.add("compulsory","MAXCONNECT","0","this keyword is no longer needed. The memory used to store the connections "
+           "now grows with the number of connections that are actually formed");
 
 }
 
@@ -79,7 +75,7 @@ DumpGraph::DumpGraph( const ActionOptions& ao):
   ActionPilot(ao),
   mymatrix(NULL)
 {
-  parse("MAXCONNECT",maxconnections); std::string mstring; parse("MATRIX",mstring);
+  unsigned maxconnections; parse("MAXCONNECT",maxconnections); std::string mstring; parse("MATRIX",mstring);
   AdjacencyMatrixBase* mm = plumed.getActionSet().selectWithLabel<AdjacencyMatrixBase*>( mstring );
   if( !mm ) error("found no action in set with label " + mstring + " that calculates matrix");
   log.printf("  printing graph for matrix calculated by action %s\n", mm->getLabel().c_str() );
@@ -91,7 +87,6 @@ DumpGraph::DumpGraph( const ActionOptions& ao):
   }
   if( !mymatrix ) error( mm->getLabel() + " does not calculate an adjacency matrix");
   if( !mymatrix->isSymmetric() ) error("input contact matrix must be symmetric");
-  if( maxconnections==0 ) maxconnections=mymatrix->getNumberOfRows();
   parse("FILE",filename);
   log.printf("  printing graph to file named %s \n",filename.c_str() );
   checkRead();
@@ -103,7 +98,7 @@ void DumpGraph::update() {
   // Print all nodes
   for(unsigned i=0; i<mymatrix->getNumberOfRows(); ++i) ofile.printf("%u [label=\"%u\"];\n",i,i);
   // Now retrieve connectivitives
-  unsigned nedge; std::vector<std::pair<unsigned,unsigned> > edge_list( mymatrix->getNumberOfRows()*maxconnections );
+  unsigned nedge; std::vector<std::pair<unsigned,unsigned> > edge_list;
   mymatrix->retrieveEdgeList( nedge, edge_list );
   for(unsigned i=0; i<nedge; ++i) ofile.printf("%u -- %u \n", edge_list[i].first, edge_list[i].second );
   ofile.printf("} \n");
@@ -101,18 +101,19 @@ MatrixColumnSums::MatrixColumnSums(const ActionOptions& ao):
 
 double MatrixColumnSums::compute( const unsigned& tinded, multicolvar::AtomValuePack& myatoms ) const {
   double sum=0.0; std::vector<double> tvals( mymatrix->getNumberOfComponents() );
-  unsigned nrows = mymatrix->getNumberOfRows();
-  for(unsigned i=0; i<nrows; ++i) {
-    if( mymatrix->undirectedGraph() && tinded==i ) continue;
-    sum+=retrieveConnectionValue( i, tinded, tvals );
+  // Only the non-zero elements in the column are visited
+  unsigned nelem = mymatrix->getNumberOfElementsInColumn( tinded );
+  for(unsigned k=0; k<nelem; ++k) {
+    unsigned i, istore; mymatrix->getElementInColumn( tinded, k, i, istore );
+    sum+=retrieveStoredConnectionValue( istore, tvals );
   }
 
   if( !doNotCalculateDerivatives() ) {
     MultiValue myvals( mymatrix->getNumberOfComponents(), myatoms.getNumberOfDerivatives() );
     MultiValue& myvout=myatoms.getUnderlyingMultiValue();
-    for(unsigned i=0; i<nrows; ++i) {
-      if( mymatrix->isSymmetric() && tinded==i ) continue ;
-      addConnectionDerivatives( i, tinded, myvals, myvout );
+    for(unsigned k=0; k<nelem; ++k) {
+      unsigned i, istore; mymatrix->getElementInColumn( tinded, k, i, istore );
+      addStoredConnectionDerivatives( istore, myvals, myvout );
     }
   }
   return sum;
@@ -86,8 +86,6 @@ private:
   double sqrtn;
 /// Vector that stores eigenvalues
   std::vector<double> eigvals;
-/// This is used to speed up the calculation of derivatives
-  DynamicList<unsigned> active_elements;
 /// Vector that stores max eigenvector
   std::vector< std::pair<double,int> > maxeig;
 /// Adjacency matrix
@@ -142,15 +140,11 @@ Sprint::Sprint(const ActionOptions&ao):
     componentIsNotPeriodic("coord-"+num);
     getPntrToComponent(i)->resizeDerivatives( getNumberOfDerivatives() );
   }
-
-  // Setup the dynamic list to hold all the tasks
-  unsigned ntriangle = 0.5*getNumberOfNodes()*(getNumberOfNodes()-1);
-  for(unsigned i=0; i<ntriangle; ++i) active_elements.addIndexToList( i );
 }
 
 void Sprint::calculate() {
   // Get the adjacency matrix
-  getAdjacencyVessel()->retrieveMatrix( active_elements, thematrix );
+  getAdjacencyVessel()->retrieveMatrix( thematrix );
   // Diagonalize it
   diagMat( thematrix, eigvals, eigenvecs );
   // Get the maximum eigevalue
@@ -187,19 +181,25 @@ void Sprint::calculate() {
   Matrix<double> mymat_ders( getNumberOfComponents(), getNumberOfDerivatives() );
   // std::vector<unsigned> catoms(2);
   unsigned nval = getNumberOfNodes(); mymat_ders=0;
-  for(unsigned i=rank; i<active_elements.getNumberActive(); i+=stride) {
-    unsigned j, k; getAdjacencyVessel()->getMatrixIndices( active_elements[i], j, k );
-    double tmp1 = 2 * eigenvecs(nval-1,j)*eigenvecs(nval-1,k);
-    for(int icomp=0; icomp<getNumberOfComponents(); ++icomp) {
-      double tmp2 = 0.;
-      for(unsigned n=0; n<nval-1; ++n) { // Need care on following line
-        tmp2 += eigenvecs(n,maxeig[icomp].second) * ( eigenvecs(n,j)*eigenvecs(nval-1,k) + eigenvecs(n,k)*eigenvecs(nval-1,j) ) / ( lambda - eigvals[n] );
-      }
-      double prefactor=sqrtn*( tmp1*maxeig[icomp].first + tmp2*lambda );
-      getAdjacencyVessel()->retrieveDerivatives( active_elements[i], false, myvals );
-      for(unsigned jd=0; jd<myvals.getNumberActive(); ++jd) {
-        unsigned ider=myvals.getActiveIndex(jd);
-        mymat_ders( icomp, ider ) += prefactor*myvals.getDerivative( 1, ider );
+  // Only the non-zero elements of the matrix are visited, each of them once
+  unsigned nelem=0;
+  for(unsigned j=0; j<nval; ++j) {
+    for(unsigned l=0; l<getAdjacencyVessel()->getNumberOfElementsInRow(j); ++l) {
+      unsigned k, istore; getAdjacencyVessel()->getElementInRow( j, l, k, istore );
+      if( k<j ) continue;
+      nelem++; if( (nelem-1)%stride!=rank ) continue;
+      double tmp1 = 2 * eigenvecs(nval-1,j)*eigenvecs(nval-1,k);
+      getAdjacencyVessel()->retrieveSequentialDerivatives( istore, false, myvals );
+      for(int icomp=0; icomp<getNumberOfComponents(); ++icomp) {
+        double tmp2 = 0.;
+        for(unsigned n=0; n<nval-1; ++n) { // Need care on following line
+          tmp2 += eigenvecs(n,maxeig[icomp].second) * ( eigenvecs(n,j)*eigenvecs(nval-1,k) + eigenvecs(n,k)*eigenvecs(nval-1,j) ) / ( lambda - eigvals[n] );
+        }
+        double prefactor=sqrtn*( tmp1*maxeig[icomp].first + tmp2*lambda );
+        for(unsigned jd=0; jd<myvals.getNumberActive(); ++jd) {
+          unsigned ider=myvals.getActiveIndex(jd);
+          mymat_ders( icomp, ider ) += prefactor*myvals.getDerivative( 1, ider );
+        }
       }
     }
   }
@@ -56,6 +56,7 @@ protected:
   AnalysisBase* my_input_data;
 public:
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return true;}
   explicit AnalysisBase(const ActionOptions&);
 /// These are required because we inherit from both ActionAtomistic and ActionWithArguments
   void lockRequests() override;
@@ -69,6 +69,7 @@ private:
   bool doNotStop;
 public:
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return !doNotStop;}
   explicit Committor(const ActionOptions&ao);
   void calculate() override;
   void apply() override {}
@@ -23,6 +23,7 @@ SOFTWARE.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "function/Function.h"
 #include "function/ActionRegister.h"
+#include "blas/blas.h"
 #include "cassert"
 
 #include <string>
@@ -93,18 +94,19 @@ private:
   int num_layers;
   vector<int> num_nodes;
   vector<string> activations;   // activation functions
-  vector<vector<double> > weights;  // flattened weight arrays
+  vector<vector<double> > weights;  // flattened weight arrays, row-major with num_nodes[ii + 1] rows and num_nodes[ii] columns
   vector<vector<double> > biases;
   vector<vector<double> > output_of_each_layer;
   vector<vector<double> > input_of_each_layer;
-  vector<double** > coeff;  // weight matrix arrays, reshaped from "weights"
+  vector<vector<double> > jacobian_of_each_layer;  // derivatives of all outputs with respect to the outputs of each layer
+  vector<double> temp_jacobian;
 
 public:
   static void registerKeywords( Keywords& keys );
   explicit ANN(const ActionOptions&);
   virtual void calculate();
   void calculate_output_of_each_layer(const vector<double>& input);
-  void back_prop(vector<vector<double> >& derivatives_of_each_layer, int index_of_output_component);
+  void back_prop();
 };
 
 PLUMED_REGISTER_ACTION(ANN,"ANN")
@@ -133,7 +135,7 @@ ANN::ANN(const ActionOptions&ao):
   activations = vector<string>(num_layers - 1);
   output_of_each_layer = vector<vector<double> >(num_layers);
   input_of_each_layer = vector<vector<double> >(num_layers);
-  coeff = vector<double** >(num_layers - 1);
+  jacobian_of_each_layer = vector<vector<double> >(num_layers);
   parseVector("NUM_NODES", num_nodes);
   parseVector("ACTIVATIONS", activations);
   log.printf("\nactivations = ");
@@ -167,27 +169,17 @@ ANN::ANN(const ActionOptions&ao):
     error("Number of arguments is wrong");
   }
 
-  auto temp_coeff = weights;
   for (int ii = 0; ii < num_layers - 1; ii ++) {
-    int num_of_rows, num_of_cols; // num of rows/cols for the coeff matrix of this connection
-    num_of_rows = num_nodes[ii + 1];
-    num_of_cols = num_nodes[ii];
-    assert (num_of_rows * num_of_cols == temp_coeff[ii].size()); // check whether the size matches
-    // create a 2d array to hold coefficients
-    coeff[ii] = new double*[num_of_rows];
-    for (int kk = 0; kk < num_of_rows; kk ++) {
-      coeff[ii][kk] = new double[num_of_cols];
-    }
-    for (int jj = 0; jj < temp_coeff[ii].size(); jj ++) {
-      coeff[ii][jj / num_of_cols][jj % num_of_cols] = temp_coeff[ii][jj];
-    }
+    // check whether the size of the weight matrix and of the biases match the number of nodes
+    if(num_nodes[ii + 1] * num_nodes[ii] != (int) weights[ii].size()) error("Number of weights is wrong");
+    if(num_nodes[ii + 1] != (int) biases[ii].size()) error("Number of biases is wrong");
   }
   // check coeff
   for (int ii = 0; ii < num_layers - 1; ii ++) {
     log.printf("coeff %d = \n", ii);
     for (int jj = 0; jj < num_nodes[ii + 1]; jj ++) {
       for (int kk = 0; kk < num_nodes[ii]; kk ++) {
-        log.printf("%f ", coeff[ii][jj][kk]);
+        log.printf("%f ", weights[ii][jj * num_nodes[ii] + kk]);
       }
       log.printf("\n");
     }
@@ -217,13 +209,13 @@ void ANN::calculate_output_of_each_layer(const vector<double>& input) {
   for(int ii = 1; ii < num_nodes.size(); ii ++) {
     output_of_each_layer[ii].resize(num_nodes[ii]);
     input_of_each_layer[ii].resize(num_nodes[ii]);
-    // first calculate input
-    for (int jj = 0; jj < num_nodes[ii]; jj ++) {
-      input_of_each_layer[ii][jj] = biases[ii - 1][jj];  // add bias term
-      for (int kk = 0; kk < num_nodes[ii - 1]; kk ++) {
-        input_of_each_layer[ii][jj] += coeff[ii - 1][jj][kk] * output_of_each_layer[ii - 1][kk];
-      }
-    }
+    // first calculate input, as bias + weights * output of the previous layer
+    // (the row-major weight matrix is seen by BLAS as its column-major transpose)
+    input_of_each_layer[ii] = biases[ii - 1];
+    int num_of_cols = num_nodes[ii - 1], num_of_rows = num_nodes[ii], inc = 1;
+    double one = 1.0;
+    plumed_blas_dgemv("T", &num_of_cols, &num_of_rows, &one, weights[ii - 1].data(), &num_of_cols,
+                      output_of_each_layer[ii - 1].data(), &inc, &one, input_of_each_layer[ii].data(), &inc);
     // then get output
     if (activations[ii - 1] == string("Linear")) {
       for(int jj = 0; jj < num_nodes[ii]; jj ++) {
@@ -272,89 +264,61 @@ void ANN::calculate_output_of_each_layer(const vector<double>& input) {
   return;
 }
 
-void ANN::back_prop(vector<vector<double> >& derivatives_of_each_layer, int index_of_output_component) {
-  derivatives_of_each_layer = output_of_each_layer;  // the data structure and size should be the same, so I simply deep copy it
-  // first calculate derivatives for bottleneck layer
-  for (int ii = 0; ii < num_nodes[num_nodes.size() - 1]; ii ++ ) {
-    if (ii == index_of_output_component) {
-      derivatives_of_each_layer[num_nodes.size() - 1][ii] = 1;
-    }
-    else {
-      derivatives_of_each_layer[num_nodes.size() - 1][ii] = 0;
-    }
-  }
-  // the use back propagation to calculate derivatives for previous layers
-  for (int jj = num_nodes.size() - 2; jj >= 0; jj --) {
+void ANN::back_prop() {
+  // derivatives of all the outputs are propagated at once: jacobian_of_each_layer[jj] is a row-major
+  // matrix with one row per output component and one column per node of layer jj
+  const int num_outputs = num_nodes[num_layers - 1];
+  auto & last = jacobian_of_each_layer[num_layers - 1];
+  last.assign(num_outputs * num_outputs, 0.0);
+  for (int ii = 0; ii < num_outputs; ii ++) last[ii * num_outputs + ii] = 1;
+  for (int jj = num_layers - 2; jj >= 0; jj --) {
+    const int num_this = num_nodes[jj + 1];
+    const auto & next = jacobian_of_each_layer[jj + 1];
+    // first calculate the derivative with respect to the input of layer (jj + 1)
+    temp_jacobian.resize(num_outputs * num_this);
     if (activations[jj] == string("Circular")) {
-      vector<double> temp_derivative_of_input_for_this_layer;
-      temp_derivative_of_input_for_this_layer.resize(num_nodes[jj + 1]);
-#ifdef DEBUG
-      assert (num_nodes[jj + 1] % 2 == 0);
-#endif
-      // first calculate the derivative of input from derivative of output of this circular layer
-      for(int ii = 0; ii < num_nodes[jj + 1] / 2; ii ++) {
-        // printf("size of input_of_each_layer[%d] = %d\n",jj,  input_of_each_layer[jj].size());
-        double x_p = input_of_each_layer[jj + 1][2 * ii];
-        double x_q = input_of_each_layer[jj + 1][2 * ii + 1];
-        double radius = sqrt(x_p * x_p + x_q * x_q);
-        temp_derivative_of_input_for_this_layer[2 * ii] = x_q / (radius * radius * radius)
-            * (x_q * derivatives_of_each_layer[jj + 1][2 * ii]
-               - x_p * derivatives_of_each_layer[jj + 1][2 * ii + 1]);
-        temp_derivative_of_input_for_this_layer[2 * ii + 1] = x_p / (radius * radius * radius)
-            * (x_p * derivatives_of_each_layer[jj + 1][2 * ii + 1]
-               - x_q * derivatives_of_each_layer[jj + 1][2 * ii]);
-      }
-#ifdef DEBUG
-      for (int mm = 0; mm < num_nodes[jj + 1]; mm ++) {
-        printf("temp_derivative_of_input_for_this_layer[%d] = %lf\n", mm, temp_derivative_of_input_for_this_layer[mm]);
-        printf("derivatives_of_each_layer[%d + 1][%d] = %lf\n", jj, mm, derivatives_of_each_layer[jj + 1][mm]);
-      }
-#endif
-      // the calculate the derivative of output of layer jj, from derivative of input of layer (jj + 1)
-      for (int mm = 0; mm < num_nodes[jj]; mm ++) {
-        derivatives_of_each_layer[jj][mm] = 0;
-        for (int kk = 0; kk < num_nodes[jj + 1]; kk ++) {
-          derivatives_of_each_layer[jj][mm] += coeff[jj][kk][mm] \
-                                               * temp_derivative_of_input_for_this_layer[kk];
-#ifdef DEBUG
-          printf("derivatives_of_each_layer[%d][%d] = %lf\n", jj, mm, derivatives_of_each_layer[jj][mm]);
-          printf("coeff[%d][%d][%d] = %lf\n", jj, kk, mm, coeff[jj][kk][mm]);
-#endif
+      for (int oo = 0; oo < num_outputs; oo ++) {
+        const double* d_out = &next[oo * num_this];
+        double* d_in = &temp_jacobian[oo * num_this];
+        for(int ii = 0; ii < num_this / 2; ii ++) {
+          double x_p = input_of_each_layer[jj + 1][2 * ii];
+          double x_q = input_of_each_layer[jj + 1][2 * ii + 1];
+          double radius = sqrt(x_p * x_p + x_q * x_q);
+          d_in[2 * ii] = x_q / (radius * radius * radius) * (x_q * d_out[2 * ii] - x_p * d_out[2 * ii + 1]);
+          d_in[2 * ii + 1] = x_p / (radius * radius * radius) * (x_p * d_out[2 * ii + 1] - x_q * d_out[2 * ii]);
         }
       }
-      // TODO: should be fine, pass all tests, although there seems to be some problems here previously
     }
-    else {
-      for (int mm = 0; mm < num_nodes[jj]; mm ++) {
-        derivatives_of_each_layer[jj][mm] = 0;
-        for (int kk = 0; kk < num_nodes[jj + 1]; kk ++) {
-          if (activations[jj] == string("Tanh")) {
-            // printf("tanh\n");
-            derivatives_of_each_layer[jj][mm] += derivatives_of_each_layer[jj + 1][kk] \
-                                                 * coeff[jj][kk][mm] \
-                                                 * (1 - output_of_each_layer[jj + 1][kk] * output_of_each_layer[jj + 1][kk]);
-          }
-          else if (activations[jj] == string("Linear")) {
-            // printf("linear\n");
-            derivatives_of_each_layer[jj][mm] += derivatives_of_each_layer[jj + 1][kk] \
-                                                 * coeff[jj][kk][mm] \
-                                                 * 1;
-          }
-          else {
-            printf("layer type not found!\n\n");
-            return;
-          }
+    else if (activations[jj] == string("Tanh")) {
+      for (int oo = 0; oo < num_outputs; oo ++) {
+        for (int kk = 0; kk < num_this; kk ++) {
+          temp_jacobian[oo * num_this + kk] = next[oo * num_this + kk]
+                                              * (1 - output_of_each_layer[jj + 1][kk] * output_of_each_layer[jj + 1][kk]);
         }
       }
     }
+    else if (activations[jj] == string("Linear")) {
+      temp_jacobian = next;
+    }
+    else {
+      printf("layer type not found!\n\n");
+      return;
+    }
+    // then calculate the derivative with respect to the output of layer jj, as temp_jacobian * weights
+    // (in column-major terms, this is weights^T * temp_jacobian^T)
+    int num_prev = num_nodes[jj], num_rows = num_outputs, num_inner = num_this;
+    double one = 1.0, zero = 0.0;
+    jacobian_of_each_layer[jj].resize(num_outputs * num_prev);
+    plumed_blas_dgemm("N", "N", &num_prev, &num_rows, &num_inner, &one, weights[jj].data(), &num_prev,
+                      temp_jacobian.data(), &num_inner, &zero, jacobian_of_each_layer[jj].data(), &num_prev);
   }
 #ifdef DEBUG
   // print out the result for debugging
-  printf("derivatives_of_each_layer = \n");
+  printf("jacobian_of_each_layer = \n");
   for (int ii = 0; ii < num_layers; ii ++) {
     printf("layer[%d]: ", ii);
-    for (int jj = 0; jj < num_nodes[ii]; jj ++) {
-      printf("%lf\t", derivatives_of_each_layer[ii][jj]);
+    for (int jj = 0; jj < jacobian_of_each_layer[ii].size(); jj ++) {
+      printf("%lf\t", jacobian_of_each_layer[ii][jj]);
     }
     printf("\n");
   }
@@ -364,22 +328,19 @@ void ANN::back_prop(vector<vector<double> >& derivatives_of_each_layer, int inde
 }
 
 void ANN::calculate() {
-
   vector<double> input_layer_data(num_nodes[0]);
   for (int ii = 0; ii < num_nodes[0]; ii ++) {
     input_layer_data[ii] = getArgument(ii);
   }
-
   calculate_output_of_each_layer(input_layer_data);
-  vector<vector<double> > derivatives_of_each_layer;
-
+  back_prop();
+  const auto & jacobian = jacobian_of_each_layer[0];
   for (int ii = 0; ii < num_nodes[num_layers - 1]; ii ++) {
-    back_prop(derivatives_of_each_layer, ii);
     string name_of_this_component = "node-" + to_string(ii);
     Value* value_new=getPntrToComponent(name_of_this_component);
     value_new -> set(output_of_each_layer[num_layers - 1][ii]);
     for (int jj = 0; jj < num_nodes[0]; jj ++) {
-      value_new -> setDerivative(jj, derivatives_of_each_layer[0][jj]);  // TODO: setDerivative or addDerivative?
+      value_new -> setDerivative(jj, jacobian[ii * num_nodes[0] + jj]);  // TODO: setDerivative or addDerivative?
     }
 #ifdef DEBUG_3
     printf("derivatives = ");
@@ -389,7 +350,6 @@ void ANN::calculate() {
     printf("\n");
 #endif
   }
-
 }
 
 }
@@ -92,6 +92,7 @@ public:
   explicit ABMD(const ActionOptions&);
   void calculate() override;
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(ABMD,"ABMD")
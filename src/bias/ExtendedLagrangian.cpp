@@ -130,6 +130,7 @@ public:
   void calculate() override;
   void update() override;
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(ExtendedLagrangian,"EXTENDED_LAGRANGIAN")
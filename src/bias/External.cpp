@@ -108,6 +108,11 @@ the one hundredth block of data where t1 is fixed at \f$+pi\f$.
 
 Please note the order that the order of arguments in the plumed.dat file must be the same as
 the order of arguments in the header of the grid file.
+
+The grid can also be read from a file in the binary format that is written when the name of the grid file
+has extension .bin (see e.g. \ref DUMPGRID or the GRID_WFILE keyword of \ref METAD). Binary grids are not copied
+but mapped in memory, so that reading a large potential is almost instantaneous and all the processes running
+on the same node share the same copy of the data.
 */
 //+ENDPLUMEDOC
 
@@ -157,7 +162,7 @@ External::External(const ActionOptions& ao):
 // read grid
   IFile gridfile; gridfile.open(filename);
   std::string funcl=getLabel() + ".bias";
-  BiasGrid_=GridBase::create(funcl,getArguments(),gridfile,sparsegrid,spline,true);
+  BiasGrid_=GridBase::create(funcl,getArguments(),gridfile,sparsegrid,spline,true,true);
   if(BiasGrid_->getDimension()!=getNumberOfArguments()) error("mismatch between dimensionality of input grid and number of arguments");
   for(unsigned i=0; i<getNumberOfArguments(); ++i) {
     if( getPntrToArgument(i)->isPeriodic()!=BiasGrid_->getIsPeriodic()[i] ) error("periodicity mismatch between arguments and input bias");
@@ -167,6 +167,7 @@ public:
   void update() override;
   void update_lambda();
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
   void ReadLagrangians(IFile &ifile);
   void WriteLagrangians(vector<double> &lagmult,OFile &file);
   double compute_error(string &err_type,double &l);
@@ -29,6 +29,8 @@
 #include "core/FlexibleBin.h"
 #include "tools/Matrix.h"
 #include "tools/Random.h"
+#include "tools/OpenMP.h"
+#include "tools/BucketIndex.h"
 #include <string>
 #include <cstring>
 #include "tools/File.h"
@@ -401,6 +403,9 @@ private:
   vector<double> sigma0min_;
   vector<double> sigma0max_;
   vector<Gaussian> hills_;
+/// index used to find the hills close to a point when grids are not used
+  std::unique_ptr<BucketIndex> hillsIndex_;
+  vector<unsigned> hillsCandidates_;
   OFile hillsOfile_;
   OFile gridfile_;
   std::unique_ptr<GridBase> BiasGrid_;
@@ -455,6 +460,10 @@ private:
   unsigned rct_ustride_;
   double work_;
   long int last_step_warn_grid;
+// buffers used when depositing diagonal hills on the grid
+  vector<double> sepTable_;
+  vector<double> sepBias_;
+  vector<double> sepDer_;
 
   static void   registerTemperingKeywords(const std::string &name_stem, const std::string &name, Keywords &keys);
   void   readTemperingSpecs(TemperingSpecs &t_specs);
@@ -462,12 +471,14 @@ private:
   void   readGaussians(IFile*);
   void   writeGaussian(const Gaussian&,OFile&);
   void   addGaussian(const Gaussian&);
+  void   addSeparableGaussian(const Gaussian&,const vector<Grid::index_t>&);
   double getHeight(const vector<double>&);
   void   temperHeight(double &height, const TemperingSpecs &t_specs, const double tempering_bias);
   double getBiasAndDerivatives(const vector<double>&,double* der=NULL);
   double evaluateGaussian(const vector<double>&, const Gaussian&,double* der=NULL);
   double getGaussianNormalization( const Gaussian& );
   vector<unsigned> getGaussianSupport(const Gaussian&);
+  vector<double> getGaussianHalfWidth(const Gaussian&);
   bool   scanOneHill(IFile *ifile,  vector<Value> &v, vector<double> &center, vector<double>  &sigma, double &height, bool &multivariate);
   void   computeReweightingFactor();
   double getTransitionBarrierBias();
@@ -479,6 +490,7 @@ public:
   void calculate() override;
   void update() override;
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
   bool checkNeedsGradients()const override;
 };
 
@@ -520,7 +532,7 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.addFlag("GRID_SPARSE",false,"use a sparse grid to store hills");
   keys.addFlag("GRID_NOSPLINE",false,"don't use spline interpolation with grids");
   keys.add("optional","GRID_WSTRIDE","write the grid to a file every N steps");
-  keys.add("optional","GRID_WFILE","the file on which to write the grid");
+  keys.add("optional","GRID_WFILE","the file on which to write the grid. If the file has extension .bin the grid is written in binary format");
   keys.add("optional","GRID_RFILE","a grid file from which the bias should be read at the initial step of the simulation");
   keys.addFlag("STORE_GRIDS",false,"store all the grid files the calculation generates. They will be deleted if this keyword is not present");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or time step dimensions");
@@ -1075,6 +1087,16 @@ MetaD::MetaD(const ActionOptions& ao):
   // for performance
   dp_.reset( new double[getNumberOfArguments()] );
 
+  if(!grid_) {
+    vector<bool> periodic(getNumberOfArguments());
+    vector<double> pmin(getNumberOfArguments(),0.0),pmax(getNumberOfArguments(),0.0);
+    for(unsigned i=0; i<getNumberOfArguments(); i++) {
+      periodic[i]=getPntrToArgument(i)->isPeriodic();
+      if(periodic[i]) getPntrToArgument(i)->getDomain(pmin[i],pmax[i]);
+    }
+    hillsIndex_.reset(new BucketIndex(periodic,pmin,pmax));
+  }
+
   // initializing and checking grid
   if(grid_) {
     // check for mesh and sigma size
@@ -1204,7 +1226,7 @@ MetaD::MetaD(const ActionOptions& ao):
   if(targetfilename_.length()>0) {
     IFile gridfile; gridfile.open(targetfilename_);
     std::string funcl=getLabel() + ".target";
-    TargetGrid_=GridBase::create(funcl,getArguments(),gridfile,false,false,true);
+    TargetGrid_=GridBase::create(funcl,getArguments(),gridfile,false,false,true,true);
     if(TargetGrid_->getDimension()!=getNumberOfArguments()) error("mismatch between dimensionality of input grid and number of arguments");
     for(unsigned i=0; i<getNumberOfArguments(); ++i) {
       if( getPntrToArgument(i)->isPeriodic()!=TargetGrid_->getIsPeriodic()[i] ) error("periodicity mismatch between arguments and input bias");
@@ -1407,14 +1429,18 @@ void MetaD::writeGaussian(const Gaussian& hill, OFile&file)
 
 void MetaD::addGaussian(const Gaussian& hill)
 {
-  if(!grid_) hills_.push_back(hill);
-  else {
+  if(!grid_) {
+    hillsIndex_->add(hills_.size(),hill.center,getGaussianHalfWidth(hill));
+    hills_.push_back(hill);
+  } else {
     unsigned ncv=getNumberOfArguments();
     vector<unsigned> nneighb=getGaussianSupport(hill);
     vector<Grid::index_t> neighbors=BiasGrid_->getNeighbors(hill.center,nneighb);
     vector<double> der(ncv);
     vector<double> xx(ncv);
-    if(comm.Get_size()==1) {
+    if(!hill.multivariate && !doInt_) {
+      addSeparableGaussian(hill,neighbors);
+    } else if(comm.Get_size()==1) {
       for(unsigned i=0; i<neighbors.size(); ++i) {
         Grid::index_t ineigh=neighbors[i];
         for(unsigned j=0; j<ncv; ++j) der[j]=0.0;
@@ -1443,6 +1469,96 @@ void MetaD::addGaussian(const Gaussian& hill)
   }
 }
 
+void MetaD::addSeparableGaussian(const Gaussian& hill,const vector<Grid::index_t>& neighbors)
+{
+// A diagonal hill is a product of one-dimensional Gaussians.
+// These are tabulated on the bins covered by the hill along each dimension,
+// so that each grid point only costs a few multiplications.
+// The calculation is cheap enough to be done by every process, with no communication.
+  const unsigned ncv=getNumberOfArguments();
+  const vector<unsigned> nbin=BiasGrid_->getNbin();
+  const vector<bool> pbc=BiasGrid_->getIsPeriodic();
+  const vector<double> dx=BiasGrid_->getDx();
+  const vector<double> gmin=BiasGrid_->getPoint(0);
+  const vector<unsigned> nneighb=getGaussianSupport(hill);
+  const vector<unsigned> center=BiasGrid_->getIndices(hill.center);
+
+// for each dimension j and bin i, sepTable_ contains at position 3*(offset[j]+i)
+// the contribution to dp2, the Gaussian factor, and the factor for the derivative
+  vector<unsigned> offset(ncv,0);
+  for(unsigned j=1; j<ncv; ++j) offset[j]=offset[j-1]+nbin[j-1];
+  sepTable_.resize(3*(offset[ncv-1]+nbin[ncv-1]));
+  for(unsigned j=0; j<ncv; ++j) {
+    for(int k=-int(nneighb[j]); k<=int(nneighb[j]); ++k) {
+      int i=int(center[j])+k;
+      if(!pbc[j] && (i<0 || i>=int(nbin[j]))) continue;
+      if(pbc[j]) i=((i%int(nbin[j]))+int(nbin[j]))%int(nbin[j]);
+      const double dp=difference(j,hill.center[j],gmin[j]+i*dx[j])*hill.invsigma[j];
+      double* t=&sepTable_[3*(offset[j]+i)];
+      t[0]=0.5*dp*dp;
+      t[1]=exp(-t[0]);
+      t[2]=-dp*hill.invsigma[j];
+    }
+  }
+
+  const unsigned nn=neighbors.size();
+  sepBias_.resize(nn);
+  sepDer_.resize(nn*ncv);
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>nn) nt=1;
+  #pragma omp parallel for num_threads(nt)
+  for(unsigned i=0; i<nn; ++i) {
+    Grid::index_t kk=neighbors[i];
+    double dp2=0.0;
+    double bias=hill.height;
+    double* der=&sepDer_[ncv*i];
+    for(unsigned j=0; j<ncv; ++j) {
+      const double* t=&sepTable_[3*(offset[j]+kk%nbin[j])];
+      kk/=nbin[j];
+      dp2+=t[0];
+      bias*=t[1];
+      der[j]=t[2];
+    }
+    if(dp2>=DP2CUTOFF) bias=0.0;
+    for(unsigned j=0; j<ncv; ++j) der[j]*=bias;
+    sepBias_[i]=bias;
+  }
+
+  vector<double> der(ncv);
+  for(unsigned i=0; i<nn; ++i) {
+    for(unsigned j=0; j<ncv; ++j) der[j]=sepDer_[ncv*i+j];
+    BiasGrid_->addValueAndDerivatives(neighbors[i],sepBias_[i],der);
+  }
+}
+
+vector<double> MetaD::getGaussianHalfWidth(const Gaussian& hill)
+{
+// half width of the smallest box containing the points where the hill is not truncated
+  unsigned ncv=getNumberOfArguments();
+  vector<double> halfwidth(ncv);
+  if(hill.multivariate) {
+    unsigned k=0;
+    Matrix<double> mymatrix(ncv,ncv);
+    for(unsigned i=0; i<ncv; i++) {
+      for(unsigned j=i; j<ncv; j++) {
+        // recompose the full inverse matrix
+        mymatrix(i,j)=mymatrix(j,i)=hill.sigma[k];
+        k++;
+      }
+    }
+    Matrix<double> myinv(ncv,ncv);
+    Invert(mymatrix,myinv);
+    for(unsigned i=0; i<ncv; i++) halfwidth[i]=sqrt(2.0*DP2CUTOFF*myinv(i,i));
+  } else {
+    for(unsigned i=0; i<ncv; i++) {
+      // zero sigma means that the hill does not depend on this variable
+      if(hill.invsigma[i]==0.0) halfwidth[i]=std::numeric_limits<double>::infinity();
+      else halfwidth[i]=sqrt(2.0*DP2CUTOFF)/abs(hill.invsigma[i]);
+    }
+  }
+  return halfwidth;
+}
+
 vector<unsigned> MetaD::getGaussianSupport(const Gaussian& hill)
 {
   vector<unsigned> nneigh;
@@ -1510,8 +1626,18 @@ double MetaD::getBiasAndDerivatives(const vector<double>& cv, double* der)
     }
     unsigned stride=comm.Get_size();
     unsigned rank=comm.Get_rank();
-    for(unsigned i=rank; i<hills_.size(); i+=stride) {
-      bias+=evaluateGaussian(cv,hills_[i],der);
+// only the hills whose support might contain cv are evaluated
+    const vector<unsigned>* candidates;
+    if(doInt_) {
+      vector<double> tmpcv(cv);
+      if(tmpcv[0]<lowI_) tmpcv[0]=lowI_;
+      if(tmpcv[0]>uppI_) tmpcv[0]=uppI_;
+      candidates=&hillsIndex_->getCandidates(tmpcv,hillsCandidates_);
+    } else {
+      candidates=&hillsIndex_->getCandidates(cv,hillsCandidates_);
+    }
+    for(unsigned i=rank; i<candidates->size(); i+=stride) {
+      bias+=evaluateGaussian(cv,hills_[(*candidates)[i]],der);
     }
     comm.Sum(bias);
     if(der) comm.Sum(der,getNumberOfArguments());
@@ -1761,6 +1887,7 @@ void MetaD::update() {
       // Flying Gaussian
       if (flying) {
         hills_.clear();
+        hillsIndex_->clear();
         comm.Barrier();
       }
 
@@ -29,6 +29,7 @@
 #include "core/FlexibleBin.h"
 #include "tools/Matrix.h"
 #include "tools/Random.h"
+#include "tools/BucketIndex.h"
 #include <string>
 #include <cstring>
 #include "tools/File.h"
@@ -235,6 +236,9 @@ private:
   vector<double> sigma0min_;
   vector<double> sigma0max_;
   vector< vector<Gaussian> > hills_;
+/// indexes used to find the hills close to a point when grids are not used
+  vector<std::unique_ptr<BucketIndex>> hillsIndex_;
+  vector<unsigned> hillsCandidates_;
   vector<std::unique_ptr<OFile>> hillsOfiles_;
   vector<std::unique_ptr<OFile>> gridfiles_;
   vector<std::unique_ptr<GridBase>> BiasGrids_;
@@ -281,6 +285,7 @@ public:
   void calculate() override;
   void update() override;
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
   bool checkNeedsGradients()const override;
 };
 
@@ -602,6 +607,15 @@ PBMetaD::PBMetaD(const ActionOptions& ao):
 
   // initializing vector of hills
   hills_.resize(getNumberOfArguments());
+  if(!grid_) {
+    hillsIndex_.resize(getNumberOfArguments());
+    for(unsigned i=0; i<getNumberOfArguments(); i++) {
+      vector<bool> periodic(1,getPntrToArgument(i)->isPeriodic());
+      vector<double> pmin(1,0.0),pmax(1,0.0);
+      if(periodic[0]) getPntrToArgument(i)->getDomain(pmin[0],pmax[0]);
+      hillsIndex_[i].reset(new BucketIndex(periodic,pmin,pmax));
+    }
+  }
 
   // restart from external grid
   bool restartedFromGrid=false;
@@ -819,8 +833,15 @@ void PBMetaD::writeGaussian(unsigned iarg, const Gaussian& hill, OFile *ofile)
 
 void PBMetaD::addGaussian(unsigned iarg, const Gaussian& hill)
 {
-  if(!grid_) {hills_[iarg].push_back(hill);}
-  else {
+  if(!grid_) {
+    // half width of the region where the hill is not truncated
+    vector<double> halfwidth(1);
+    if(hill.multivariate) halfwidth[0]=sqrt(2.0*DP2CUTOFF/hill.sigma[0]);
+    else if(hill.invsigma[0]==0.0) halfwidth[0]=std::numeric_limits<double>::infinity();
+    else halfwidth[0]=sqrt(2.0*DP2CUTOFF)/abs(hill.invsigma[0]);
+    hillsIndex_[iarg]->add(hills_[iarg].size(),hill.center,halfwidth);
+    hills_[iarg].push_back(hill);
+  } else {
     vector<unsigned> nneighb=getGaussianSupport(iarg, hill);
     vector<Grid::index_t> neighbors=BiasGrids_[iarg]->getNeighbors(hill.center,nneighb);
     vector<double> der(1);
@@ -886,8 +907,18 @@ double PBMetaD::getBiasAndDerivatives(unsigned iarg, const vector<double>& cv, d
   if(!grid_) {
     unsigned stride=comm.Get_size();
     unsigned rank=comm.Get_rank();
-    for(unsigned i=rank; i<hills_[iarg].size(); i+=stride) {
-      bias += evaluateGaussian(iarg,cv,hills_[iarg][i],der);
+// only the hills whose support might contain cv are evaluated
+    const vector<unsigned>* candidates;
+    if(doInt_[iarg]) {
+      vector<double> tmpcv(cv);
+      if(tmpcv[0]<lowI_[iarg]) tmpcv[0]=lowI_[iarg];
+      if(tmpcv[0]>uppI_[iarg]) tmpcv[0]=uppI_[iarg];
+      candidates=&hillsIndex_[iarg]->getCandidates(tmpcv,hillsCandidates_);
+    } else {
+      candidates=&hillsIndex_[iarg]->getCandidates(cv,hillsCandidates_);
+    }
+    for(unsigned i=rank; i<candidates->size(); i+=stride) {
+      bias += evaluateGaussian(iarg,cv,hills_[iarg][(*candidates)[i]],der);
     }
     comm.Sum(bias);
     if(der) comm.Sum(der,1);
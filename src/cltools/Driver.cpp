@@ -23,6 +23,7 @@
 #include "CLToolRegister.h"
 #include "tools/Tools.h"
 #include "core/PlumedMain.h"
+#include "core/ActionSet.h"
 #include "tools/Communicator.h"
 #include "tools/Random.h"
 #include "tools/Pbc.h"
@@ -31,6 +32,15 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "tools/Units.h"
 #include "tools/PDB.h"
 #include "tools/FileBase.h"
@@ -57,6 +67,16 @@ using namespace PLMD::molfile;
 #include <xdrfile/xdrfile_xtc.h>
 #endif
 
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <unistd.h>
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES>0
+#define __PLUMED_DRIVER_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+#endif
+
 using namespace std;
 
 namespace PLMD {
@@ -174,6 +194,21 @@ Notice that the xdrfile implementation of xtc and trr
 is more robust than the molfile one, since it provides support for generic cell shapes.
 In addition, it allows \ref DUMPATOMS to write compressed xtc files.
 
+With `--prefetch N`, up to N frames are decoded in advance by a background thread while PLUMED analyzes the previous ones.
+This can save time when reading compressed or large trajectories. By default, each frame is read only when it is needed.
+
+When PLUMED is compiled with MPI, a long trajectory can be analyzed in parallel with the `--parallel-frames` option.
+The trajectory is split in contiguous chunks of frames, one per process, and each process
+analyzes its chunk with an independent copy of PLUMED. At the end, the output files written by the
+processes are concatenated in frame order, so that they are the same that would have been obtained by a serial run:
+\verbatim
+mpirun -np 8 plumed driver --plumed plumed.dat --ixtc traj.xtc --parallel-frames
+\endverbatim
+This can only be done when the result obtained on a frame does not depend on the previous ones.
+Thus, inputs including actions that accumulate history (e.g. \ref METAD or \ref AVERAGE) or
+read files step by step (e.g. \ref READ) are refused. The trajectory should also contain at least
+as many frames as processes.
+
 
 */
 //+ENDPLUMEDOC
@@ -195,6 +230,648 @@ static int register_cb(void *v, vmdplugin_t *p) {
 }
 #endif
 
+/// Output files of --parallel-frames in binary formats made of independent blocks, that can be merged by concatenating them
+static bool isConcatenableBinary(const std::string & path) {
+  const std::string ext=Tools::extension(path);
+  return ext=="gz" || ext=="xtc" || ext=="trr";
+}
+
+/// Output files of --parallel-frames that can be merged. Binary grids (.bin) start with a header and cannot
+static bool canMergeOutput(const std::string & path) {
+  return Tools::extension(path)!="bin";
+}
+
+/// A frame decoded from a trajectory file
+template<typename real>
+struct TrajectoryFrame {
+  int natoms=0;
+/// true if the step was read from the trajectory (dlp4, or xtc/trr with --trajectory-stride 0)
+  bool hasStep=false;
+  long int step=0;
+/// true if the timestep was read from the trajectory (dlp4)
+  bool hasTimestep=false;
+  real timestep=0.0;
+  std::vector<real> coordinates;
+  std::vector<real> cell;
+/// masses and charges read from the trajectory (dlp4), empty otherwise
+  std::vector<real> masses;
+  std::vector<real> charges;
+};
+
+/// Reads the frames of a trajectory one at a time.
+/// Text formats are parsed directly from the file mapped in memory when possible,
+/// without copying each line to a temporary string.
+template<typename real>
+class TrajectoryReader {
+  std::string fmt;
+  std::string path;
+  bool pbc_cli_given;
+  std::vector<double> pbc_cli_box;
+/// take the step from xtc/trr files
+  bool stepFromFile;
+  int command_line_natoms;
+  void* molfile_api;
+/// text formats are read either from memory or from a FILE
+  FILE* fp=NULL;
+  bool ownsFp=false;
+  void* map=NULL;
+  size_t mapLength=0;
+  const char* textPos=NULL;
+  const char* textEnd=NULL;
+  std::string lineBuffer;
+/// number of atoms, as read from the header (molfile, xdr, dlp4) or from the last frame (xyz, gro)
+  int natoms=0;
+  int lvl=0;
+  int pb=1;
+/// index of the next frame, and range of frames returned by read()
+  unsigned long frame=0;
+  unsigned long firstFrame=0;
+  unsigned long lastFrame=std::numeric_limits<unsigned long>::max();
+#ifdef __PLUMED_HAS_XDRFILE
+  XDRFILE* xd=NULL;
+  std::unique_ptr<rvec[]> pos;
+#endif
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  void* h_in=NULL;
+  molfile_timestep_t ts_in;
+  std::unique_ptr<float[]> ts_in_coords;
+#endif
+/// get the next line of a text file, without its terminating newline
+  bool getline(const char*& begin,const char*& end);
+/// get the next blank-separated word in [pos,end)
+  static bool nextWord(const char*& pos,const char* end,const char*& begin,const char*& wend);
+/// convert the beginning of a word to a number, as sscanf with %lf would do.
+/// returns a pointer past the converted characters, NULL if nothing could be converted
+  static const char* toDouble(const char* begin,const char* end,double& d);
+/// decode the next frame, or skip it when f is NULL
+  bool next(TrajectoryFrame<real>* f);
+  bool nextText(TrajectoryFrame<real>* f);
+public:
+  TrajectoryReader(const std::string& fmt,bool pbc_cli_given,const std::vector<double>& pbc_cli_box,bool stepFromFile,
+                   int command_line_natoms,void* molfile_api);
+  TrajectoryReader(const TrajectoryReader&) = delete;
+  TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+  ~TrajectoryReader();
+/// open a trajectory file, returns false if it cannot be opened
+  bool open(const std::string& file);
+/// read a text trajectory from an already open stream
+  void open(FILE* in);
+/// only return frames in [first,last), frames before first are skipped without being decoded
+  void setRange(unsigned long first,unsigned long last);
+/// decode the next frame, returns false at the end of the trajectory
+  bool read(TrajectoryFrame<real>& f);
+/// count the frames in the trajectory file, reading it from the beginning
+  unsigned long countFrames()const;
+};
+
+template<typename real>
+TrajectoryReader<real>::TrajectoryReader(const std::string& fmt,bool pbc_cli_given,const std::vector<double>& pbc_cli_box,bool stepFromFile,
+    int command_line_natoms,void* molfile_api):
+  fmt(fmt),
+  pbc_cli_given(pbc_cli_given),
+  pbc_cli_box(pbc_cli_box),
+  stepFromFile(stepFromFile),
+  command_line_natoms(command_line_natoms),
+  molfile_api(molfile_api)
+{
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  ts_in.coords=NULL;
+  ts_in.velocities=NULL;
+  ts_in.A=-1; // we use this to check whether cell is provided or not
+#endif
+}
+
+template<typename real>
+TrajectoryReader<real>::~TrajectoryReader() {
+#ifdef __PLUMED_DRIVER_MMAP
+  if(map) munmap(map,mapLength);
+#endif
+  if(fp && ownsFp) std::fclose(fp);
+#ifdef __PLUMED_HAS_XDRFILE
+  if(xd) xdrfile_close(xd);
+#endif
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  if(h_in) static_cast<molfile_plugin_t*>(molfile_api)->close_file_read(h_in);
+#endif
+}
+
+template<typename real>
+bool TrajectoryReader<real>::open(const std::string& file) {
+  path=file;
+  if(molfile_api) {
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+    molfile_plugin_t* api=static_cast<molfile_plugin_t*>(molfile_api);
+    h_in = api->open_file_read(file.c_str(), fmt.c_str(), &natoms);
+    if(!h_in) return false;
+    if(natoms==MOLFILE_NUMATOMS_UNKNOWN) {
+      if(command_line_natoms>=0) natoms=command_line_natoms;
+      else plumed_merror("this file format does not provide number of atoms; use --natoms on the command line");
+    }
+    ts_in_coords.reset(new float [3*natoms]);
+    ts_in.coords = ts_in_coords.get();
+#endif
+    return true;
+  }
+  if(fmt=="xdr-xtc" || fmt=="xdr-trr") {
+#ifdef __PLUMED_HAS_XDRFILE
+    xd=xdrfile_open(file.c_str(),"r");
+    if(!xd) return false;
+    std::string name(file);
+    if(fmt=="xdr-xtc") read_xtc_natoms(&name[0],&natoms);
+    if(fmt=="xdr-trr") read_trr_natoms(&name[0],&natoms);
+    pos.reset(new rvec[natoms]);
+#endif
+    return true;
+  }
+#ifdef __PLUMED_DRIVER_MMAP
+  int fd=::open(file.c_str(),O_RDONLY);
+  if(fd<0) return false;
+  struct stat st;
+  if(fstat(fd,&st)==0 && S_ISREG(st.st_mode) && st.st_size>0) {
+    void* p=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    if(p!=MAP_FAILED) {
+      map=p;
+      mapLength=st.st_size;
+      posix_madvise(map,mapLength,POSIX_MADV_SEQUENTIAL);
+      textPos=static_cast<const char*>(map);
+      textEnd=textPos+mapLength;
+    }
+  }
+// the mapping remains valid after the file descriptor is closed
+  ::close(fd);
+#endif
+  if(!map) {
+    fp=std::fopen(file.c_str(),"r");
+    if(!fp) return false;
+    ownsFp=true;
+  }
+  if(fmt=="dlp4") {
+    const char* b;
+    const char* e;
+    if(!getline(b,e)) plumed_merror("error reading title");
+    if(!getline(b,e)) plumed_merror("error reading atoms");
+    sscanf(std::string(b,e).c_str(),"%d %d %d",&lvl,&pb,&natoms);
+  }
+  return true;
+}
+
+template<typename real>
+void TrajectoryReader<real>::open(FILE* in) {
+  plumed_massert(!molfile_api && fmt!="xdr-xtc" && fmt!="xdr-trr","only text trajectories can be read from a stream");
+  fp=in;
+  if(fmt=="dlp4") {
+    const char* b;
+    const char* e;
+    if(!getline(b,e)) plumed_merror("error reading title");
+    if(!getline(b,e)) plumed_merror("error reading atoms");
+    sscanf(std::string(b,e).c_str(),"%d %d %d",&lvl,&pb,&natoms);
+  }
+}
+
+template<typename real>
+void TrajectoryReader<real>::setRange(unsigned long first,unsigned long last) {
+  firstFrame=first;
+  lastFrame=last;
+}
+
+template<typename real>
+bool TrajectoryReader<real>::getline(const char*& begin,const char*& end) {
+  if(map) {
+// as Tools::getline, a last line without a newline is not returned
+    if(textPos>=textEnd) return false;
+    const char* nl=static_cast<const char*>(std::memchr(textPos,'\n',textEnd-textPos));
+    if(!nl) return false;
+    begin=textPos;
+    end=nl;
+    if(end>begin && *(end-1)=='\r') end--;
+    textPos=nl+1;
+    return true;
+  }
+  if(!Tools::getline(fp,lineBuffer)) return false;
+  begin=lineBuffer.c_str();
+  end=begin+lineBuffer.length();
+  return true;
+}
+
+template<typename real>
+bool TrajectoryReader<real>::nextWord(const char*& pos,const char* end,const char*& begin,const char*& wend) {
+  while(pos<end && std::isspace(static_cast<unsigned char>(*pos))) pos++;
+  if(pos==end) return false;
+  begin=pos;
+  while(pos<end && !std::isspace(static_cast<unsigned char>(*pos))) pos++;
+  wend=pos;
+  return true;
+}
+
+template<typename real>
+const char* TrajectoryReader<real>::toDouble(const char* begin,const char* end,double& d) {
+// fast path for plain decimal numbers: when the digits fit in the 53 bits of the mantissa
+// and the power of ten is exact, a single multiplication or division is correctly rounded,
+// and thus gives the same result of strtod
+  static const double powersOfTen[]= {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+                                      1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22
+                                     };
+  const char* p=begin;
+  bool negative=false;
+  if(p<end && (*p=='-' || *p=='+')) negative=(*p++=='-');
+  std::uint64_t mantissa=0;
+  int digits=0;
+  int exponent=0;
+  const char* firstDigit=p;
+  for(; p<end && *p>='0' && *p<='9'; p++) {
+    if(digits<19) mantissa=10*mantissa+(*p-'0');
+    if(mantissa>0) digits++;
+    if(digits>19) exponent++;
+  }
+  bool hasDigits=(p>firstDigit);
+  if(p<end && *p=='.') {
+    p++;
+    const char* firstDecimal=p;
+    for(; p<end && *p>='0' && *p<='9'; p++) {
+      if(digits<19) {
+        mantissa=10*mantissa+(*p-'0');
+        exponent--;
+      }
+      if(mantissa>0) digits++;
+    }
+    hasDigits=hasDigits || (p>firstDecimal);
+  }
+  if(hasDigits && p<end && (*p=='e' || *p=='E')) {
+    const char* q=p+1;
+    bool negativeExponent=false;
+    if(q<end && (*q=='-' || *q=='+')) negativeExponent=(*q++=='-');
+    int e=0;
+    const char* firstExponentDigit=q;
+    for(; q<end && *q>='0' && *q<='9' && e<10000; q++) e=10*e+(*q-'0');
+    if(q>firstExponentDigit) {
+      exponent+=negativeExponent?-e:e;
+      p=q;
+    }
+  }
+  if(hasDigits && p==end && digits<=15 && exponent>=-22 && exponent<=22) {
+    double v=static_cast<double>(mantissa);
+    if(exponent<0) v/=powersOfTen[-exponent];
+    else v*=powersOfTen[exponent];
+    d=negative?-v:v;
+    return p;
+  }
+// words are not null terminated, so they are copied to a small buffer (sscanf reads at most 100 characters anyway)
+  char buffer[128];
+  size_t n=std::min<size_t>(end-begin,100);
+  std::memcpy(buffer,begin,n);
+  buffer[n]='\0';
+  char* stop;
+  double v=std::strtod(buffer,&stop);
+  if(stop==buffer) return NULL;
+  d=v;
+  return begin+(stop-buffer);
+}
+
+template<typename real>
+bool TrajectoryReader<real>::nextText(TrajectoryFrame<real>* f) {
+  const char* b;
+  const char* e;
+  const char* w;
+  const char* we;
+  if(!getline(b,e)) return false;
+  if(fmt=="gro") {
+    if(!getline(b,e)) plumed_merror("premature end of trajectory file");
+  }
+  if(fmt=="xyz" || fmt=="gro") {
+    const char* p=b;
+    if(nextWord(p,e,w,we)) {
+      char buffer[128];
+      size_t n=std::min<size_t>(we-w,100);
+      std::memcpy(buffer,w,n);
+      buffer[n]='\0';
+      char* stop;
+      long v=std::strtol(buffer,&stop,10);
+      if(stop!=buffer) natoms=v;
+    }
+  }
+  if(!f) {
+// skip the frame without decoding it
+    int nlines=0;
+    if(fmt=="xyz" || fmt=="gro") nlines=natoms+1;
+    else if(fmt=="dlp4") nlines=(pbc_cli_given?0:3)+natoms*(2+(lvl>0?1:0)+(lvl>1?1:0));
+    for(int i=0; i<nlines; i++) if(!getline(b,e)) plumed_merror("premature end of trajectory file");
+    return true;
+  }
+  f->natoms=natoms;
+  f->hasStep=false;
+  f->hasTimestep=false;
+  f->coordinates.resize(3*natoms);
+  f->cell.assign(9,real(0.0));
+  if(fmt=="dlp4") {
+    char xa[9];
+    int xb,xc,xd;
+    double t;
+    if(sscanf(std::string(b,e).c_str(),"%8s %ld %d %d %d %lf",xa,&f->step,&xb,&xc,&xd,&t)>=2) f->hasStep=true;
+    f->timestep=real(t);
+    f->hasTimestep=true;
+    f->masses.resize(natoms);
+    f->charges.resize(natoms);
+  } else {
+    f->masses.clear();
+    f->charges.clear();
+  }
+  if(fmt=="xyz") {
+    if(!getline(b,e)) plumed_merror("premature end of trajectory file");
+    std::vector<double> celld(9,0.0);
+    if(pbc_cli_given==false) {
+      double v[9]= {0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
+      unsigned nwords=0;
+      bool parsing=true;
+      const char* p=b;
+      while(nextWord(p,e,w,we)) {
+// as with sscanf, numbers are read until the first word that does not start with a number
+        if(parsing && nwords<9) {
+          const char* stop=toDouble(w,we,v[nwords]);
+          parsing=(stop==we);
+        }
+        nwords++;
+      }
+      if(nwords==3) {
+        celld[0]=v[0]; celld[4]=v[1]; celld[8]=v[2];
+      } else if(nwords==9) {
+        for(unsigned i=0; i<9; i++) celld[i]=v[i];
+      } else plumed_merror("needed box in second line of xyz file");
+    } else {			// from command line
+      celld=pbc_cli_box;
+    }
+    for(unsigned i=0; i<9; i++) f->cell[i]=real(celld[i]);
+  }
+  if(fmt=="dlp4") {
+    std::vector<double> celld(9,0.0);
+    if(pbc_cli_given==false) {
+      if(!getline(b,e)) plumed_merror("error reading vector a of cell");
+      sscanf(std::string(b,e).c_str(),"%lf %lf %lf",&celld[0],&celld[1],&celld[2]);
+      if(!getline(b,e)) plumed_merror("error reading vector b of cell");
+      sscanf(std::string(b,e).c_str(),"%lf %lf %lf",&celld[3],&celld[4],&celld[5]);
+      if(!getline(b,e)) plumed_merror("error reading vector c of cell");
+      sscanf(std::string(b,e).c_str(),"%lf %lf %lf",&celld[6],&celld[7],&celld[8]);
+    } else {
+      celld=pbc_cli_box;
+    }
+    for(auto i=0; i<9; i++) f->cell[i]=real(celld[i])*0.1;
+  }
+  int ddist=0;
+  // Read coordinates
+  for(int i=0; i<natoms; i++) {
+    if(!getline(b,e)) plumed_merror("premature end of trajectory file");
+    double cc[3];
+    if(fmt=="xyz") {
+      const char* p=b;
+      bool ok=nextWord(p,e,w,we);
+      for(unsigned k=0; ok && k<3; k++) ok=nextWord(p,e,w,we) && toDouble(w,we,cc[k]);
+      if(!ok) plumed_merror("cannot read line"+std::string(b,e));
+    } else if(fmt=="gro") {
+      // do the gromacs way
+      const size_t len=e-b;
+      if(!i) {
+        //
+        // calculate the distance between dots (as in gromacs gmxlib/confio.c, routine get_w_conf )
+        //
+        const char *p1, *p2, *p3;
+        p1 = static_cast<const char*>(std::memchr(b, '.', len));
+        if (p1 == NULL) plumed_merror("seems there are no coordinates in the gro file");
+        p2 = static_cast<const char*>(std::memchr(&p1[1], '.', e-&p1[1]));
+        if (p2 == NULL) plumed_merror("seems there is only one coordinates in the gro file");
+        ddist = p2 - p1;
+        p3 = static_cast<const char*>(std::memchr(&p2[1], '.', e-&p2[1]));
+        if (p3 == NULL) plumed_merror("seems there are only two coordinates in the gro file");
+        if (p3 - p2 != ddist) plumed_merror("not uniform spacing in fields in the gro file");
+      }
+      for(unsigned k=0; k<3; k++) {
+        const size_t start=20+k*ddist;
+        if(start>len) plumed_merror("cannot read line"+std::string(b,e));
+        const char* fb=b+start;
+        const char* fe=b+std::min(len,start+ddist);
+// fields that are not plain numbers are converted as the other numbers read by plumed
+        const char* p=fb;
+        if(!(nextWord(p,fe,w,we) && toDouble(w,we,cc[k])==we && !nextWord(p,fe,w,we)))
+          Tools::convert(std::string(fb,fe),cc[k]);
+      }
+    } else if(fmt=="dlp4") {
+      char dummy[9];
+      int idummy;
+      double m,c;
+      sscanf(std::string(b,e).c_str(),"%8s %d %lf %lf",dummy,&idummy,&m,&c);
+      f->masses[i]=real(m);
+      f->charges[i]=real(c);
+      if(!getline(b,e)) plumed_merror("error reading coordinates");
+      sscanf(std::string(b,e).c_str(),"%lf %lf %lf",&cc[0],&cc[1],&cc[2]);
+      cc[0]*=0.1;
+      cc[1]*=0.1;
+      cc[2]*=0.1;
+      if(lvl>0) {
+        if(!getline(b,e)) plumed_merror("error skipping velocities");
+      }
+      if(lvl>1) {
+        if(!getline(b,e)) plumed_merror("error skipping forces");
+      }
+    } else plumed_error();
+    f->coordinates[3*i]=real(cc[0]);
+    f->coordinates[3*i+1]=real(cc[1]);
+    f->coordinates[3*i+2]=real(cc[2]);
+  }
+  if(fmt=="gro") {
+    if(!getline(b,e)) plumed_merror("premature end of trajectory file");
+    std::vector<std::string> words=Tools::getWords(std::string(b,e));
+    if(words.size()<3) plumed_merror("cannot understand box format");
+    std::vector<real>& cell(f->cell);
+    Tools::convert(words[0],cell[0]);
+    Tools::convert(words[1],cell[4]);
+    Tools::convert(words[2],cell[8]);
+    if(words.size()>3) Tools::convert(words[3],cell[1]);
+    if(words.size()>4) Tools::convert(words[4],cell[2]);
+    if(words.size()>5) Tools::convert(words[5],cell[3]);
+    if(words.size()>6) Tools::convert(words[6],cell[5]);
+    if(words.size()>7) Tools::convert(words[7],cell[6]);
+    if(words.size()>8) Tools::convert(words[8],cell[7]);
+  }
+  return true;
+}
+
+template<typename real>
+bool TrajectoryReader<real>::next(TrajectoryFrame<real>* f) {
+  if(molfile_api) {
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+    molfile_plugin_t* api=static_cast<molfile_plugin_t*>(molfile_api);
+// a null timestep skips the frame
+    int rc = api->read_next_timestep(h_in, natoms, f?&ts_in:NULL);
+    if(rc==MOLFILE_EOF) return false;
+    if(!f) return true;
+    f->natoms=natoms;
+    f->hasStep=false;
+    f->hasTimestep=false;
+    f->masses.clear();
+    f->charges.clear();
+    f->coordinates.resize(3*natoms);
+    f->cell.assign(9,real(0.0));
+    std::vector<real>& cell(f->cell);
+    if(pbc_cli_given==false) {
+      if(ts_in.A>0.0) { // this is negative if molfile does not provide box
+        // info on the cell: convert using pbcset.tcl from pbctools in vmd distribution
+        real cosBC=cos(real(ts_in.alpha)*pi/180.);
+        //double sinBC=sin(ts_in.alpha*pi/180.);
+        real cosAC=cos(real(ts_in.beta)*pi/180.);
+        real cosAB=cos(real(ts_in.gamma)*pi/180.);
+        real sinAB=sin(real(ts_in.gamma)*pi/180.);
+        real Ax=real(ts_in.A);
+        real Bx=real(ts_in.B)*cosAB;
+        real By=real(ts_in.B)*sinAB;
+        real Cx=real(ts_in.C)*cosAC;
+        real Cy=(real(ts_in.C)*real(ts_in.B)*cosBC-Cx*Bx)/By;
+        real Cz=sqrt(real(ts_in.C)*real(ts_in.C)-Cx*Cx-Cy*Cy);
+        cell[0]=Ax/10.; cell[1]=0.; cell[2]=0.;
+        cell[3]=Bx/10.; cell[4]=By/10.; cell[5]=0.;
+        cell[6]=Cx/10.; cell[7]=Cy/10.; cell[8]=Cz/10.;
+      }
+    } else {
+      for(unsigned i=0; i<9; i++)cell[i]=pbc_cli_box[i];
+    }
+    // info on coords
+    // the order is xyzxyz...
+    for(int i=0; i<3*natoms; i++) {
+      f->coordinates[i]=real(ts_in.coords[i])/real(10.); //convert to nm
+    }
+#endif
+    return true;
+  }
+  if(fmt=="xdr-xtc" || fmt=="xdr-trr") {
+#ifdef __PLUMED_HAS_XDRFILE
+    int localstep;
+    float time;
+    matrix box;
+    float prec,lambda;
+    int ret=exdrOK;
+    if(fmt=="xdr-xtc") ret=read_xtc(xd,natoms,&localstep,&time,box,pos.get(),&prec);
+    if(fmt=="xdr-trr") ret=read_trr(xd,natoms,&localstep,&time,&lambda,box,pos.get(),NULL,NULL);
+    if(ret!=exdrOK) return false;
+    if(!f) return true;
+    f->natoms=natoms;
+    f->hasStep=stepFromFile;
+    f->step=localstep;
+    f->hasTimestep=false;
+    f->masses.clear();
+    f->charges.clear();
+    f->coordinates.resize(3*natoms);
+    f->cell.resize(9);
+    for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) f->cell[3*i+j]=box[i][j];
+    for(int i=0; i<natoms; i++) for(unsigned j=0; j<3; j++)
+        f->coordinates[3*i+j]=real(pos[i][j]);
+#endif
+    return true;
+  }
+  return nextText(f);
+}
+
+template<typename real>
+bool TrajectoryReader<real>::read(TrajectoryFrame<real>& f) {
+  for(; frame<firstFrame; frame++) if(!next(NULL)) return false;
+  if(frame>=lastFrame) return false;
+  if(!next(&f)) return false;
+  frame++;
+  return true;
+}
+
+template<typename real>
+unsigned long TrajectoryReader<real>::countFrames()const {
+  TrajectoryReader<real> counter(fmt,pbc_cli_given,pbc_cli_box,stepFromFile,command_line_natoms,molfile_api);
+  if(!counter.open(path)) plumed_merror("cannot open trajectory file " + path);
+  unsigned long n=0;
+  while(counter.next(NULL)) n++;
+  return n;
+}
+
+/// Decodes frames in a background thread, keeping a bounded number of them
+/// ready while the current one is analyzed.
+template<typename real>
+class TrajectoryPrefetcher {
+  TrajectoryReader<real>& reader;
+/// ring of decoded frames; buffers of frames given to the caller are recycled
+  std::vector<TrajectoryFrame<real>> ring;
+  unsigned head=0;
+  unsigned count=0;
+  bool finished=false;
+  bool stop=false;
+/// error raised while reading, rethrown when the frame that caused it is requested
+  std::exception_ptr failure;
+  std::mutex mtx;
+  std::condition_variable ready;
+  std::condition_variable space;
+  std::thread worker;
+  void run();
+public:
+  TrajectoryPrefetcher(TrajectoryReader<real>& reader,unsigned size);
+  ~TrajectoryPrefetcher();
+/// get the next frame, returns false at the end of the trajectory
+  bool next(TrajectoryFrame<real>& f);
+};
+
+template<typename real>
+TrajectoryPrefetcher<real>::TrajectoryPrefetcher(TrajectoryReader<real>& reader,unsigned size):
+  reader(reader),
+  ring(size)
+{
+  plumed_assert(size>0);
+  worker=std::thread(&TrajectoryPrefetcher<real>::run,this);
+}
+
+template<typename real>
+TrajectoryPrefetcher<real>::~TrajectoryPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop=true;
+  }
+  space.notify_one();
+  worker.join();
+}
+
+template<typename real>
+void TrajectoryPrefetcher<real>::run() {
+  TrajectoryFrame<real> f;
+  while(true) {
+    bool ok=false;
+    try {
+      ok=reader.read(f);
+    } catch(...) {
+      std::lock_guard<std::mutex> lock(mtx);
+      failure=std::current_exception();
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    if(!ok) {
+      finished=true;
+      lock.unlock();
+      ready.notify_one();
+      return;
+    }
+    space.wait(lock,[this] {return stop || count<ring.size();});
+    if(stop) return;
+    std::swap(f,ring[(head+count)%ring.size()]);
+    count++;
+    lock.unlock();
+    ready.notify_one();
+  }
+}
+
+template<typename real>
+bool TrajectoryPrefetcher<real>::next(TrajectoryFrame<real>& f) {
+  std::unique_lock<std::mutex> lock(mtx);
+  ready.wait(lock,[this] {return count>0 || finished;});
+  if(count==0) {
+    if(failure) std::rethrow_exception(failure);
+    return false;
+  }
+  std::swap(f,ring[head]);
+  head=(head+1)%ring.size();
+  count--;
+  lock.unlock();
+  space.notify_one();
+  return true;
+}
+
 template<typename real>
 class Driver : public CLTool {
 public:
@@ -219,7 +896,10 @@ void Driver<real>::registerKeywords( Keywords& keys ) {
            " currently working only for xtc/trr files read with --ixtc/--trr)"
 #endif
           );
+  keys.add("compulsory","--prefetch","0","number of frames decoded in advance by a background thread while the current frame is analyzed (0 reads each frame when it is needed)");
   keys.add("compulsory","--multi","0","set number of replicas for multi environment (needs MPI)");
+  keys.addFlag("--parallel-frames",false,"split the trajectory in contiguous chunks analyzed by independent copies of plumed on different MPI processes. "
+               "Output files are merged in frame order at the end (needs MPI)");
   keys.addFlag("--noatoms",false,"don't read in a trajectory.  Just use colvar files as specified in plumed.dat");
   keys.addFlag("--parse-only",false,"read the plumed input file and stop");
   keys.add("atoms","--ixyz","the trajectory in xyz format");
@@ -331,12 +1011,24 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   parse("--multi",multi);
   Communicator intracomm;
   Communicator intercomm;
+// set up for frame-parallel driver:
+  bool parallelFrames=false;
+  parseFlag("--parallel-frames",parallelFrames);
+  if(parallelFrames) {
+    if(!Communicator::initialized()) error("--parallel-frames needs MPI");
+    if(multi) error("--parallel-frames cannot be used with --multi");
+    if(noatoms || parseOnly) error("--parallel-frames needs a trajectory");
+    if(debug_dd || debug_pd) error("--parallel-frames cannot be used with domain/particle decomposition");
+  }
   if(multi) {
     int ntot=pc.Get_size();
     int nintra=ntot/multi;
     if(multi*nintra!=ntot) error("invalid number of processes for multi environment");
     pc.Split(pc.Get_rank()/nintra,pc.Get_rank(),intracomm);
     pc.Split(pc.Get_rank()%nintra,pc.Get_rank(),intercomm);
+  } else if(parallelFrames) {
+// each process analyzes its own chunk of frames
+    pc.Split(pc.Get_rank(),0,intracomm);
   } else {
     intracomm.Set_comm(pc.Get_comm());
   }
@@ -365,6 +1057,8 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   real timestep=real(t);
 // the stride
   unsigned stride; parse("--trajectory-stride",stride);
+// number of frames decoded in advance
+  unsigned prefetch; parse("--prefetch",prefetch);
 // are we writing forces
   string dumpforces(""), debugforces(""), dumpforcesFmt("%f");;
   bool dumpfullvirial=false;
@@ -376,22 +1070,14 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   if(dumpforces!="") parseFlag("--dump-full-virial",dumpfullvirial);
   if( debugforces!="" && (debug_dd || debug_pd) ) error("cannot debug forces and domain/particle decomposition at same time");
   if( debugforces!="" && sizeof(real)!=sizeof(double) ) error("cannot debug forces in single precision mode");
+  if( debugforces!="" && parallelFrames ) error("cannot debug forces with --parallel-frames");
 
   real kt=-1.0;
   parse("--kt",kt);
   string trajectory_fmt;
 
-  bool use_molfile=false;
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
   molfile_plugin_t *api=NULL;
-  void *h_in=NULL;
-  molfile_timestep_t ts_in; // this is the structure that has the timestep
-// a std::unique_ptr<float> with the same scope as ts_in
-// it is necessary in order to store the pointer to ts_in.coords
-  std::unique_ptr<float[]> ts_in_coords;
-  ts_in.coords=ts_in_coords.get();
-  ts_in.velocities=NULL;
-  ts_in.A=-1; // we use this to check whether cell is provided or not
 #endif
 
 // Read in an xyz file
@@ -418,7 +1104,6 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
         fprintf(out,"\nDRIVER: Found molfile format trajectory %s with name %s\n",plugins[i]->name,traj_molfile.c_str());
         trajectoryFile=traj_molfile;
         trajectory_fmt=string(plugins[i]->name);
-        use_molfile=true;
         api = plugins[i];
       }
     }
@@ -502,7 +1187,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     if( !Communicator::initialized() ) error("needs mpi for debug-pd");
   }
 
-  PlumedMain p;
+// with --parallel-frames, plumed is deleted before merging its output files
+  std::unique_ptr<PlumedMain> plumedMain(new PlumedMain);
+  PlumedMain& p(*plumedMain);
   int rr=sizeof(real);
   p.cmd("setRealPrecision",&rr);
   int checknatoms=-1;
@@ -523,11 +1210,21 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   p.cmd("setMDEngine","driver");
   p.cmd("setTimestep",&timestep);
   p.cmd("setPlumedDat",plumedFile.c_str());
-  p.cmd("setLog",out);
+// with --parallel-frames, files written by processes other than the first one have a suffix
+// and are appended at the end to those of the first one. Their log is discarded.
+  std::string chunkSuffix;
+  FILE* chunkLog=NULL;
+  if(parallelFrames && pc.Get_rank()>0) {
+    Tools::convert(pc.Get_rank(),chunkSuffix);
+    chunkSuffix=".chunk"+chunkSuffix;
+    p.setSuffix(chunkSuffix);
+    chunkLog=std::fopen("/dev/null","w");
+    p.cmd("setLog",chunkLog);
+  } else {
+    p.cmd("setLog",out);
+  }
 
   int natoms;
-  int lvl=0;
-  int pb=1;
 
   if(parseOnly) {
     if(command_line_natoms<0) error("--parseOnly requires setting the number of atoms with --natoms");
@@ -535,13 +1232,19 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   }
 
 
-  FILE* fp=NULL; FILE* fp_forces=NULL; OFile fp_dforces;
-#ifdef __PLUMED_HAS_XDRFILE
-  XDRFILE* xd=NULL;
-#endif
+  FILE* fp_forces=NULL; OFile fp_dforces;
+  std::unique_ptr<TrajectoryReader<real>> reader;
+// declared after the reader, so that it is destroyed first
+  std::unique_ptr<TrajectoryPrefetcher<real>> prefetcher;
   if(!noatoms&&!parseOnly) {
+    if(parallelFrames && trajectoryFile=="-") error("--parallel-frames cannot read the trajectory from standard input");
+    void* molfile_api=NULL;
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+    molfile_api=api;
+#endif
+    reader.reset(new TrajectoryReader<real>(trajectory_fmt,pbc_cli_given,pbc_cli_box,stride==0,command_line_natoms,molfile_api));
     if (trajectoryFile=="-")
-      fp=in;
+      reader->open(in);
     else {
       if(multi) {
         string n;
@@ -550,38 +1253,16 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
         FILE* tmp_fp=fopen(testfile.c_str(),"r");
         if(tmp_fp) { fclose(tmp_fp); trajectoryFile=testfile.c_str();}
       }
-      if(use_molfile==true) {
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        h_in = api->open_file_read(trajectoryFile.c_str(), trajectory_fmt.c_str(), &natoms);
-        if(natoms==MOLFILE_NUMATOMS_UNKNOWN) {
-          if(command_line_natoms>=0) natoms=command_line_natoms;
-          else error("this file format does not provide number of atoms; use --natoms on the command line");
-        }
-        ts_in_coords.reset(new float [3*natoms]);
-        ts_in.coords = ts_in_coords.get();
-#endif
-      } else if(trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr") {
-#ifdef __PLUMED_HAS_XDRFILE
-        xd=xdrfile_open(trajectoryFile.c_str(),"r");
-        if(!xd) {
-          string msg="ERROR: Error opening trajectory file "+trajectoryFile;
-          fprintf(stderr,"%s\n",msg.c_str());
-          return 1;
-        }
-        if(trajectory_fmt=="xdr-xtc") read_xtc_natoms(&trajectoryFile[0],&natoms);
-        if(trajectory_fmt=="xdr-trr") read_trr_natoms(&trajectoryFile[0],&natoms);
-#endif
-      } else {
-        fp=fopen(trajectoryFile.c_str(),"r");
-        if(!fp) {
-          string msg="ERROR: Error opening trajectory file "+trajectoryFile;
-          fprintf(stderr,"%s\n",msg.c_str());
-          return 1;
-        }
+      if(!reader->open(trajectoryFile)) {
+        string msg="ERROR: Error opening trajectory file "+trajectoryFile;
+        fprintf(stderr,"%s\n",msg.c_str());
+        return 1;
       }
     }
     if(dumpforces.length()>0) {
-      if(Communicator::initialized() && pc.Get_size()>1) {
+      if(parallelFrames) {
+        dumpforces=FileBase::appendSuffix(dumpforces,chunkSuffix);
+      } else if(Communicator::initialized() && pc.Get_size()>1) {
         string n;
         Tools::convert(pc.Get_rank(),n);
         dumpforces+="."+n;
@@ -621,39 +1302,35 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 // random stream to choose decompositions
   Random rnd;
 
-  if(trajectory_fmt=="dlp4") {
-    if(!Tools::getline(fp,line)) error("error reading title");
-    if(!Tools::getline(fp,line)) error("error reading atoms");
-    sscanf(line.c_str(),"%d %d %d",&lvl,&pb,&natoms);
-
+// frames in [firstFrame,lastFrame) are analyzed by this process
+  if(parallelFrames) {
+    unsigned long nframes=0;
+    if(pc.Get_rank()==0) nframes=reader->countFrames();
+    pc.Bcast(nframes,0);
+// all processes must take part in the checks done when plumed is initialized on the first frame
+    if(nframes<(unsigned long)pc.Get_size()) error("--parallel-frames needs at least as many frames as processes");
+    unsigned long firstFrame=(nframes*pc.Get_rank())/pc.Get_size();
+    unsigned long lastFrame=(nframes*(pc.Get_rank()+1))/pc.Get_size();
+    if(pc.Get_rank()==0) fprintf(out,"DRIVER: %lu frames are split among %d processes\n",nframes,pc.Get_size());
+    reader->setRange(firstFrame,lastFrame);
+    step+=firstFrame*stride;
   }
+  if(reader && prefetch>0) prefetcher.reset(new TrajectoryPrefetcher<real>(*reader,prefetch));
+  TrajectoryFrame<real> trajectoryFrame;
+
   bool lstep=true;
   while(true) {
-    if(!noatoms&&!parseOnly) {
-      if(use_molfile==true) {
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        int rc;
-        rc = api->read_next_timestep(h_in, natoms, &ts_in);
-        if(rc==MOLFILE_EOF) {
-          break;
-        }
-#endif
-      } else if(trajectory_fmt=="xyz" || trajectory_fmt=="gro" || trajectory_fmt=="dlp4") {
-        if(!Tools::getline(fp,line)) break;
-      }
-    }
     bool first_step=false;
     if(!noatoms&&!parseOnly) {
-      if(use_molfile==false && (trajectory_fmt=="xyz" || trajectory_fmt=="gro")) {
-        if(trajectory_fmt=="gro") if(!Tools::getline(fp,line)) error("premature end of trajectory file");
-        sscanf(line.c_str(),"%100d",&natoms);
+      if(prefetcher) {
+        if(!prefetcher->next(trajectoryFrame)) break;
+      } else {
+        if(!reader->read(trajectoryFrame)) break;
       }
-      if(use_molfile==false && trajectory_fmt=="dlp4") {
-        char xa[9];
-        int xb,xc,xd;
-        double t;
-        sscanf(line.c_str(),"%8s %ld %d %d %d %lf",xa,&step,&xb,&xc,&xd,&t);
-        timestep = real(t);
+      natoms=trajectoryFrame.natoms;
+      if(trajectoryFrame.hasStep) step=trajectoryFrame.step;
+      if(trajectoryFrame.hasTimestep) {
+        timestep = trajectoryFrame.timestep;
         if (lstep) {
           p.cmd("setTimestep",&timestep);
           lstep = false;
@@ -695,6 +1372,12 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       checknatoms=natoms;
       p.cmd("setNatoms",&natoms);
       p.cmd("init");
+      if(parallelFrames) {
+        for(const auto & a : p.getActionSet()) if(a->dependsOnPreviousSteps())
+            error("action " + a->getLabel() + " (" + a->getName() + ") depends on the previous steps and cannot be used with --parallel-frames");
+        for(const auto & f : p.getOpenFiles()) if(!canMergeOutput(f))
+            error("output file " + f + " is in a binary format that cannot be merged with --parallel-frames");
+      }
       if(parseOnly) break;
     }
     if(checknatoms!=natoms) {
@@ -702,9 +1385,19 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       error("number of atoms in frame " + stepstr + " does not match number of atoms in first frame");
     }
 
-    coordinates.assign(3*natoms,real(0.0));
+    if(!noatoms) {
+// buffers are exchanged with the frame, so that they are reused for the following ones
+      coordinates.swap(trajectoryFrame.coordinates);
+      cell.swap(trajectoryFrame.cell);
+      if(trajectoryFrame.masses.size()>0) {
+        masses=trajectoryFrame.masses;
+        charges=trajectoryFrame.charges;
+      }
+    } else {
+      coordinates.assign(3*natoms,real(0.0));
+      cell.assign(9,real(0.0));
+    }
     forces.assign(3*natoms,real(0.0));
-    cell.assign(9,real(0.0));
     virial.assign(9,real(0.0));
 
     if( first_step || rnd.U01()>0.5) {
@@ -762,163 +1455,6 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
     int plumedStopCondition=0;
     if(!noatoms) {
-      if(use_molfile) {
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        if(pbc_cli_given==false) {
-          if(ts_in.A>0.0) { // this is negative if molfile does not provide box
-            // info on the cell: convert using pbcset.tcl from pbctools in vmd distribution
-            real cosBC=cos(real(ts_in.alpha)*pi/180.);
-            //double sinBC=sin(ts_in.alpha*pi/180.);
-            real cosAC=cos(real(ts_in.beta)*pi/180.);
-            real cosAB=cos(real(ts_in.gamma)*pi/180.);
-            real sinAB=sin(real(ts_in.gamma)*pi/180.);
-            real Ax=real(ts_in.A);
-            real Bx=real(ts_in.B)*cosAB;
-            real By=real(ts_in.B)*sinAB;
-            real Cx=real(ts_in.C)*cosAC;
-            real Cy=(real(ts_in.C)*real(ts_in.B)*cosBC-Cx*Bx)/By;
-            real Cz=sqrt(real(ts_in.C)*real(ts_in.C)-Cx*Cx-Cy*Cy);
-            cell[0]=Ax/10.; cell[1]=0.; cell[2]=0.;
-            cell[3]=Bx/10.; cell[4]=By/10.; cell[5]=0.;
-            cell[6]=Cx/10.; cell[7]=Cy/10.; cell[8]=Cz/10.;
-          } else {
-            cell[0]=0.0; cell[1]=0.0; cell[2]=0.0;
-            cell[3]=0.0; cell[4]=0.0; cell[5]=0.0;
-            cell[6]=0.0; cell[7]=0.0; cell[8]=0.0;
-          }
-        } else {
-          for(unsigned i=0; i<9; i++)cell[i]=pbc_cli_box[i];
-        }
-        // info on coords
-        // the order is xyzxyz...
-        for(int i=0; i<3*natoms; i++) {
-          coordinates[i]=real(ts_in.coords[i])/real(10.); //convert to nm
-          //cerr<<"COOR "<<coordinates[i]<<endl;
-        }
-#endif
-      } else if(trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr") {
-#ifdef __PLUMED_HAS_XDRFILE
-        int localstep;
-        float time;
-        matrix box;
-        std::unique_ptr<rvec[]> pos(new rvec[natoms]);
-        float prec,lambda;
-        int ret=exdrOK;
-        if(trajectory_fmt=="xdr-xtc") ret=read_xtc(xd,natoms,&localstep,&time,box,pos.get(),&prec);
-        if(trajectory_fmt=="xdr-trr") ret=read_trr(xd,natoms,&localstep,&time,&lambda,box,pos.get(),NULL,NULL);
-        if(stride==0) step=localstep;
-        if(ret==exdrENDOFFILE) break;
-        if(ret!=exdrOK) break;
-        for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) cell[3*i+j]=box[i][j];
-        for(int i=0; i<natoms; i++) for(unsigned j=0; j<3; j++)
-            coordinates[3*i+j]=real(pos[i][j]);
-#endif
-      } else {
-        if(trajectory_fmt=="xyz") {
-          if(!Tools::getline(fp,line)) error("premature end of trajectory file");
-
-          std::vector<double> celld(9,0.0);
-          if(pbc_cli_given==false) {
-            std::vector<std::string> words;
-            words=Tools::getWords(line);
-            if(words.size()==3) {
-              sscanf(line.c_str(),"%100lf %100lf %100lf",&celld[0],&celld[4],&celld[8]);
-            } else if(words.size()==9) {
-              sscanf(line.c_str(),"%100lf %100lf %100lf %100lf %100lf %100lf %100lf %100lf %100lf",
-                     &celld[0], &celld[1], &celld[2],
-                     &celld[3], &celld[4], &celld[5],
-                     &celld[6], &celld[7], &celld[8]);
-            } else error("needed box in second line of xyz file");
-          } else {			// from command line
-            celld=pbc_cli_box;
-          }
-          for(unsigned i=0; i<9; i++)cell[i]=real(celld[i]);
-        }
-        if(trajectory_fmt=="dlp4") {
-          std::vector<double> celld(9,0.0);
-          if(pbc_cli_given==false) {
-            if(!Tools::getline(fp,line)) error("error reading vector a of cell");
-            sscanf(line.c_str(),"%lf %lf %lf",&celld[0],&celld[1],&celld[2]);
-            if(!Tools::getline(fp,line)) error("error reading vector b of cell");
-            sscanf(line.c_str(),"%lf %lf %lf",&celld[3],&celld[4],&celld[5]);
-            if(!Tools::getline(fp,line)) error("error reading vector c of cell");
-            sscanf(line.c_str(),"%lf %lf %lf",&celld[6],&celld[7],&celld[8]);
-          } else {
-            celld=pbc_cli_box;
-          }
-          for(auto i=0; i<9; i++)cell[i]=real(celld[i])*0.1;
-        }
-        int ddist=0;
-        // Read coordinates
-        for(int i=0; i<natoms; i++) {
-          bool ok=Tools::getline(fp,line);
-          if(!ok) error("premature end of trajectory file");
-          double cc[3];
-          if(trajectory_fmt=="xyz") {
-            char dummy[1000];
-            int ret=std::sscanf(line.c_str(),"%999s %100lf %100lf %100lf",dummy,&cc[0],&cc[1],&cc[2]);
-            if(ret!=4) error("cannot read line"+line);
-          } else if(trajectory_fmt=="gro") {
-            // do the gromacs way
-            if(!i) {
-              //
-              // calculate the distance between dots (as in gromacs gmxlib/confio.c, routine get_w_conf )
-              //
-              const char      *p1, *p2, *p3;
-              p1 = strchr(line.c_str(), '.');
-              if (p1 == NULL) error("seems there are no coordinates in the gro file");
-              p2 = strchr(&p1[1], '.');
-              if (p2 == NULL) error("seems there is only one coordinates in the gro file");
-              ddist = p2 - p1;
-              p3 = strchr(&p2[1], '.');
-              if (p3 == NULL)error("seems there are only two coordinates in the gro file");
-              if (p3 - p2 != ddist)error("not uniform spacing in fields in the gro file");
-            }
-            Tools::convert(line.substr(20,ddist),cc[0]);
-            Tools::convert(line.substr(20+ddist,ddist),cc[1]);
-            Tools::convert(line.substr(20+ddist+ddist,ddist),cc[2]);
-          } else if(trajectory_fmt=="dlp4") {
-            char dummy[9];
-            int idummy;
-            double m,c;
-            sscanf(line.c_str(),"%8s %d %lf %lf",dummy,&idummy,&m,&c);
-            masses[i]=real(m);
-            charges[i]=real(c);
-            if(!Tools::getline(fp,line)) error("error reading coordinates");
-            sscanf(line.c_str(),"%lf %lf %lf",&cc[0],&cc[1],&cc[2]);
-            cc[0]*=0.1;
-            cc[1]*=0.1;
-            cc[2]*=0.1;
-            if(lvl>0) {
-              if(!Tools::getline(fp,line)) error("error skipping velocities");
-            }
-            if(lvl>1) {
-              if(!Tools::getline(fp,line)) error("error skipping forces");
-            }
-          } else plumed_error();
-          if(!debug_pd || ( i>=pd_start && i<pd_start+pd_nlocal) ) {
-            coordinates[3*i]=real(cc[0]);
-            coordinates[3*i+1]=real(cc[1]);
-            coordinates[3*i+2]=real(cc[2]);
-          }
-        }
-        if(trajectory_fmt=="gro") {
-          if(!Tools::getline(fp,line)) error("premature end of trajectory file");
-          std::vector<string> words=Tools::getWords(line);
-          if(words.size()<3) error("cannot understand box format");
-          Tools::convert(words[0],cell[0]);
-          Tools::convert(words[1],cell[4]);
-          Tools::convert(words[2],cell[8]);
-          if(words.size()>3) Tools::convert(words[3],cell[1]);
-          if(words.size()>4) Tools::convert(words[4],cell[2]);
-          if(words.size()>5) Tools::convert(words[5],cell[3]);
-          if(words.size()>6) Tools::convert(words[6],cell[5]);
-          if(words.size()>7) Tools::convert(words[7],cell[6]);
-          if(words.size()>8) Tools::convert(words[8],cell[7]);
-        }
-
-      }
-
       p.cmd("setStepLong",&step);
       p.cmd("setStopFlag",&plumedStopCondition);
 
@@ -1037,15 +1573,51 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
   if(fp_forces) fclose(fp_forces);
   if(debugforces.length()>0) fp_dforces.close();
-  if(fp && fp!=in)fclose(fp);
-#ifdef __PLUMED_HAS_XDRFILE
-  if(xd) xdrfile_close(xd);
-#endif
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-  if(h_in) api->close_file_read(h_in);
-#endif
+  prefetcher.reset();
+  reader.reset();
   if(grex_log) fclose(grex_log);
 
+  if(parallelFrames) {
+    std::vector<std::string> outputFiles(p.getOpenFiles());
+    if(dumpforces.length()>0) outputFiles.push_back(dumpforces);
+// close all the files before merging them
+    plumedMain.reset();
+    if(chunkLog) fclose(chunkLog);
+    pc.Barrier();
+    if(pc.Get_rank()==0) {
+      for(const auto & f : outputFiles) {
+        if(f=="/dev/null") continue;
+        FILE* fout=std::fopen(f.c_str(),"a");
+        if(!fout) error("cannot open file " + f + " to merge the output of --parallel-frames");
+// lines starting with #! at the beginning of each chunk repeat the header and are skipped
+// (except for compressed files and trajectories in binary format, that are just concatenated)
+        const bool binary=isConcatenableBinary(f);
+        for(int r=1; r<pc.Get_size(); r++) {
+          std::string n; Tools::convert(r,n);
+          const std::string chunk=FileBase::appendSuffix(f,".chunk"+n);
+          FILE* fin=std::fopen(chunk.c_str(),"r");
+          if(!fin) continue;
+          if(binary) {
+            char buffer[4096];
+            size_t nread;
+            while((nread=std::fread(buffer,1,sizeof(buffer),fin))>0) std::fwrite(buffer,1,nread,fout);
+          } else {
+            bool header=true;
+            while(Tools::getline(fin,line)) {
+              if(header && line.compare(0,2,"#!")==0) continue;
+              header=false;
+              std::fprintf(fout,"%s\n",line.c_str());
+            }
+          }
+          std::fclose(fin);
+          std::remove(chunk.c_str());
+        }
+        std::fclose(fout);
+      }
+    }
+    pc.Barrier();
+  }
+
   return 0;
 }
 
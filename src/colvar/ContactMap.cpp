@@ -253,6 +253,8 @@ ContactMap::ContactMap(const ActionOptions&ao):
   } else {
     serial=true;
     docomp=true;
+// each component only depends on the atoms of its contact
+    useSparseDerivatives();
   }
 
   // Set up if it is just a list of contacts
@@ -104,6 +104,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   double pairing(double distance,double&dfunc,unsigned i,unsigned j)const override;
+  void pairings(const double* distance2,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const override;
 };
 
 PLUMED_REGISTER_ACTION(Coordination,"COORDINATION")
@@ -153,6 +154,12 @@ double Coordination::pairing(double distance,double&dfunc,unsigned i,unsigned j)
   return switchingFunction.calculateSqr(distance,dfunc);
 }
 
+void Coordination::pairings(const double* distance2,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const {
+  (void) i; // avoid warnings
+  (void) j; // avoid warnings
+  switchingFunction.calculateSqr(distance2,result,dfunc,n);
+}
+
 }
 
 }
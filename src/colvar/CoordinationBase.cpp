@@ -25,6 +25,8 @@
 #include "tools/OpenMP.h"
 
 #include <string>
+#include <set>
+#include <algorithm>
 
 using namespace std;
 
@@ -34,10 +36,12 @@ namespace colvar {
 void CoordinationBase::registerKeywords( Keywords& keys ) {
   Colvar::registerKeywords(keys);
   keys.addFlag("SERIAL",false,"Perform the calculation in serial - for debug purpose");
+  keys.addFlag("DISTRIBUTED",false,"When domain decomposition is used, only communicate the positions of the atoms in GROUPB. Each process computes the pairs involving its own atoms in GROUPA and only the partial sums and the forces on GROUPB are communicated. Requires GROUPB and cannot be used with NLIST or SERIAL");
   keys.addFlag("PAIR",false,"Pair only 1st element of the 1st group with 1st element in the second, etc");
   keys.addFlag("NLIST",false,"Use a neighbor list to speed up the calculation");
   keys.add("optional","NL_CUTOFF","The cutoff for the neighbor list");
   keys.add("optional","NL_STRIDE","The frequency with which we are updating the atoms in the neighbor list");
+  keys.add("optional","NL_SKIN","The width of the Verlet skin. When larger than zero, pairs closer than NL_CUTOFF+NL_SKIN are kept in the list and the list is only rebuilt when an atom has moved by more than half the skin");
   keys.add("atoms","GROUPA","First list of atoms");
   keys.add("atoms","GROUPB","Second list of atoms (if empty, N*(N-1)/2 pairs in GROUPA are counted)");
 }
@@ -46,6 +50,8 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
   PLUMED_COLVAR_INIT(ao),
   pbc(true),
   serial(false),
+  distributed(false),
+  nga(0),
   invalidateList(true),
   firsttime(true)
 {
@@ -55,6 +61,7 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
   vector<AtomNumber> ga_lista,gb_lista;
   parseAtomList("GROUPA",ga_lista);
   parseAtomList("GROUPB",gb_lista);
+  nga=ga_lista.size();
 
   bool nopbc=!pbc;
   parseFlag("NOPBC",nopbc);
@@ -67,6 +74,7 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
 // neighbor list stuff
   bool doneigh=false;
   double nl_cut=0.0;
+  double nl_skin=0.0;
   int nl_st=0;
   parseFlag("NLIST",doneigh);
   if(doneigh) {
@@ -74,18 +82,34 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
     if(nl_cut<=0.0) error("NL_CUTOFF should be explicitly specified and positive");
     parse("NL_STRIDE",nl_st);
     if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
+    parse("NL_SKIN",nl_skin);
+    if(nl_skin<0.0) error("NL_SKIN should be positive");
+  }
+
+  parseFlag("DISTRIBUTED",distributed);
+  if(distributed) {
+    if(gb_lista.empty()) error("DISTRIBUTED requires GROUPB");
+    if(doneigh) error("DISTRIBUTED cannot be used with NLIST");
+    if(serial) error("DISTRIBUTED cannot be used with SERIAL");
   }
 
   addValueWithDerivatives(); setNotPeriodic();
   if(gb_lista.size()>0) {
-    if(doneigh)  nl.reset( new NeighborList(ga_lista,gb_lista,dopair,pbc,getPbc(),nl_cut,nl_st) );
+    if(doneigh)  nl.reset( new NeighborList(ga_lista,gb_lista,dopair,pbc,getPbc(),nl_cut,nl_st,nl_skin) );
     else         nl.reset( new NeighborList(ga_lista,gb_lista,dopair,pbc,getPbc()) );
   } else {
-    if(doneigh)  nl.reset( new NeighborList(ga_lista,pbc,getPbc(),nl_cut,nl_st) );
+    if(doneigh)  nl.reset( new NeighborList(ga_lista,pbc,getPbc(),nl_cut,nl_st,nl_skin) );
     else         nl.reset( new NeighborList(ga_lista,pbc,getPbc()) );
   }
 
   requestAtoms(nl->getFullAtomList());
+  if(distributed) {
+// atoms that also belong to GROUPB are needed by all the processes
+    std::set<AtomNumber> gb_set(gb_lista.begin(),gb_lista.end());
+    vector<AtomNumber> local_only;
+    for(const auto & a : ga_lista) if(!gb_set.count(a)) local_only.push_back(a);
+    setLocalOnlyAtoms(local_only);
+  }
 
   log.printf("  between two groups of %u and %u atoms\n",static_cast<unsigned>(ga_lista.size()),static_cast<unsigned>(gb_lista.size()));
   log.printf("  first group:\n");
@@ -102,9 +126,11 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
   if(pbc) log.printf("  using periodic boundary conditions\n");
   else    log.printf("  without periodic boundary conditions\n");
   if(dopair) log.printf("  with PAIR option\n");
+  if(distributed) log.printf("  positions of the atoms in the first group are not communicated with domain decomposition\n");
   if(doneigh) {
     log.printf("  using neighbor lists with\n");
     log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
+    if(nl_skin>0.0) log.printf("  Verlet skin %f\n",nl_skin);
   }
 }
 
@@ -127,6 +153,13 @@ void CoordinationBase::prepare() {
   }
 }
 
+void CoordinationBase::pairings(const double* distance2,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const {
+  for(unsigned k=0; k<n; k++) {
+    dfunc[k]=0.0;
+    result[k]=pairing(distance2[k],dfunc[k],i[k],j[k]);
+  }
+}
+
 // calculator
 void CoordinationBase::calculate()
 {
@@ -140,9 +173,12 @@ void CoordinationBase::calculate()
     nl->update(getPositions());
   }
 
+// with distributed atoms each process computes the pairs involving its own atoms
+  const bool owner=distributed && atomsAreDistributed();
+
   unsigned stride;
   unsigned rank;
-  if(serial) {
+  if(serial || owner) {
     stride=1;
     rank=0;
   } else {
@@ -154,39 +190,65 @@ void CoordinationBase::calculate()
   const unsigned nn=nl->size();
   if(nt*stride*10>nn) nt=1;
 
+// pairs handled by this process are i=rank+p*stride, with p<np
+  const unsigned np=(nn>rank?(nn-rank+stride-1)/stride:0);
+// pairs are processed in blocks, so that distances are computed with a single call to Pbc
+  const unsigned blocksize=256;
+
   #pragma omp parallel num_threads(nt)
   {
     std::vector<Vector> omp_deriv(getPositions().size());
     Tensor omp_virial;
+    std::vector<unsigned> b0(blocksize),b1(blocksize);
+    std::vector<Vector> bdistance(blocksize);
+    std::vector<double> bdistance2(blocksize),bpairing(blocksize),bdfunc(blocksize);
 
     #pragma omp for reduction(+:ncoord) nowait
-    for(unsigned int i=rank; i<nn; i+=stride) {
+    for(unsigned pstart=0; pstart<np; pstart+=blocksize) {
 
-      Vector distance;
-      unsigned i0=nl->getClosePair(i).first;
-      unsigned i1=nl->getClosePair(i).second;
+      unsigned nb=0;
+      const unsigned pend=std::min(pstart+blocksize,np);
+      for(unsigned p=pstart; p<pend; p++) {
+        const unsigned i=rank+p*stride;
+        unsigned i0=nl->getClosePair(i).first;
+        unsigned i1=nl->getClosePair(i).second;
 
-      if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+        if(owner && !isLocalAtom(i0)) continue;
+
+        if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+
+        b0[nb]=i0;
+        b1[nb]=i1;
+        nb++;
+      }
 
       if(pbc) {
-        distance=pbcDistance(getPosition(i0),getPosition(i1));
+        getPbc().distances(getPositions().data(),b0.data(),b1.data(),nb,bdistance.data());
       } else {
-        distance=delta(getPosition(i0),getPosition(i1));
+        for(unsigned k=0; k<nb; k++) bdistance[k]=delta(getPosition(b0[k]),getPosition(b1[k]));
       }
 
-      double dfunc=0.;
-      ncoord += pairing(distance.modulo2(), dfunc,i0,i1);
-
-      Vector dd(dfunc*distance);
-      Tensor vv(dd,distance);
-      if(nt>1) {
-        omp_deriv[i0]-=dd;
-        omp_deriv[i1]+=dd;
-        omp_virial-=vv;
-      } else {
-        deriv[i0]-=dd;
-        deriv[i1]+=dd;
-        virial-=vv;
+      for(unsigned k=0; k<nb; k++) bdistance2[k]=bdistance[k].modulo2();
+      pairings(bdistance2.data(),bpairing.data(),bdfunc.data(),b0.data(),b1.data(),nb);
+
+      for(unsigned k=0; k<nb; k++) {
+        const unsigned i0=b0[k];
+        const unsigned i1=b1[k];
+        const Vector & distance(bdistance[k]);
+
+        ncoord += bpairing[k];
+
+        Vector dd(bdfunc[k]*distance);
+        Tensor vv(dd,distance);
+        if(nt>1) {
+          omp_deriv[i0]-=dd;
+          omp_deriv[i1]+=dd;
+          omp_virial-=vv;
+        } else {
+          deriv[i0]-=dd;
+          deriv[i1]+=dd;
+          virial-=vv;
+        }
       }
 
     }
@@ -197,7 +259,12 @@ void CoordinationBase::calculate()
     }
   }
 
-  if(!serial) {
+  if(owner) {
+// derivatives with respect to the atoms in GROUPA are only needed by their owner
+    comm.Sum(ncoord);
+    comm.Sum(&deriv[nga][0],3*(deriv.size()-nga));
+    comm.Sum(virial);
+  } else if(!serial) {
     comm.Sum(ncoord);
     if(!deriv.empty()) comm.Sum(&deriv[0][0],3*deriv.size());
     comm.Sum(virial);
@@ -33,6 +33,9 @@ namespace colvar {
 class CoordinationBase : public Colvar {
   bool pbc;
   bool serial;
+  bool distributed;
+/// Number of atoms in the first group
+  unsigned nga;
   std::unique_ptr<NeighborList> nl;
   bool invalidateList;
   bool firsttime;
@@ -44,6 +47,9 @@ public:
   void calculate() override;
   void prepare() override;
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const=0;
+/// Compute pairing() for n pairs with squared distances distance2, storing values and derivatives in result and dfunc.
+/// The default implementation calls pairing() on each pair; it can be overridden to process the whole block at once.
+  virtual void pairings(const double* distance2,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const;
   static void registerKeywords( Keywords& keys );
 };
 
@@ -28,6 +28,9 @@
 #include "core/PlumedMain.h"
 #include "core/SetupMolInfo.h"
 #include "tools/OpenMP.h"
+#include "tools/Communicator.h"
+#include "tools/LinkCells.h"
+#include <algorithm>
 #include <initializer_list>
 
 #define INV_PI_SQRT_PI 0.179587122
@@ -86,8 +89,14 @@ private:
   double nl_buffer;
   unsigned nl_stride;
   unsigned nl_update;
-  vector<vector<unsigned> > nl;
-  vector<vector<bool> > nlexpo;
+  // neighbors of atom i are nl[nl_start[i]] ... nl[nl_start[i+1]-1]
+  vector<unsigned> nl_start;
+  vector<unsigned> nl;
+  vector<char> nlexpo;
+  vector<Vector> nl_positions;
+  vector<unsigned> nl_indices;
+  Communicator serialcomm;
+  LinkCells linkcells;
   vector<vector<double> > parameter;
   void setupConstants(const vector<AtomNumber> &atoms, vector<vector<double> > &parameter, bool tcorr);
   map<string, map<string, string> > setupTypeMap();
@@ -118,7 +127,8 @@ EEFSolv::EEFSolv(const ActionOptions&ao):
   delta_g_ref(0.),
   nl_buffer(0.1),
   nl_stride(40),
-  nl_update(0)
+  nl_update(0),
+  linkcells(serialcomm)
 {
   vector<AtomNumber> atoms;
   parseAtomList("ATOMS", atoms);
@@ -138,8 +148,7 @@ EEFSolv::EEFSolv(const ActionOptions&ao):
 
   log << "  Bibliography " << plumed.cite("Lazaridis T, Karplus M, Proteins Struct. Funct. Genet. 35, 133 (1999)"); log << "\n";
 
-  nl.resize(size);
-  nlexpo.resize(size);
+  nl_start.resize(size+1,0);
   parameter.resize(size, vector<double>(4, 0));
   setupConstants(atoms, parameter, tcorr);
 
@@ -151,30 +160,72 @@ EEFSolv::EEFSolv(const ActionOptions&ao):
 void EEFSolv::update_neighb() {
   const double lower_c2 = 0.24 * 0.24; // this is the cut-off for bonded atoms
   const unsigned size = getNumberOfAtoms();
+  if(size==0) return;
 
+  // candidate neighbors are retrieved from link cells built with the largest cutoff
+  double maxlambda = 0.;
+  for (unsigned i=0; i<size; i++) maxlambda = std::max(maxlambda, 1./parameter[i][2]);
+  nl_positions.resize(size);
+  nl_indices.resize(size);
   for (unsigned i=0; i<size; i++) {
-    nl[i].clear();
-    nlexpo[i].clear();
-    const Vector posi = getPosition(i);
-    // Loop through neighboring atoms, add the ones below cutoff
-    for (unsigned j=i+1; j<size; j++) {
-      if(parameter[i][1]==0&&parameter[j][1]==0) continue;
-      const double d2 = delta(posi, getPosition(j)).modulo2();
-      if (d2 < lower_c2 && j < i+14) {
-        // crude approximation for i-i+1/2 interactions,
-        // we want to exclude atoms separated by less than three bonds
-        continue;
-      }
-      // We choose the maximum lambda value and use a more conservative cutoff
-      double mlambda = 1./parameter[i][2];
-      if (1./parameter[j][2] > mlambda) mlambda = 1./parameter[j][2];
-      const double c2 = (2. * mlambda + nl_buffer) * (2. * mlambda + nl_buffer);
-      if (d2 < c2 ) {
-        nl[i].push_back(j);
-        if(parameter[i][2] == parameter[j][2] && parameter[i][3] == parameter[j][3]) {
-          nlexpo[i].push_back(true);
-        } else nlexpo[i].push_back(false);
+    nl_positions[i] = getPosition(i);
+    nl_indices[i] = i;
+  }
+  linkcells.setCutoff(2. * maxlambda + nl_buffer);
+  linkcells.buildCellLists(nl_positions, nl_indices);
+
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>size) nt=1;
+
+  #pragma omp parallel num_threads(nt)
+  {
+    // with a static schedule each thread gets a contiguous range of atoms,
+    // so that its neighbors can be copied at once in the final list
+    vector<unsigned> nl_omp, cells, cellatoms(size+1);
+    vector<char> nlexpo_omp;
+    unsigned first = size;
+    #pragma omp for schedule(static)
+    for (unsigned i=0; i<size; i++) {
+      if(first==size) first = i;
+      const Vector posi = getPosition(i);
+      unsigned natoms = 1;
+      cellatoms[0] = i;
+      linkcells.retrieveNeighboringAtoms(posi, cells, natoms, cellatoms);
+      std::sort(cellatoms.begin()+1, cellatoms.begin()+natoms);
+      unsigned count = 0;
+      // Loop through neighboring atoms, add the ones below cutoff
+      for (unsigned k=1; k<natoms; k++) {
+        const unsigned j = cellatoms[k];
+        if(j<=i) continue;
+        if(parameter[i][1]==0&&parameter[j][1]==0) continue;
+        const double d2 = delta(posi, getPosition(j)).modulo2();
+        if (d2 < lower_c2 && j < i+14) {
+          // crude approximation for i-i+1/2 interactions,
+          // we want to exclude atoms separated by less than three bonds
+          continue;
+        }
+        // We choose the maximum lambda value and use a more conservative cutoff
+        double mlambda = 1./parameter[i][2];
+        if (1./parameter[j][2] > mlambda) mlambda = 1./parameter[j][2];
+        const double c2 = (2. * mlambda + nl_buffer) * (2. * mlambda + nl_buffer);
+        if (d2 < c2 ) {
+          nl_omp.push_back(j);
+          nlexpo_omp.push_back(parameter[i][2] == parameter[j][2] && parameter[i][3] == parameter[j][3]);
+          count++;
+        }
       }
+      nl_start[i+1] = count;
+    }
+    #pragma omp single
+    {
+      nl_start[0] = 0;
+      for (unsigned i=0; i<size; i++) nl_start[i+1] += nl_start[i];
+      nl.resize(nl_start[size]);
+      nlexpo.resize(nl_start[size]);
+    }
+    if(first<size) {
+      std::copy(nl_omp.begin(), nl_omp.end(), nl.begin()+nl_start[first]);
+      std::copy(nlexpo_omp.begin(), nlexpo_omp.end(), nlexpo.begin()+nl_start[first]);
     }
   }
 }
@@ -215,8 +266,8 @@ void EEFSolv::calculate() {
       const double vdw_radius_i   = parameter[i][3];
 
       // The pairwise interactions are unsymmetric, but we can get away with calculating the distance only once
-      for (unsigned i_nl=0; i_nl<nl[i].size(); i_nl++) {
-        const unsigned j = nl[i][i_nl];
+      for (unsigned i_nl=nl_start[i]; i_nl<nl_start[i+1]; i_nl++) {
+        const unsigned j = nl[i_nl];
         const double vdw_volume_j   = parameter[j][0];
         const double delta_g_free_j = parameter[j][1];
         const double inv_lambda_j   = parameter[j][2];
@@ -230,7 +281,7 @@ void EEFSolv::calculate() {
         const double fact_ji  = inv_rij2 * delta_g_free_j * vdw_volume_i * INV_PI_SQRT_PI * inv_lambda_j;
 
         // in this case we can calculate a single exponential
-        if(!nlexpo[i][i_nl]) {
+        if(!nlexpo[i_nl]) {
           // i-j interaction
           if(inv_rij > 0.5*inv_lambda_i && delta_g_free_i!=0.)
           {
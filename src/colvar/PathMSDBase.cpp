@@ -27,7 +27,11 @@
 #include "tools/PDB.h"
 #include "tools/RMSD.h"
 #include "tools/Tools.h"
+#include "tools/OpenMP.h"
+#include "tools/Communicator.h"
+#include "blas/blas.h"
 #include <cmath>
+#include <algorithm>
 
 using namespace std;
 
@@ -54,6 +58,7 @@ PathMSDBase::PathMSDBase(const ActionOptions&ao):
   debugClose(0),
   logClose(0),
   computeRefClose(false),
+  batched(false),
   nframes(0)
 {
   parse("LAMBDA",lambda);
@@ -94,8 +99,6 @@ PathMSDBase::PathMSDBase(const ActionOptions&ao):
         if(aaa!=mypdb.getAtomNumbers()) error("frames should contain same atoms in same order");
         log<<"Found PDB: "<<nframes<<" containing  "<<mypdb.getAtomNumbers().size()<<" atoms\n";
         pdbv.push_back(mypdb);
-        derivs_s.resize(mypdb.getAtomNumbers().size());
-        derivs_z.resize(mypdb.getAtomNumbers().size());
         mymsd.set(mypdb,"OPTIMAL");
         msdv.push_back(mymsd); // the vector that stores the frames
       } else {break ;}
@@ -132,6 +135,29 @@ PathMSDBase::PathMSDBase(const ActionOptions&ao):
   rotationRefClose.resize(nframes);
   savedIndices = vector<unsigned>(nframes);
 
+  // the batched kernel needs the same weights for all the frames, with align==displace
+  batched=(nframes>0);
+  for(unsigned i=0; i<nframes && batched; i++) {
+    std::vector<double> align(msdv[i].getAlign());
+    if(align!=msdv[i].getDisplace() || (i>0 && align!=alignWeights)) batched=false;
+    if(i==0) alignWeights=align;
+  }
+  if(batched) {
+    // references are already centered by RMSD
+    const unsigned nat=alignWeights.size();
+    refMatrix.resize(3*nframes*nat);
+    refNorm2.assign(nframes,0.0);
+    for(unsigned i=0; i<nframes; i++) {
+      std::vector<Vector> ref(msdv[i].getReference());
+      for(unsigned iat=0; iat<nat; iat++) {
+        for(unsigned k=0; k<3; k++) refMatrix[(3*i+k)*nat+iat]=ref[iat][k];
+        refNorm2[i]+=dotProduct(ref[iat],ref[iat])*alignWeights[iat];
+      }
+    }
+  } else {
+    alignWeights.clear();
+  }
+
   if(nopbc) log.printf("  without periodic boundary conditions\n");
   else      log.printf("  using periodic boundary conditions\n");
 
@@ -140,6 +166,72 @@ PathMSDBase::PathMSDBase(const ActionOptions&ao):
 PathMSDBase::~PathMSDBase() {
 }
 
+void PathMSDBase::batchedRotations(unsigned first,unsigned last,const std::vector<Vector>& weighted,double rr00) {
+  const unsigned nat=alignWeights.size();
+  // correlation matrices of contiguous runs of frames are computed with a single product:
+  // rr01 (3 x 3*nrun, column major) = weighted^T (3 x nat) * references (nat x 3*nrun)
+  std::vector<double> rr01(9*(last-first));
+  for(unsigned p=first; p<last;) {
+    unsigned q=p+1;
+    while(q<last && imgVec[q].index==imgVec[q-1].index+1) q++;
+    int m=3, n=3*(q-p), k=nat, lda=3, ldb=nat, ldc=3;
+    double one=1.0, zero=0.0;
+    plumed_blas_dgemm("N","N",&m,&n,&k,&one,const_cast<double*>(&weighted[0][0]),&lda,
+                      &refMatrix[3*imgVec[p].index*nat],&ldb,&zero,&rr01[9*(p-first)],&ldc);
+    p=q;
+  }
+  for(unsigned p=first; p<last; p++) {
+    Tensor r;
+    for(unsigned a=0; a<3; a++) for(unsigned k=0; k<3; k++) r[a][k]=rr01[9*(p-first)+3*k+a];
+    // same quaternion matrix as in RMSD
+    Tensor4d m;
+    m[0][0]=2.0*(-r[0][0]-r[1][1]-r[2][2]);
+    m[1][1]=2.0*(-r[0][0]+r[1][1]+r[2][2]);
+    m[2][2]=2.0*(+r[0][0]-r[1][1]+r[2][2]);
+    m[3][3]=2.0*(+r[0][0]+r[1][1]-r[2][2]);
+    m[0][1]=2.0*(-r[1][2]+r[2][1]);
+    m[0][2]=2.0*(+r[0][2]-r[2][0]);
+    m[0][3]=2.0*(-r[0][1]+r[1][0]);
+    m[1][2]=2.0*(-r[0][1]-r[1][0]);
+    m[1][3]=2.0*(-r[0][2]-r[2][0]);
+    m[2][3]=2.0*(-r[1][2]-r[2][1]);
+    m[1][0] = m[0][1];
+    m[2][0] = m[0][2];
+    m[2][1] = m[1][2];
+    m[3][0] = m[0][3];
+    m[3][1] = m[1][3];
+    m[3][2] = m[2][3];
+    const double rr11=refNorm2[imgVec[p].index];
+    Vector4d q;
+    const double eigenval=RMSD::lowestQuaternion(m,-(rr00+rr11),q);
+    Tensor & rotation(rotations[p]);
+    rotation[0][0]=q[0]*q[0]+q[1]*q[1]-q[2]*q[2]-q[3]*q[3];
+    rotation[1][1]=q[0]*q[0]-q[1]*q[1]+q[2]*q[2]-q[3]*q[3];
+    rotation[2][2]=q[0]*q[0]-q[1]*q[1]-q[2]*q[2]+q[3]*q[3];
+    rotation[0][1]=2*(+q[0]*q[3]+q[1]*q[2]);
+    rotation[0][2]=2*(-q[0]*q[2]+q[1]*q[3]);
+    rotation[1][2]=2*(+q[0]*q[1]+q[2]*q[3]);
+    rotation[1][0]=2*(-q[0]*q[3]+q[1]*q[2]);
+    rotation[2][0]=2*(+q[0]*q[2]+q[1]*q[3]);
+    rotation[2][1]=2*(-q[0]*q[1]+q[2]*q[3]);
+    imgVec[p].distance=eigenval+rr00+rr11;
+  }
+}
+
+double PathMSDBase::alignedDistance(unsigned i,const std::vector<Vector>& centered,std::vector<Vector>& derivatives)const {
+  const unsigned nat=alignWeights.size();
+  const Tensor & rotation(rotations[i]);
+  const double* ref=&refMatrix[3*imgVec[i].index*nat];
+  derivatives.resize(nat);
+  double dist=0.0;
+  for(unsigned iat=0; iat<nat; iat++) {
+    Vector d(centered[iat]-matmul(rotation,Vector(ref[iat],ref[nat+iat],ref[2*nat+iat])));
+    derivatives[iat]=2.0*alignWeights[iat]*d;
+    dist+=alignWeights[iat]*modulo2(d);
+  }
+  return dist;
+}
+
 void PathMSDBase::calculate() {
 
   if(neigh_size>0 && getExchangeStep()) error("Neighbor lists for this collective variable are not compatible with replica exchange, sorry for that!");
@@ -197,29 +289,56 @@ void PathMSDBase::calculate() {
     }
   }
 
-  std::vector<double> tmp_distances(imgVec.size(),0.0);
-  std::vector<Vector> tmp_derivs;
-// this array is a merge of all tmp_derivs, so as to allow a single comm.Sum below
-  std::vector<Vector> tmp_derivs2(imgVec.size()*nat);
+// each process computes a contiguous block of imgVec, each thread a contiguous part of it.
+// derivatives are only kept for the frames of this process
+  const unsigned nimg=imgVec.size();
+  const unsigned first=(nimg*rank)/stride;
+  const unsigned last=(nimg*(rank+1))/stride;
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt>last-first) nt=std::max(last-first,1u);
+  if(debugClose) nt=1;
+  for(auto & it : imgVec) it.distder.clear();
+
+  std::vector<double> tmp_distances(nimg,0.0);
+  const bool useBatched=(batched && epsilonClose<=0);
+  std::vector<Vector> centered;
 
 // if imgVec.size() is less than nframes, it means that only some msd will be calculated
-  if (epsilonClose > 0) {
+  if(useBatched) {
+    Vector cpositions;
+    for(unsigned iat=0; iat<nat; iat++) cpositions+=getPosition(iat)*alignWeights[iat];
+    centered.resize(nat);
+    std::vector<Vector> weighted(nat);
+    double rr00=0.0;
+    for(unsigned iat=0; iat<nat; iat++) {
+      centered[iat]=getPosition(iat)-cpositions;
+      weighted[iat]=alignWeights[iat]*centered[iat];
+      rr00+=dotProduct(centered[iat],centered[iat])*alignWeights[iat];
+    }
+    rotations.resize(nimg);
+    #pragma omp parallel num_threads(nt)
+    {
+      const unsigned t=OpenMP::getThreadNum();
+      const unsigned b=first+((last-first)*t)/nt;
+      const unsigned e=first+((last-first)*(t+1))/nt;
+      if(e>b) batchedRotations(b,e,weighted,rr00);
+    }
+    for(unsigned i=first; i<last; i++) tmp_distances[i]=imgVec[i].distance;
+  } else if (epsilonClose > 0) {
     if (computeRefClose) {
       //recompute rotation matrices accurately
-      for(unsigned i=rank; i<imgVec.size(); i+=stride) {
-        tmp_distances[i] = msdv[imgVec[i].index].calc_Rot(getPositions(), tmp_derivs, tmp_rotationRefClose[imgVec[i].index], true);
-        plumed_assert(tmp_derivs.size()==nat);
-        #pragma omp simd
-        for(unsigned j=0; j<nat; j++) tmp_derivs2[i*nat+j]=tmp_derivs[j];
+      #pragma omp parallel for num_threads(nt)
+      for(unsigned i=first; i<last; i++) {
+        tmp_distances[i] = msdv[imgVec[i].index].calc_Rot(getPositions(), imgVec[i].distder, tmp_rotationRefClose[imgVec[i].index], true);
+        plumed_assert(imgVec[i].distder.size()==nat);
       }
     }
     else {
       //approximate distance with saved rotation matrices
-      for(unsigned i=rank; i<imgVec.size(); i+=stride) {
-        tmp_distances[i] = msdv[imgVec[i].index].calculateWithCloseStructure(getPositions(), tmp_derivs, rotationPosClose, rotationRefClose[imgVec[i].index], drotationPosCloseDrr01, true);
-        plumed_assert(tmp_derivs.size()==nat);
-        #pragma omp simd
-        for(unsigned j=0; j<nat; j++) tmp_derivs2[i*nat+j]=tmp_derivs[j];
+      #pragma omp parallel for num_threads(nt)
+      for(unsigned i=first; i<last; i++) {
+        tmp_distances[i] = msdv[imgVec[i].index].calculateWithCloseStructure(getPositions(), imgVec[i].distder, rotationPosClose, rotationRefClose[imgVec[i].index], drotationPosCloseDrr01, true);
+        plumed_assert(imgVec[i].distder.size()==nat);
         if (debugClose) {
           double withclose = tmp_distances[i];
           RMSD opt;
@@ -236,27 +355,41 @@ void PathMSDBase::calculate() {
   }
   else {
     // store temporary local results
-    for(unsigned i=rank; i<imgVec.size(); i+=stride) {
-      tmp_distances[i]=msdv[imgVec[i].index].calculate(getPositions(),tmp_derivs,true);
-      plumed_assert(tmp_derivs.size()==nat);
-      #pragma omp simd
-      for(unsigned j=0; j<nat; j++) tmp_derivs2[i*nat+j]=tmp_derivs[j];
+    #pragma omp parallel for num_threads(nt)
+    for(unsigned i=first; i<last; i++) {
+      tmp_distances[i]=msdv[imgVec[i].index].calculate(getPositions(),imgVec[i].distder,true);
+      plumed_assert(imgVec[i].distder.size()==nat);
     }
   }
 
 // reduce over all processors
   comm.Sum(tmp_distances);
-  comm.Sum(tmp_derivs2);
   if (epsilonClose > 0 && computeRefClose) {
     comm.Sum(tmp_rotationRefClose);
     for (unsigned i=0; i<nframes; i++) {
       rotationRefClose[i] = tmp_rotationRefClose[i];
     }
   }
-// assign imgVec[i].distance and imgVec[i].distder
-  for(unsigned i=0; i<imgVec.size(); i++) {
-    imgVec[i].distance=tmp_distances[i];
-    imgVec[i].distder.assign(&tmp_derivs2[i*nat],nat+&tmp_derivs2[i*nat]);
+  for(unsigned i=0; i<nimg; i++) imgVec[i].distance=tmp_distances[i];
+
+// frames whose weight exp(-lambda*distance) is negligible with respect to the closest one do not contribute to the derivatives
+  const double cutoff=-std::log(epsilon);
+  double mindist=imgVec[0].distance;
+  for(const auto & it : imgVec) mindist=std::min(mindist,it.distance);
+
+  if(useBatched) {
+// with the batched kernel, distances of the frames that contribute to the path variables are now recomputed
+// from the aligned structures, more accurately, together with their derivatives
+    std::fill(tmp_distances.begin(),tmp_distances.end(),0.0);
+    #pragma omp parallel for num_threads(nt)
+    for(unsigned i=first; i<last; i++) {
+      if(lambda*(imgVec[i].distance-mindist)>cutoff) tmp_distances[i]=imgVec[i].distance;
+      else tmp_distances[i]=alignedDistance(i,centered,imgVec[i].distder);
+    }
+    comm.Sum(tmp_distances);
+    for(unsigned i=0; i<nimg; i++) imgVec[i].distance=tmp_distances[i];
+    mindist=imgVec[0].distance;
+    for(const auto & it : imgVec) mindist=std::min(mindist,it.distance);
   }
 
 // END OF THE HEAVY PART
@@ -271,10 +404,6 @@ void PathMSDBase::calculate() {
 
   vector<double> s_path(val_s_path.size()); for(unsigned i=0; i<s_path.size(); i++)s_path[i]=0.;
   double partition=0.;
-  double tmp;
-
-  // clean vector
-  for(unsigned i=0; i< derivs_z.size(); i++) {derivs_z[i].zero();}
 
   for(auto & it : imgVec) {
     it.similarity=exp(-lambda*(it.distance));
@@ -286,26 +415,34 @@ void PathMSDBase::calculate() {
   }
   for(unsigned i=0; i<s_path.size(); i++) { s_path[i]/=partition;  val_s_path[i]->set(s_path[i]) ;}
   val_z_path->set(-(1./lambda)*std::log(partition));
-  for(unsigned j=0; j<s_path.size(); j++) {
-    // clean up
-    #pragma omp simd
-    for(unsigned i=0; i< derivs_s.size(); i++) {derivs_s[i].zero();}
-    // do the derivative
-    for(const auto & it : imgVec) {
-      double expval=it.similarity;
-      tmp=lambda*expval*(s_path[j]-it.property[j])/partition;
-      #pragma omp simd
-      for(unsigned i=0; i< derivs_s.size(); i++) { derivs_s[i]+=tmp*it.distder[i] ;}
-      if(j==0) {
-        #pragma omp simd
-        for(unsigned i=0; i< derivs_z.size(); i++) { derivs_z[i]+=it.distder[i]*expval/partition;}
-      }
-    }
-    for(unsigned i=0; i< derivs_s.size(); i++) {
-      setAtomsDerivatives (val_s_path[j],i,derivs_s[i]);
-      if(j==0) {setAtomsDerivatives (val_z_path,i,derivs_z[i]);}
+
+// derivatives are accumulated over the frames of this process, and then summed.
+// derivs[j*nat+i] is the derivative of s_path[j] (or of z for j==ns) wrt atom i
+  const unsigned ns=s_path.size();
+  std::vector<unsigned> contributing;
+  for(unsigned i=first; i<last; i++) {
+    if(!imgVec[i].distder.empty() && lambda*(imgVec[i].distance-mindist)<=cutoff) contributing.push_back(i);
+  }
+  std::vector<double> coeff((ns+1)*contributing.size());
+  for(unsigned c=0; c<contributing.size(); c++) {
+    const ImagePath & it(imgVec[contributing[c]]);
+    double expval=it.similarity;
+    for(unsigned j=0; j<ns; j++) coeff[c*(ns+1)+j]=lambda*expval*(s_path[j]-it.property[j])/partition;
+    coeff[c*(ns+1)+ns]=expval/partition;
+  }
+  std::vector<Vector> derivs((ns+1)*nat);
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(derivs))
+  for(unsigned i=0; i<nat; i++) {
+    for(unsigned c=0; c<contributing.size(); c++) {
+      const Vector & distder(imgVec[contributing[c]].distder[i]);
+      for(unsigned j=0; j<=ns; j++) derivs[j*nat+i]+=coeff[c*(ns+1)+j]*distder;
     }
   }
+  if(stride>1) comm.Sum(derivs);
+  for(unsigned j=0; j<ns; j++) {
+    for(unsigned i=0; i<nat; i++) setAtomsDerivatives(val_s_path[j],i,derivs[j*nat+i]);
+  }
+  for(unsigned i=0; i<nat; i++) setAtomsDerivatives(val_z_path,i,derivs[ns*nat+i]);
   for(unsigned i=0; i<val_s_path.size(); ++i) setBoxDerivativesNoPbc(val_s_path[i]);
   setBoxDerivativesNoPbc(val_z_path);
   //
@@ -43,7 +43,7 @@ class PathMSDBase : public Colvar {
     double distance;
     // similarity (exp - lambda distance) or other
     double similarity;
-    // derivatives of the distance
+    // derivatives of the distance (only for the frames computed by this process that contribute to the path variables)
     std::vector<Vector> distder;
     // here one can add a pointer to a value (hypothetically providing a distance from a point)
   };
@@ -65,8 +65,6 @@ class PathMSDBase : public Colvar {
   int neigh_stride;
   std::vector<RMSD> msdv;
   std::string reference;
-  std::vector<Vector> derivs_s;
-  std::vector<Vector> derivs_z;
   std::vector <ImagePath> imgVec; // this can be used for doing neighlist
 
   //variables used for the close structure method, i is the number of reference structures
@@ -80,6 +78,20 @@ class PathMSDBase : public Colvar {
   Tensor rotationPosClose; //rotation matrix between the close and the current structure
   std::array<std::array<Tensor,3>,3> drotationPosCloseDrr01; //Tensor[3][3]; //derivation of the rotation matrix w.r.t rr01, necessary for calculation of derivations
   std::vector<unsigned> savedIndices; //saved indices of imgVec from previous steps, used for recalculating after neighbourlist update
+
+  // when all the frames share the same weights, and alignment and displacement weights are equal,
+  // the correlation matrices of all the frames are computed with a single product of matrices
+  bool batched;
+  std::vector<double> alignWeights; // the common weights
+  std::vector<double> refMatrix; // centered references, refMatrix[(3*frame+k)*nat+iat] is component k of atom iat
+  std::vector<double> refNorm2; // weighted squared norm of each reference
+  std::vector<Tensor> rotations; // rotation fitting each frame of imgVec to the current positions
+  // compute the optimal rotations and the distances of frames imgVec[first..last) from the eigenvalue of the quaternion matrix.
+  // weighted is the current structure, centered and multiplied by the weights
+  // rr00 is the weighted squared norm of the centered structure
+  void batchedRotations(unsigned first,unsigned last,const std::vector<Vector>& weighted,double rr00);
+  // recompute the distance of frame imgVec[i] from the aligned structures, as RMSD does, together with its derivatives
+  double alignedDistance(unsigned i,const std::vector<Vector>& centered,std::vector<Vector>& derivatives)const;
 protected:
   std::vector<PDB> pdbv;
   std::vector<std::string> labels;
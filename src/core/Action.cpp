@@ -233,6 +233,10 @@ void Action::calculateNumericalDerivatives( ActionWithValue* a ) {
   plumed_merror("if you get here it means that you are trying to use numerical derivatives for a class that does not implement them");
 }
 
+bool Action::modifiesGlobalData()const {
+  return !dynamic_cast<const ActionWithValue*>(this);
+}
+
 void Action::prepare() {
   return;
 }
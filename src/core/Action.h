@@ -262,6 +262,18 @@ public:
 /// Check if the action needs gradient
   virtual bool checkNeedsGradients()const {return false;}
 
+/// Check if the action modifies data shared with other actions without
+/// declaring a dependency (e.g. the global positions or forces).
+/// These actions are never calculated concurrently with other actions.
+/// By default, only actions with values are assumed not to do so.
+  virtual bool modifiesGlobalData()const;
+
+/// Check if the result of the action depends on the steps that were calculated before
+/// (e.g. because it accumulates a bias or an average, or because it reads a file one step at a time).
+/// These actions cannot be used when a trajectory is split in chunks analyzed
+/// independently (see driver --parallel-frames).
+  virtual bool dependsOnPreviousSteps()const {return false;}
+
 /// Perform calculation using numerical derivatives
 /// N.B. only pass an ActionWithValue to this routine if you know exactly what you
 /// are doing.
@@ -69,6 +69,7 @@ void ActionAtomistic::requestAtoms(const vector<AtomNumber> & a, const bool clea
   int n=atoms.positions.size();
   if(clearDep) clearDependencies();
   unique.clear();
+  local_only.clear();
   for(unsigned i=0; i<indexes.size(); i++) {
     if(indexes[i].index()>=n) { std::string num; Tools::convert( indexes[i].serial(),num ); error("atom " + num + " out of range"); }
     if(atoms.isVirtualAtom(indexes[i])) addDependency(atoms.getVirtualAtomsAction(indexes[i]));
@@ -76,7 +77,28 @@ void ActionAtomistic::requestAtoms(const vector<AtomNumber> & a, const bool clea
     else unique.insert(indexes[i]);
   }
   updateUniqueLocal();
-  atoms.unique.clear();
+  atoms.uniqueNeedsUpdate=true;
+}
+
+void ActionAtomistic::setLocalOnlyAtoms(const vector<AtomNumber> & a) {
+  plumed_massert(!lockRequestAtoms,"local atoms can only be changed in the prepare() method");
+  local_only.clear();
+  for(const auto & p : a) {
+    plumed_massert(unique.count(p),"local atoms should be requested with requestAtoms()");
+    local_only.insert(p);
+  }
+  updateUniqueLocal();
+  atoms.uniqueNeedsUpdate=true;
+}
+
+bool ActionAtomistic::atomsAreDistributed()const {
+  return atoms.dd && atoms.shuffledAtoms>0;
+}
+
+bool ActionAtomistic::isLocalAtom(int i)const {
+  if(!atomsAreDistributed()) return true;
+  if(atoms.isVirtualAtom(indexes[i])) return atoms.dd.Get_rank()==0;
+  return atoms.g2l[indexes[i].index()]>=0;
 }
 
 Vector ActionAtomistic::pbcDistance(const Vector &v1,const Vector &v2)const {
@@ -254,6 +276,25 @@ void ActionAtomistic::setForcesOnAtoms( const std::vector<double>& forcesToApply
   plumed_dbg_assert( ind+1==forcesToApply.size());
 }
 
+bool ActionAtomistic::addForcesOnAtoms( const Value* v, unsigned ind ) {
+  if(donotforce) return false;
+  const double f=v->getForce();
+  if(f==0.0) return false;
+  const unsigned nat=indexes.size();
+  auto add=[&](unsigned k) {
+    const double fk=f*v->getDerivative(k);
+    k-=ind;
+    if(k<3*nat) forces[k/3][k%3]+=fk;
+    else if(k<3*nat+9) virial((k-3*nat)/3,(k-3*nat)%3)+=fk;
+  };
+  if(v->hasSparseDerivatives()) {
+    for(const auto & k : v->getActiveDerivatives()) if(k>=ind) add(k);
+  } else {
+    for(unsigned k=ind; k<ind+3*nat+9; ++k) add(k);
+  }
+  return true;
+}
+
 void ActionAtomistic::applyForces() {
   if(donotforce) return;
   vector<Vector>   & f(atoms.forces);
@@ -303,6 +344,10 @@ void ActionAtomistic::updateUniqueLocal() {
   } else {
     unique_local.insert(unique.begin(),unique.end());
   }
+  unique_local_shared.clear();
+  if(!local_only.empty()) {
+    for(const auto & p : unique_local) if(!local_only.count(p)) unique_local_shared.insert(p);
+  }
 }
 
 }
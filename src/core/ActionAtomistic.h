@@ -35,6 +35,7 @@ namespace PLMD {
 
 class Pbc;
 class PDB;
+class Value;
 
 /// \ingroup MULTIINHERIT
 /// Action used to create objects that access the positions of the atoms from the MD code
@@ -47,6 +48,10 @@ class ActionAtomistic :
   std::set<AtomNumber>  unique;
 /// unique_local should be an ordered set since we later create a vector containing the corresponding indexes
   std::set<AtomNumber>  unique_local;
+/// atoms whose positions are only needed by the process owning them
+  std::set<AtomNumber>  local_only;
+/// local atoms that should be shared with the other processes
+  std::set<AtomNumber>  unique_local_shared;
   std::vector<Vector>   positions;       // positions of the needed atoms
   double                energy;
   ForwardDecl<Pbc>      pbc_fwd;
@@ -81,6 +86,20 @@ public:
 /// MAYBE WE HAVE TO FIND SOMETHING MORE CLEAR FOR DYNAMIC
 /// LISTS OF ATOMS
   void requestAtoms(const std::vector<AtomNumber> & a, const bool clearDep=true);
+/// Declare that some of the requested atoms are only needed by the process owning them.
+/// When domain decomposition is used, the positions of these atoms are not
+/// communicated to the other processes, and getPosition() returns meaningful
+/// values for them only if isLocalAtom() is true.
+/// Should be called after requestAtoms(), which resets this list.
+  void setLocalOnlyAtoms(const std::vector<AtomNumber> & a);
+/// Returns true if atoms are distributed among processes with domain decomposition.
+/// In this case, actions using setLocalOnlyAtoms() should only compute the terms
+/// associated to their local atoms and sum the partial results
+  bool atomsAreDistributed()const;
+/// Returns true if the i-th atom is owned by this process.
+/// Virtual atoms are considered as owned by the first process.
+/// Always true if atomsAreDistributed() is false.
+  bool isLocalAtom(int i)const;
 /// Get position of i-th atom (access by relative index)
   const Vector & getPosition(int)const;
 /// Get position of i-th atom (access by absolute AtomNumber).
@@ -149,6 +168,11 @@ public:
   const Pbc & getPbc() const;
 /// Add the forces to the atoms
   void setForcesOnAtoms( const std::vector<double>& forcesToApply, unsigned ind=0 );
+/// Add the forces due to a value to the forces on the atoms and to the virial.
+/// The derivatives of the value with respect to the atoms start at position ind.
+/// If the value has sparse derivatives only the nonzero ones are visited.
+/// Returns false if there is no force on the value
+  bool addForcesOnAtoms( const Value* v, unsigned ind=0 );
 /// Skip atom retrieval - use with care.
 /// If this function is called during initialization, then atoms are
 /// not going to be retrieved. Can be used for optimization. Notice that
@@ -189,6 +213,8 @@ public:
   void unlockRequests() override;
   const std::set<AtomNumber> & getUnique()const;
   const std::set<AtomNumber> & getUniqueLocal()const;
+/// Local atoms whose positions should be sent to the other processes
+  const std::set<AtomNumber> & getUniqueLocalShared()const;
 /// Read in an input file containing atom positions and calculate the action for the atomic
 /// configuration therin
   void readAtomsFromPDB( const PDB& pdb ) override;
@@ -300,6 +326,12 @@ const std::set<AtomNumber> & ActionAtomistic::getUniqueLocal()const {
   return unique_local;
 }
 
+inline
+const std::set<AtomNumber> & ActionAtomistic::getUniqueLocalShared()const {
+  if(local_only.empty()) return unique_local;
+  return unique_local_shared;
+}
+
 inline
 unsigned ActionAtomistic::getTotAtoms()const {
   return atoms.positions.size();
@@ -0,0 +1,110 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2011-2020 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "ActionGraph.h"
+#include "ActionSet.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace PLMD {
+
+ActionGraph::ActionGraph():
+  width(0)
+{
+}
+
+void ActionGraph::clear() {
+  signature.clear();
+  forward.clear();
+  backward.clear();
+  width=0;
+}
+
+bool ActionGraph::update(const ActionSet&actionSet) {
+  buffer.clear();
+  for(const auto & p : actionSet) if(p->isActive()) {
+      buffer.push_back(p.get());
+      buffer.insert(buffer.end(),p->getDependencies().begin(),p->getDependencies().end());
+      buffer.push_back(NULL);
+    }
+  if(buffer==signature) return false;
+  signature.swap(buffer);
+  build(actionSet);
+  return true;
+}
+
+void ActionGraph::build(const ActionSet&actionSet) {
+  forward.clear();
+  backward.clear();
+  width=0;
+
+// Dependencies always precede an action in the ActionSet, so that levels
+// can be assigned in a single pass.
+  std::unordered_map<const Action*,unsigned> level;
+// lowest level allowed after the last barrier
+  unsigned floor=0;
+  for(const auto & pp : actionSet) {
+    const Action* p(pp.get());
+    if(!p->isActive()) continue;
+    unsigned l=floor;
+    if(p->modifiesGlobalData()) {
+      l=forward.size();
+      floor=l+1;
+    } else {
+      for(const auto & d : p->getDependencies()) {
+        const auto it=level.find(d);
+        if(it!=level.end()) l=std::max(l,it->second+1);
+      }
+    }
+    level[p]=l;
+    if(l>=forward.size()) forward.resize(l+1);
+    forward[l].push_back(pp.get());
+  }
+
+// Split levels in batches of actions not sharing dependencies.
+// Levels are traversed in reverse order, as in the serial backward loop.
+  for(auto lev=forward.rbegin(); lev!=forward.rend(); ++lev) {
+    width=std::max(width,unsigned(lev->size()));
+    std::vector<std::vector<Action*> > batches;
+    std::vector<std::vector<const Action*> > touched;
+    for(auto pp=lev->rbegin(); pp!=lev->rend(); ++pp) {
+      const Action::Dependencies & deps((*pp)->getDependencies());
+      unsigned ib=0;
+      for(; ib<batches.size(); ib++) {
+        bool conflict=false;
+        for(const auto & d : deps) if(std::find(touched[ib].begin(),touched[ib].end(),d)!=touched[ib].end()) {
+            conflict=true;
+            break;
+          }
+        if(!conflict) break;
+      }
+      if(ib==batches.size()) {
+        batches.emplace_back();
+        touched.emplace_back();
+      }
+      batches[ib].push_back(*pp);
+      touched[ib].insert(touched[ib].end(),deps.begin(),deps.end());
+    }
+    for(auto & b : batches) backward.push_back(std::move(b));
+  }
+}
+
+}
@@ -0,0 +1,80 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2011-2020 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_core_ActionGraph_h
+#define __PLUMED_core_ActionGraph_h
+
+#include <vector>
+
+namespace PLMD {
+
+class Action;
+class ActionSet;
+
+/**
+Dependency graph of the active actions.
+
+The graph is built from the dependencies declared with Action::addDependency()
+(arguments, virtual atoms, base multicolvars, etc.) and is used by PlumedMain
+to run independent actions concurrently.
+
+Active actions are grouped in levels. All the dependencies of an action
+belong to previous levels, so that actions in the same level can be calculated
+concurrently in the forward loop. Actions for which Action::modifiesGlobalData()
+returns true are used as barriers and always sit alone in their level.
+
+For the backward loop, each level is further split in batches such that actions
+in the same batch do not share any dependency. This guarantees that two actions
+never add forces to the same Value concurrently.
+
+The graph is only rebuilt when the active actions or their dependencies change.
+*/
+class ActionGraph {
+/// Active actions and their dependencies (separated by null pointers)
+/// used to build the present graph
+  std::vector<const Action*> signature;
+/// Buffer used to compute the signature at every step without allocations
+  std::vector<const Action*> buffer;
+/// Actions grouped by level, in the same order they appear in the ActionSet
+  std::vector<std::vector<Action*> > forward;
+/// Conflict free batches, in the order they should be applied
+  std::vector<std::vector<Action*> > backward;
+/// Maximum number of actions in a level
+  unsigned width;
+  void build(const ActionSet&);
+public:
+  ActionGraph();
+/// Rebuild the graph if the set of active actions or their dependencies have changed.
+/// Returns true if the graph was rebuilt.
+  bool update(const ActionSet&);
+/// Forget the present graph
+  void clear();
+/// Levels for the forward loop
+  const std::vector<std::vector<Action*> > & getForwardLevels()const {return forward;}
+/// Batches for the backward loop
+  const std::vector<std::vector<Action*> > & getBackwardBatches()const {return backward;}
+/// Maximum number of actions that can be calculated concurrently
+  unsigned getWidth()const {return width;}
+};
+
+}
+
+#endif
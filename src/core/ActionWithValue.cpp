@@ -55,7 +55,8 @@ void ActionWithValue::useCustomisableComponents(Keywords& keys) {
 ActionWithValue::ActionWithValue(const ActionOptions&ao):
   Action(ao),
   noderiv(true),
-  numericalDerivatives(false)
+  numericalDerivatives(false),
+  sparseDerivatives(false)
 {
   if( keywords.exists("NUMERICAL_DERIVATIVES") ) parseFlag("NUMERICAL_DERIVATIVES",numericalDerivatives);
   if(numericalDerivatives) log.printf("  using numerical derivatives\n");
@@ -78,6 +79,15 @@ void ActionWithValue::clearDerivatives() {
   }
 }
 
+void ActionWithValue::useSparseDerivatives() {
+  sparseDerivatives=true;
+  for(unsigned i=0; i<values.size(); i++) if(values[i]->hasDerivatives()) values[i]->setSparseDerivatives(true);
+}
+
+bool ActionWithValue::hasSparseDerivatives() const {
+  return sparseDerivatives;
+}
+
 // -- These are the routine for copying the value pointers to other classes -- //
 
 bool ActionWithValue::exists( const std::string& name ) const {
@@ -110,6 +120,7 @@ void ActionWithValue::addValue() {
 void ActionWithValue::addValueWithDerivatives() {
   plumed_massert(values.empty(),"You have already added the default value for this action");
   values.emplace_back(new Value(this,getLabel(), true ) );
+  if(sparseDerivatives) values.back()->setSparseDerivatives(true);
 }
 
 void ActionWithValue::setNotPeriodic() {
@@ -163,6 +174,7 @@ void ActionWithValue::addComponentWithDerivatives( const std::string& name ) {
                    "Remove the line addComponentWithDerivatives(\"bias\") from your bias.");
   }
   values.emplace_back(new Value(this,thename, true ) );
+  if(sparseDerivatives) values.back()->setSparseDerivatives(true);
   std::string msg="  added component to this action:  "+thename+" \n";
   log.printf(msg.c_str());
 }
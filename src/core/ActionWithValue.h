@@ -73,6 +73,8 @@ private:
   bool noderiv;
 /// Are we using numerical derivatives to differentiate
   bool numericalDerivatives;
+/// Are the nonzero derivatives of the values tracked
+  bool sparseDerivatives;
 /// Return the index for the component named name
   int getComponent( const std::string& name ) const;
 public:
@@ -155,6 +157,11 @@ public:
   void clearInputForces();
 /// Clear the derivatives of values wrt parameters
   virtual void clearDerivatives();
+/// Track the nonzero derivatives of all the values with derivatives (also those added later), see Value::setSparseDerivatives().
+/// Useful when each value depends on few atoms, e.g. one component per contact or per restraint
+  void useSparseDerivatives();
+/// Check if the nonzero derivatives of the values are tracked
+  bool hasSparseDerivatives() const;
 /// Calculate the gradients and store them for all the values (need for projections)
   void setGradientsIfNeeded();
 /// Set the value
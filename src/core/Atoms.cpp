@@ -41,6 +41,7 @@ class PlumedMain;
 
 Atoms::Atoms(PlumedMain&plumed):
   natoms(0),
+  uniqueNeedsUpdate(true),
   md_energy(0.0),
   energy(0.0),
   dataCanBeSet(false),
@@ -62,6 +63,7 @@ Atoms::Atoms(PlumedMain&plumed):
   forceOnEnergy(0.0),
   zeroallforces(false),
   kbT(0.0),
+  gatindexResized(false),
   asyncSent(false),
   atomsNeeded(false),
   ddStep(0)
@@ -144,43 +146,72 @@ void Atoms::share() {
     return;
   }
 
-  if(!(int(gatindex.size())==natoms && shuffledAtoms==0)) {
-    for(unsigned i=0; i<actions.size(); i++) {
-      if(actions[i]->isActive()) {
-        if(!actions[i]->getUnique().empty()) {
-          atomsNeeded=true;
-          // unique are the local atoms
-          unique.insert(actions[i]->getUniqueLocal().begin(),actions[i]->getUniqueLocal().end());
-        }
-      }
-    }
-  } else {
-    for(unsigned i=0; i<actions.size(); i++) {
-      if(actions[i]->isActive()) {
-        if(!actions[i]->getUnique().empty()) {
-          atomsNeeded=true;
-        }
-      }
+  bool activeChanged=(uniqueActive.size()!=actions.size());
+  uniqueActive.resize(actions.size());
+  for(unsigned i=0; i<actions.size(); i++) {
+    const char active=(actions[i]->isActive() && !actions[i]->getUnique().empty());
+    if(active) atomsNeeded=true;
+    if(uniqueActive[i]!=active) {
+      uniqueActive[i]=active;
+      activeChanged=true;
     }
+  }
 
+  if(!(int(gatindex.size())==natoms && shuffledAtoms==0)) {
+// unique is only recomputed when the requested atoms, the active actions, or
+// the domain decomposition have changed
+    if(uniqueNeedsUpdate || activeChanged) updateUnique();
   }
 
   share(unique);
 }
 
+void Atoms::updateUnique() {
+  unique.clear();
+  for(unsigned i=0; i<actions.size(); i++) if(uniqueActive[i]) {
+      // unique are the local atoms
+      unique.insert(unique.end(),actions[i]->getUniqueLocal().begin(),actions[i]->getUniqueLocal().end());
+    }
+  std::sort(unique.begin(),unique.end());
+  unique.erase(std::unique(unique.begin(),unique.end()),unique.end());
+  uniqueShared.clear();
+  if(dd && shuffledAtoms>0) {
+    for(unsigned i=0; i<actions.size(); i++) if(uniqueActive[i]) {
+        uniqueShared.insert(uniqueShared.end(),actions[i]->getUniqueLocalShared().begin(),actions[i]->getUniqueLocalShared().end());
+      }
+    std::sort(uniqueShared.begin(),uniqueShared.end());
+    uniqueShared.erase(std::unique(uniqueShared.begin(),uniqueShared.end()),uniqueShared.end());
+  }
+  updateUniqIndex();
+  uniqueNeedsUpdate=false;
+}
+
+void Atoms::updateUniqIndex() {
+  uniq_index.resize(unique.size());
+  if(shuffledAtoms>0) {
+    for(unsigned k=0; k<unique.size(); k++) uniq_index[k]=g2l[unique[k].index()];
+  } else {
+    for(unsigned k=0; k<unique.size(); k++) uniq_index[k]=unique[k].index();
+  }
+}
+
 void Atoms::shareAll() {
   unique.clear();
   // keep in unique only those atoms that are local
   if(dd && shuffledAtoms>0) {
-    for(int i=0; i<natoms; i++) if(g2l[i]>=0) unique.insert(AtomNumber::index(i));
+    for(int i=0; i<natoms; i++) if(g2l[i]>=0) unique.push_back(AtomNumber::index(i));
   } else {
-    for(int i=0; i<natoms; i++) unique.insert(AtomNumber::index(i));
+    for(int i=0; i<natoms; i++) unique.push_back(AtomNumber::index(i));
   }
+  uniqueShared=unique;
+  updateUniqIndex();
+// at next step unique should contain only the requested atoms
+  uniqueNeedsUpdate=true;
   atomsNeeded=true;
   share(unique);
 }
 
-void Atoms::share(const std::set<AtomNumber>& unique) {
+void Atoms::share(const std::vector<AtomNumber>& unique) {
   plumed_assert( positionsHaveBeenSet==3 && massesHaveBeenSet );
 
   virial.zero();
@@ -200,11 +231,6 @@ void Atoms::share(const std::set<AtomNumber>& unique) {
 // faster version, which retrieves all atoms
     mdatoms->getPositions(0,natoms,positions);
   } else {
-    uniq_index.clear();
-    uniq_index.reserve(unique.size());
-    if(shuffledAtoms>0) {
-      for(const auto & p : unique) uniq_index.push_back(g2l[p.index()]);
-    }
     mdatoms->getPositions(unique,uniq_index,positions);
   }
 
@@ -225,7 +251,7 @@ void Atoms::share(const std::set<AtomNumber>& unique) {
       for(unsigned i=0; i<dd.mpi_request_index.size(); i++)     dd.mpi_request_index[i].wait();
     }
     int count=0;
-    for(const auto & p : unique) {
+    for(const auto & p : uniqueShared) {
       dd.indexToBeSent[count]=p.index();
       dd.positionsToBeSent[ndata*count+0]=positions[p.index()][0];
       dd.positionsToBeSent[ndata*count+1]=positions[p.index()][1];
@@ -342,12 +368,14 @@ void Atoms::setNatoms(int n) {
 
 void Atoms::add(ActionAtomistic*a) {
   actions.push_back(a);
+  uniqueNeedsUpdate=true;
 }
 
 void Atoms::remove(ActionAtomistic*a) {
   auto f=find(actions.begin(),actions.end(),a);
   plumed_massert(f!=actions.end(),"cannot remove an action registered to atoms");
   actions.erase(f);
+  uniqueNeedsUpdate=true;
 }
 
 
@@ -364,6 +392,7 @@ void Atoms::DomainDecomposition::enable(Communicator& c) {
 }
 
 void Atoms::setAtomsNlocal(int n) {
+  if(gatindex.size()!=unsigned(n)) gatindexResized=true;
   gatindex.resize(n);
   g2l.resize(natoms,-1);
   if(dd) {
@@ -381,13 +410,15 @@ void Atoms::setAtomsNlocal(int n) {
 
 void Atoms::setAtomsGatindex(int*g,bool fortran) {
   plumed_massert( g || gatindex.size()==0, "NULL gatindex pointer with non-zero local atoms");
-  ddStep=plumed.getStep();
-  if(fortran) {
-    for(unsigned i=0; i<gatindex.size(); i++) gatindex[i]=g[i]-1;
-  } else {
-    for(unsigned i=0; i<gatindex.size(); i++) gatindex[i]=g[i];
-  }
-  for(unsigned i=0; i<g2l.size(); i++) g2l[i]=-1;
+// MD codes set the indexes at every step, but the local atoms only change
+// when the domain decomposition is updated: in between nothing is recomputed
+  unsigned changed=(gatindexResized?1:0);
+  gatindexResized=false;
+  const int shift=(fortran?1:0);
+  for(unsigned i=0; i<gatindex.size(); i++) if(gatindex[i]!=g[i]-shift) {
+      gatindex[i]=g[i]-shift;
+      changed=1;
+    }
   if( gatindex.size()==natoms ) {
     shuffledAtoms=0;
     for(unsigned i=0; i<gatindex.size(); i++) {
@@ -397,20 +428,35 @@ void Atoms::setAtomsGatindex(int*g,bool fortran) {
     shuffledAtoms=1;
   }
   if(dd) {
-    dd.Sum(shuffledAtoms);
+// the changes on all the processes are summed with the same call
+    unsigned flags[2]= {shuffledAtoms,changed};
+    dd.Sum(flags,2);
+    shuffledAtoms=flags[0];
+    changed=flags[1];
   }
+  if(!changed) return;
+  ddStep=plumed.getStep();
+  for(unsigned i=0; i<g2l.size(); i++) g2l[i]=-1;
   for(unsigned i=0; i<gatindex.size(); i++) g2l[gatindex[i]]=i;
 
   for(unsigned i=0; i<actions.size(); i++) {
     // keep in unique only those atoms that are local
     actions[i]->updateUniqueLocal();
   }
-  unique.clear();
+  uniqueNeedsUpdate=true;
 }
 
 void Atoms::setAtomsContiguous(int start) {
+  unsigned changed=(gatindexResized?1:0);
+  gatindexResized=false;
+  for(unsigned i=0; i<gatindex.size(); i++) if(gatindex[i]!=start+int(i)) {
+      gatindex[i]=start+i;
+      changed=1;
+    }
+// all the processes must agree, since ddStep is used to decide collective operations
+  if(dd) dd.Sum(changed);
+  if(!changed) return;
   ddStep=plumed.getStep();
-  for(unsigned i=0; i<gatindex.size(); i++) gatindex[i]=start+i;
   for(unsigned i=0; i<g2l.size(); i++) g2l[i]=-1;
   for(unsigned i=0; i<gatindex.size(); i++) g2l[gatindex[i]]=i;
   if(gatindex.size()<natoms) shuffledAtoms=1;
@@ -418,7 +464,7 @@ void Atoms::setAtomsContiguous(int start) {
     // keep in unique only those atoms that are local
     actions[i]->updateUniqueLocal();
   }
-  unique.clear();
+  uniqueNeedsUpdate=true;
 }
 
 void Atoms::setRealPrecision(int p) {
@@ -468,22 +514,20 @@ void Atoms::createFullList(int*n) {
     fullList.resize(natoms);
     for(unsigned i=0; i<natoms; i++) fullList[i]=i;
   } else {
-// We update here the unique list defined at Atoms::unique.
-// This is not very clear, and probably should be coded differently.
-// Hopefully this fix the longstanding issue with NAMD.
-    unique.clear();
+// Here the full list of requested atoms is built.
+// Atoms::unique will be updated accordingly in the next call to share().
+    fullList.resize(0);
     for(unsigned i=0; i<actions.size(); i++) {
       if(actions[i]->isActive()) {
         if(!actions[i]->getUnique().empty()) {
           atomsNeeded=true;
-          // unique are the local atoms
-          unique.insert(actions[i]->getUnique().begin(),actions[i]->getUnique().end());
+          for(const auto & p : actions[i]->getUnique()) fullList.push_back(p.index());
         }
       }
     }
-    fullList.resize(0);
-    fullList.reserve(unique.size());
-    for(const auto & p : unique) fullList.push_back(p.index());
+    std::sort(fullList.begin(),fullList.end());
+    fullList.erase(std::unique(fullList.begin(),fullList.end()),fullList.end());
+    uniqueNeedsUpdate=true;
     *n=fullList.size();
   }
 }
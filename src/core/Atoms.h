@@ -49,8 +49,20 @@ class Atoms
   friend class ActionAtomistic;
   friend class ActionWithVirtualAtom;
   int natoms;
-  std::set<AtomNumber> unique;
+/// Sorted list of the local atoms requested by the active actions
+  std::vector<AtomNumber> unique;
+/// Sorted list of the local atoms that should be sent to the other processes.
+/// It is a subset of unique, since atoms requested with ActionAtomistic::setLocalOnlyAtoms()
+/// are not communicated.
+  std::vector<AtomNumber> uniqueShared;
+/// Position of the atoms in unique in the arrays passed from the MD engine
   std::vector<unsigned> uniq_index;
+/// Set to true when unique and uniq_index should be recomputed
+/// (requested atoms or domain decomposition have changed)
+  bool uniqueNeedsUpdate;
+/// Active flags of the actions used to build unique.
+/// Used to detect activations and deactivations without rebuilding unique
+  std::vector<char> uniqueActive;
 /// Map global indexes to local indexes
 /// E.g. g2l[i] is the position of atom i in the array passed from the MD engine.
 /// Called "global to local" since originally it was used to map global indexes to local
@@ -111,6 +123,8 @@ class Atoms
 
   std::vector<ActionAtomistic*> actions;
   std::vector<int>    gatindex;
+/// true if the number of local atoms changed since the last call to setAtomsGatindex()
+  bool gatindexResized;
 
   bool asyncSent;
   bool atomsNeeded;
@@ -139,7 +153,11 @@ class Atoms
   DomainDecomposition dd;
   long int ddStep;  //last step in which dd happened
 
-  void share(const std::set<AtomNumber>&);
+  void share(const std::vector<AtomNumber>&);
+/// Recompute unique from the atoms requested by the active actions
+  void updateUnique();
+/// Recompute uniq_index from unique
+  void updateUniqIndex();
 
 public:
 
@@ -58,9 +58,12 @@ void Colvar::apply() {
   const unsigned    ncp=getNumberOfComponents();
   const unsigned    fsz=f.size();
 
+// components are split among processes only if there are enough of them
+  const bool        parallel=(ncp>4*unsigned(comm.Get_size()));
+
   unsigned stride=1;
   unsigned rank=0;
-  if(ncp>4*comm.Get_size()) {
+  if(parallel) {
     stride=comm.Get_size();
     rank=comm.Get_rank();
   }
@@ -68,39 +71,45 @@ void Colvar::apply() {
   unsigned nt=OpenMP::getNumThreads();
   if(nt>ncp/(4*stride)) nt=1;
 
-  if(!isEnergy && !isExtraCV) {
+  if(!isEnergy && !isExtraCV && hasSparseDerivatives()) {
+// only the nonzero derivatives of each component are visited
+    for(unsigned i=rank; i<ncp; i+=stride) addForcesOnAtoms(getPntrToComponent(i));
+
+    if(parallel) {
+      if(fsz>0) comm.Sum(&f[0][0],3*fsz);
+      comm.Sum(&v[0][0],9);
+    }
+
+  } else if(!isEnergy && !isExtraCV) {
     #pragma omp parallel num_threads(nt)
     {
-      vector<Vector> omp_f(fsz);
-      Tensor         omp_v;
-      vector<double> forces(3*nat+9);
+// forces from all the components are accumulated in a single array,
+// with the same layout as the derivatives (3 per atom, then 9 for the virial).
+// This is the product of the transposed derivative matrix with the forces, done one row at a time
+// since each component owns its derivatives: a single GEMV would first need a copy of all the rows
+      vector<double> omp_forces(3*nat+9,0.0);
       #pragma omp for
-      for(unsigned i=rank; i<ncp; i+=stride) {
-        if(getPntrToComponent(i)->applyForce(forces)) {
-          for(unsigned j=0; j<nat; ++j) {
-            omp_f[j][0]+=forces[3*j+0];
-            omp_f[j][1]+=forces[3*j+1];
-            omp_f[j][2]+=forces[3*j+2];
-          }
-          omp_v(0,0)+=forces[3*nat+0];
-          omp_v(0,1)+=forces[3*nat+1];
-          omp_v(0,2)+=forces[3*nat+2];
-          omp_v(1,0)+=forces[3*nat+3];
-          omp_v(1,1)+=forces[3*nat+4];
-          omp_v(1,2)+=forces[3*nat+5];
-          omp_v(2,0)+=forces[3*nat+6];
-          omp_v(2,1)+=forces[3*nat+7];
-          omp_v(2,2)+=forces[3*nat+8];
-        }
-      }
+      for(unsigned i=rank; i<ncp; i+=stride) getPntrToComponent(i)->addForceTo(omp_forces);
       #pragma omp critical
       {
-        for(unsigned j=0; j<nat; ++j) f[j]+=omp_f[j];
-        v+=omp_v;
+        for(unsigned j=0; j<nat; ++j) {
+          f[j][0]+=omp_forces[3*j+0];
+          f[j][1]+=omp_forces[3*j+1];
+          f[j][2]+=omp_forces[3*j+2];
+        }
+        v(0,0)+=omp_forces[3*nat+0];
+        v(0,1)+=omp_forces[3*nat+1];
+        v(0,2)+=omp_forces[3*nat+2];
+        v(1,0)+=omp_forces[3*nat+3];
+        v(1,1)+=omp_forces[3*nat+4];
+        v(1,2)+=omp_forces[3*nat+5];
+        v(2,0)+=omp_forces[3*nat+6];
+        v(2,1)+=omp_forces[3*nat+7];
+        v(2,2)+=omp_forces[3*nat+8];
       }
     }
 
-    if(ncp>4*comm.Get_size()) {
+    if(parallel) {
       if(fsz>0) comm.Sum(&f[0][0],3*fsz);
       comm.Sum(&v[0][0],9);
     }
@@ -86,14 +86,14 @@ public:
   }
   void getBox(Tensor &) const override;
   void getPositions(const vector<int>&index,vector<Vector>&positions) const override;
-  void getPositions(const std::set<AtomNumber>&index,const vector<unsigned>&i,vector<Vector>&positions) const override;
+  void getPositions(const std::vector<AtomNumber>&index,const vector<unsigned>&i,vector<Vector>&positions) const override;
   void getPositions(unsigned j,unsigned k,vector<Vector>&positions) const override;
   void getLocalPositions(std::vector<Vector>&p) const override;
   void getMasses(const vector<int>&index,vector<double>&) const override;
   void getCharges(const vector<int>&index,vector<double>&) const override;
   void updateVirial(const Tensor&) const override;
   void updateForces(const vector<int>&index,const vector<Vector>&) override;
-  void updateForces(const std::set<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces) override;
+  void updateForces(const std::vector<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces) override;
   void rescaleForces(const vector<int>&index,double factor) override;
   unsigned  getRealPrecision()const override;
 };
@@ -131,14 +131,14 @@ void MDAtomsTyped<T>::getPositions(const vector<int>&index,vector<Vector>&positi
 }
 
 template <class T>
-void MDAtomsTyped<T>::getPositions(const std::set<AtomNumber>&index,const vector<unsigned>&i, vector<Vector>&positions)const {
-// cannot be parallelized with omp because access to positions is not ordered
-  unsigned k=0;
-  for(const auto & p : index) {
-    positions[p.index()][0]=px[stride*i[k]]*scalep;
-    positions[p.index()][1]=py[stride*i[k]]*scalep;
-    positions[p.index()][2]=pz[stride*i[k]]*scalep;
-    k++;
+void MDAtomsTyped<T>::getPositions(const std::vector<AtomNumber>&index,const vector<unsigned>&i, vector<Vector>&positions)const {
+// index is sorted and contains no duplicates, so that this loop can be parallelized
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(index))
+  for(unsigned k=0; k<index.size(); ++k) {
+    const unsigned p=index[k].index();
+    positions[p][0]=px[stride*i[k]]*scalep;
+    positions[p][1]=py[stride*i[k]]*scalep;
+    positions[p][2]=pz[stride*i[k]]*scalep;
   }
 }
 
@@ -182,13 +182,13 @@ void MDAtomsTyped<T>::updateVirial(const Tensor&virial)const {
 }
 
 template <class T>
-void MDAtomsTyped<T>::updateForces(const std::set<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces) {
-  unsigned k=0;
-  for(const auto & p : index) {
-    fx[stride*i[k]]+=scalef*T(forces[p.index()][0]);
-    fy[stride*i[k]]+=scalef*T(forces[p.index()][1]);
-    fz[stride*i[k]]+=scalef*T(forces[p.index()][2]);
-    k++;
+void MDAtomsTyped<T>::updateForces(const std::vector<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces) {
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(fx,stride*index.size()))
+  for(unsigned k=0; k<index.size(); ++k) {
+    const unsigned p=index[k].index();
+    fx[stride*i[k]]+=scalef*T(forces[p][0]);
+    fy[stride*i[k]]+=scalef*T(forces[p][1]);
+    fz[stride*i[k]]+=scalef*T(forces[p][2]);
   }
 }
 
@@ -21,6 +21,7 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "PlumedMain.h"
 #include "ActionAtomistic.h"
+#include "ActionGraph.h"
 #include "ActionPilot.h"
 #include "ActionRegister.h"
 #include "ActionSet.h"
@@ -37,11 +38,13 @@
 #include "tools/Exception.h"
 #include "tools/IFile.h"
 #include "tools/Log.h"
+#include "tools/OFile.h"
 #include "tools/OpenMP.h"
 #include "tools/Tools.h"
 #include "tools/Stopwatch.h"
 #include "lepton/Exception.h"
 #include "DataFetchingObject.h"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <set>
@@ -121,6 +124,47 @@ static void testThrow(const char* what) {
   plumed_error() << "unknown exception " << what;
 }
 
+/// Calculate a single action, as done in the forward loop
+static void calculateAction(Action* p) {
+  ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
+  ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
+  {
+    if(av) av->clearInputForces();
+    if(av) av->clearDerivatives();
+  }
+  {
+    if(aa) aa->clearOutputForces();
+    if(aa) if(aa->isActive()) aa->retrieveAtoms();
+  }
+  if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
+  else p->calculate();
+  if(av)av->setGradientsIfNeeded();
+  ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
+  if(avv)avv->setGradientsIfNeeded();
+}
+
+/// Call f on all the actions in the list using OpenMP threads.
+/// Exceptions cannot leave a parallel region, so they are stored
+/// and the first one (in list order) is rethrown at the end.
+template<class F>
+static void runConcurrently(const std::vector<Action*> & list,F f) {
+  if(list.size()==1) {
+    f(list[0]);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(list.size());
+  const unsigned nt=std::min(OpenMP::getNumThreads(),unsigned(list.size()));
+  #pragma omp parallel for num_threads(nt) schedule(dynamic,1)
+  for(unsigned i=0; i<list.size(); i++) {
+    try {
+      f(list[i]);
+    } catch(...) {
+      errors[i]=std::current_exception();
+    }
+  }
+  for(const auto & e : errors) if(e) std::rethrow_exception(e);
+}
+
 PlumedMain::PlumedMain():
   initialized(false),
 // automatically write on log in destructor
@@ -139,7 +183,8 @@ PlumedMain::PlumedMain():
   stopFlag(NULL),
   stopNow(false),
   novirial(false),
-  detailedTimers(false)
+  detailedTimers(false),
+  taskGraph(false)
 {
   log.link(comm);
   log.setLinePrefix("PLUMED: ");
@@ -157,31 +202,69 @@ PlumedMain::~PlumedMain() {
 #define CHECK_NOTNULL(val,word) plumed_massert(val,"NULL pointer received in cmd(\"" + word + "\")");
 
 
-void PlumedMain::cmd(const std::string & word,void*val) {
+namespace {
 
 // Enumerate all possible commands:
-  enum {
+enum {
 #include "PlumedMainEnum.inc"
-  };
+};
 
 // Static object (initialized once) containing the map of commands:
+const std::unordered_map<std::string, int> & cmdMap() {
   const static std::unordered_map<std::string, int> word_map = {
 #include "PlumedMainMap.inc"
   };
+  return word_map;
+}
+
+// Static object (initialized once) containing the words of each command,
+// so that resolved commands can be executed without allocations
+const std::vector<std::vector<std::string>> & cmdWords() {
+  const static std::vector<std::vector<std::string>> words=[]() {
+    std::vector<std::vector<std::string>> w(cmdMap().size());
+    for(const auto & p : cmdMap()) w[p.second].push_back(p.first);
+    return w;
+  }();
+  return words;
+}
+
+}
+
+int PlumedMain::resolveCmd(const std::string & key) {
+  const auto it=cmdMap().find(key);
+  if(it==cmdMap().end()) return -1;
+  const int index=it->second;
+  // these commands read further words, so they cannot be executed with a handle
+  if(index==cmd_getDataRank || index==cmd_getDataShape || index==cmd_setMemoryForData ||
+      index==cmd_checkAction || index==cmd_setExtraCV || index==cmd_setExtraCVForce ||
+      index==cmd_GREX || index==cmd_CLTool || index==cmd_convert) return -1;
+  return index;
+}
+
+void PlumedMain::cmdResolved(int index,void*val) {
+  const auto & words(cmdWords());
+  plumed_massert(index>=0 && index<int(words.size()),"cmd() called with an invalid resolved command");
+  cmd(index,words[index][0],words[index],val);
+}
+
+void PlumedMain::cmd(const std::string & word,void*val) {
+  std::vector<std::string> words=Tools::getWords(word);
+  if(words.empty()) return;
+  int iword=-1;
+  const auto it=cmdMap().find(words[0]);
+  if(it!=cmdMap().end()) iword=it->second;
+  cmd(iword,word,words,val);
+}
+
+void PlumedMain::cmd(int iword,const std::string & word,const std::vector<std::string> & words,void*val) {
 
   try {
 
     auto ss=stopwatch.startPause();
 
-    std::vector<std::string> words=Tools::getWords(word);
-    unsigned nw=words.size();
-    if(nw==0) {
-      // do nothing
-    } else {
-      int iword=-1;
+    const unsigned nw=words.size();
+    {
       double d;
-      const auto it=word_map.find(words[0]);
-      if(it!=word_map.end()) iword=it->second;
       switch(iword) {
       case cmd_setBox:
         CHECK_INIT(initialized,word);
@@ -349,6 +432,7 @@ void PlumedMain::cmd(const std::string & word,void*val) {
       case cmd_clear:
         CHECK_INIT(initialized,word);
         actionSet.clearDelete();
+        actionGraph.clear();
         break;
       case cmd_getApiVersion:
         CHECK_NOTNULL(val,word);
@@ -732,6 +816,8 @@ void PlumedMain::prepareDependencies() {
     }
   }
 
+// the graph is only rebuilt if active actions or dependencies changed
+  if(taskGraph) actionGraph.update(actionSet);
 }
 
 void PlumedMain::shareData() {
@@ -770,6 +856,19 @@ void PlumedMain::justCalculate() {
   bias=0.0;
   work=0.0;
 
+// independent actions are calculated concurrently, level by level
+  if(taskGraph && actionGraph.getWidth()>1) {
+    for(const auto & level : actionGraph.getForwardLevels()) runConcurrently(level,calculateAction);
+// bias and work are accumulated in order, as in the serial loop
+    for(const auto & pp : actionSet) {
+      if(!pp->isActive()) continue;
+      ActionWithValue*av=dynamic_cast<ActionWithValue*>(pp.get());
+      if(av) bias+=av->getOutputQuantity("bias");
+      if(av) work+=av->getOutputQuantity("work");
+    }
+    return;
+  }
+
   int iaction=0;
 // calculate the active actions in order (assuming *backward* dependence)
   for(const auto & pp : actionSet) {
@@ -787,24 +886,11 @@ void PlumedMain::justCalculate() {
         for(int i=0; i<pad; i++) actionNumberLabel=" "+actionNumberLabel;
         sw=stopwatch.startStop("4A "+actionNumberLabel+" "+p->getLabel());
       }
-      ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
-      ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
-      {
-        if(av) av->clearInputForces();
-        if(av) av->clearDerivatives();
-      }
-      {
-        if(aa) aa->clearOutputForces();
-        if(aa) if(aa->isActive()) aa->retrieveAtoms();
-      }
-      if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
-      else p->calculate();
+      calculateAction(p);
       // This retrieves components called bias
+      ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
       if(av) bias+=av->getOutputQuantity("bias");
       if(av) work+=av->getOutputQuantity("work");
-      if(av)av->setGradientsIfNeeded();
-      ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
-      if(avv)avv->setGradientsIfNeeded();
     }
     iaction++;
   }
@@ -820,31 +906,43 @@ void PlumedMain::backwardPropagate() {
   int iaction=0;
 // Stopwatch is stopped when sw goes out of scope
   auto sw=stopwatch.startStop("5 Applying (backward loop)");
+  if(taskGraph && actionGraph.getWidth()>1) {
+// actions in the same batch do not share dependencies and can be applied concurrently.
+// forces on atoms are then added serially, since they go to the shared Atoms arrays
+    for(const auto & batch : actionGraph.getBackwardBatches()) {
+      runConcurrently(batch,[](Action*p) {p->apply();});
+      for(const auto & p : batch) {
+        ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
+        if(a) a->applyForces();
+      }
+    }
+  } else {
 // apply them in reverse order
-  for(auto pp=actionSet.rbegin(); pp!=actionSet.rend(); ++pp) {
-    const auto & p(pp->get());
-    if(p->isActive()) {
+    for(auto pp=actionSet.rbegin(); pp!=actionSet.rend(); ++pp) {
+      const auto & p(pp->get());
+      if(p->isActive()) {
 
 // Stopwatch is stopped when sw goes out of scope.
 // We explicitly declare a Stopwatch::Handler here to allow for conditional initialization.
-      Stopwatch::Handler sw;
-      if(detailedTimers) {
-        std::string actionNumberLabel;
-        Tools::convert(iaction,actionNumberLabel);
-        const unsigned m=actionSet.size();
-        unsigned k=0; unsigned n=1; while(n<m) { n*=10; k++; }
-        const int pad=k-actionNumberLabel.length();
-        for(int i=0; i<pad; i++) actionNumberLabel=" "+actionNumberLabel;
-        sw=stopwatch.startStop("5A "+actionNumberLabel+" "+p->getLabel());
-      }
+        Stopwatch::Handler sw;
+        if(detailedTimers) {
+          std::string actionNumberLabel;
+          Tools::convert(iaction,actionNumberLabel);
+          const unsigned m=actionSet.size();
+          unsigned k=0; unsigned n=1; while(n<m) { n*=10; k++; }
+          const int pad=k-actionNumberLabel.length();
+          for(int i=0; i<pad; i++) actionNumberLabel=" "+actionNumberLabel;
+          sw=stopwatch.startStop("5A "+actionNumberLabel+" "+p->getLabel());
+        }
 
-      p->apply();
-      ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
+        p->apply();
+        ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
 // still ActionAtomistic has a special treatment, since they may need to add forces on atoms
-      if(a) a->applyForces();
+        if(a) a->applyForces();
 
+      }
+      iaction++;
     }
-    iaction++;
   }
 
 // Stopwatch is stopped when sw goes out of scope.
@@ -952,6 +1050,12 @@ void PlumedMain::fflush() {
   }
 }
 
+std::vector<std::string> PlumedMain::getOpenFiles()const {
+  std::vector<std::string> paths;
+  for(const auto & p : files) if(dynamic_cast<const OFile*>(p)) paths.push_back(p->getPath());
+  return paths;
+}
+
 void PlumedMain::insertFile(FileBase&f) {
   files.insert(&f);
 }
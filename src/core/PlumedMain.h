@@ -52,7 +52,9 @@ namespace PLMD {
 
 
 
+class Action;
 class ActionAtomistic;
+class ActionGraph;
 class ActionPilot;
 class Log;
 class Atoms;
@@ -162,6 +164,11 @@ private:
 /// Set of actions found in plumed.dat file
   ActionSet& actionSet=*actionSet_fwd;
 
+/// Forward declaration.
+  ForwardDecl<ActionGraph> actionGraph_fwd;
+/// Dependency graph of active actions, used when taskGraph is on
+  ActionGraph& actionGraph=*actionGraph_fwd;
+
 /// Set of Pilot actions.
 /// These are the action the, if they are Pilot::onStep(), can trigger execution
   std::vector<ActionPilot*> pilots;
@@ -199,6 +206,10 @@ private:
 /// Store information used in class \ref generic::UpdateIf
   std::stack<bool> updateFlags;
 
+/// Execute command iword. Used by both cmd() and cmdResolved().
+/// word is the full command string (used in error messages) and words its parsed version
+  void cmd(int iword,const std::string&word,const std::vector<std::string>&words,void*val);
+
 public:
 /// Flag to switch off virial calculation (for debug and MD codes with no barostat)
   bool novirial;
@@ -206,6 +217,9 @@ public:
 /// Flag to switch on detailed timers
   bool detailedTimers;
 
+/// Flag to calculate and apply independent actions concurrently
+  bool taskGraph;
+
 /// Generic map string -> double
 /// intended to pass information across Actions
   std::map<std::string,double> passMap;
@@ -239,6 +253,20 @@ public:
    Notice that this interface should always keep retro-compatibility
   */
   void cmd(const std::string&key,void*val=NULL) override;
+  /**
+   Resolve a command once, so that it can be later executed with cmdResolved().
+   \param key The name of the command. It should be a single word.
+   \return An index identifying the command, or -1 if the command cannot be resolved
+           (in which case cmd() should be used).
+   It is called as plumed_cmd_resolve() or as PLMD::Plumed::resolve()
+  */
+  static int resolveCmd(const std::string&key);
+  /**
+   Execute a command previously resolved with resolveCmd().
+   Same as cmd(), but without any string parsing or memory allocation.
+   It is called as plumed_cmd_resolved() or as PLMD::Plumed::cmd()
+  */
+  void cmdResolved(int index,void*val=NULL);
   ~PlumedMain();
   /**
     Read an input file.
@@ -359,6 +387,8 @@ public:
   void eraseFile(FileBase&);
 /// Flush all files
   void fflush();
+/// Paths of the files that are currently open for writing
+  std::vector<std::string> getOpenFiles()const;
 /// Check if restarting
   bool getRestart()const;
 /// Set restart flag
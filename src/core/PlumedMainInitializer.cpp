@@ -67,13 +67,13 @@ extern "C" void plumed_plumedmain_cmd(void*plumed,const char*key,const void*val)
   p->cmd(key,val);
 }
 
-extern "C" void plumed_plumedmain_cmd_nothrow(void*plumed,const char*key,const void*val,plumed_nothrow_handler nothrow) {
 // At library boundaries we translate exceptions to error codes.
 // This allows an exception to be catched also if the MD code
 // was linked against a different C++ library
+template<typename Func>
+static void plumed_translate_exceptions(Func f,plumed_nothrow_handler nothrow) {
   try {
-    plumed_massert(plumed,"trying to use a plumed object which is not initialized");
-    static_cast<PLMD::PlumedMain*>(plumed)->cmd(key,val);;
+    f();
   } catch(const PLMD::ExceptionError & e) {
     nothrow.handler(nothrow.ptr,20200,e.what(),nullptr);
   } catch(const PLMD::ExceptionDebug & e) {
@@ -159,6 +159,36 @@ extern "C" void plumed_plumedmain_cmd_nothrow(void*plumed,const char*key,const v
   }
 }
 
+extern "C" void plumed_plumedmain_cmd_nothrow(void*plumed,const char*key,const void*val,plumed_nothrow_handler nothrow) {
+  plumed_translate_exceptions([&]() {
+    plumed_massert(plumed,"trying to use a plumed object which is not initialized");
+    static_cast<PLMD::PlumedMain*>(plumed)->cmd(key,val);
+  },nothrow);
+}
+
+// resolution should never throw
+// in case of a problem, it returns -1 and the MD code falls back to plumed_plumedmain_cmd
+extern "C" int plumed_plumedmain_cmd_resolve(void*plumed,const char*key) {
+  try {
+    if(!plumed || !key) return -1;
+    return PLMD::PlumedMain::resolveCmd(key);
+  } catch(...) {
+    return -1;
+  }
+}
+
+extern "C" void plumed_plumedmain_cmd_resolved(void*plumed,int index,const void*val) {
+  plumed_massert(plumed,"trying to use a plumed object which is not initialized");
+  static_cast<PLMD::PlumedMain*>(plumed)->cmdResolved(index,const_cast<void*>(val));
+}
+
+extern "C" void plumed_plumedmain_cmd_resolved_nothrow(void*plumed,int index,const void*val,plumed_nothrow_handler nothrow) {
+  plumed_translate_exceptions([&]() {
+    plumed_massert(plumed,"trying to use a plumed object which is not initialized");
+    static_cast<PLMD::PlumedMain*>(plumed)->cmdResolved(index,const_cast<void*>(val));
+  },nothrow);
+}
+
 extern "C" void plumed_plumedmain_finalize(void*plumed) {
   plumed_massert(plumed,"trying to deallocate a plumed object which is not initialized");
 // I think it is not possible to replace this delete with a smart pointer
@@ -168,18 +198,24 @@ extern "C" void plumed_plumedmain_finalize(void*plumed) {
 
 // values here should be consistent with those in plumed_symbol_table_init !!!!
 plumed_symbol_table_type plumed_symbol_table= {
-  2,
+  3,
   {plumed_plumedmain_create,plumed_plumedmain_cmd,plumed_plumedmain_finalize},
-  plumed_plumedmain_cmd_nothrow
+  plumed_plumedmain_cmd_nothrow,
+  plumed_plumedmain_cmd_resolve,
+  plumed_plumedmain_cmd_resolved,
+  plumed_plumedmain_cmd_resolved_nothrow
 };
 
 // values here should be consistent with those above !!!!
 extern "C" void plumed_symbol_table_init() {
-  plumed_symbol_table.version=2;
+  plumed_symbol_table.version=3;
   plumed_symbol_table.functions.create=plumed_plumedmain_create;
   plumed_symbol_table.functions.cmd=plumed_plumedmain_cmd;
   plumed_symbol_table.functions.finalize=plumed_plumedmain_finalize;
   plumed_symbol_table.cmd_nothrow=plumed_plumedmain_cmd_nothrow;
+  plumed_symbol_table.cmd_resolve=plumed_plumedmain_cmd_resolve;
+  plumed_symbol_table.cmd_resolved=plumed_plumedmain_cmd_resolved;
+  plumed_symbol_table.cmd_resolved_nothrow=plumed_plumedmain_cmd_resolved_nothrow;
 }
 
 namespace PLMD {
@@ -50,6 +50,9 @@ typedef struct {
   int version;
   plumed_plumedmain_function_holder functions;
   void (*cmd_nothrow)(void*plumed,const char*key,const void*val,plumed_nothrow_handler nothrow);
+  int (*cmd_resolve)(void*plumed,const char*key);
+  void (*cmd_resolved)(void*plumed,int index,const void*val);
+  void (*cmd_resolved_nothrow)(void*plumed,int index,const void*val,plumed_nothrow_handler nothrow);
 } plumed_symbol_table_type;
 
 
@@ -72,6 +75,17 @@ extern "C" void*plumed_plumedmain_create();
 */
 extern "C" void plumed_plumedmain_cmd(void*plumed,const char*key,const void*val);
 
+/**
+  Resolve a command `key` so that it can be later executed with \ref plumed_plumedmain_cmd_resolved.
+  Returns -1 if the command cannot be resolved.
+*/
+extern "C" int plumed_plumedmain_cmd_resolve(void*plumed,const char*key);
+
+/**
+  Send a command resolved with \ref plumed_plumedmain_cmd_resolve and a pointer `val` to a void pointer returned by \ref plumed_plumedmain_create.
+*/
+extern "C" void plumed_plumedmain_cmd_resolved(void*plumed,int index,const void*val);
+
 /**
   Finalize a void pointer returned by \ref plumed_plumedmain_create
 */
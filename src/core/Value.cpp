@@ -27,6 +27,7 @@
 #include "tools/Exception.h"
 #include "Atoms.h"
 #include "PlumedMain.h"
+#include "blas/blas.h"
 
 namespace PLMD {
 
@@ -36,6 +37,7 @@ Value::Value():
   value(0.0),
   inputForce(0.0),
   hasForce(false),
+  sparseDerivatives(false),
   hasDeriv(true),
   periodicity(unset),
   min(0.0),
@@ -51,6 +53,7 @@ Value::Value(ActionWithValue* av, const std::string& name, const bool withderiv)
   value(0.0),
   inputForce(0.0),
   hasForce(false),
+  sparseDerivatives(false),
   name(name),
   hasDeriv(withderiv),
   periodicity(unset),
@@ -80,11 +83,45 @@ bool Value::isPeriodic()const {
 bool Value::applyForce(std::vector<double>& forces ) const {
   if( !hasForce ) return false;
   plumed_dbg_massert( derivatives.size()==forces.size()," forces array has wrong size" );
+  if(sparseDerivatives) {
+    std::fill(forces.begin(),forces.end(),0.0);
+    for(const auto & i : activeDerivatives) forces[i]=inputForce*derivatives[i];
+    return true;
+  }
   const unsigned N=derivatives.size();
   for(unsigned i=0; i<N; ++i) forces[i]=inputForce*derivatives[i];
   return true;
 }
 
+bool Value::addForceTo(std::vector<double>& forces ) const {
+  if( !hasForce ) return false;
+  plumed_dbg_massert( derivatives.size()==forces.size()," forces array has wrong size" );
+  if(sparseDerivatives) {
+    for(const auto & i : activeDerivatives) forces[i]+=inputForce*derivatives[i];
+    return true;
+  }
+  int n=derivatives.size();
+  int one=1;
+  double f=inputForce;
+  if(n>0) plumed_blas_daxpy(&n,&f,const_cast<double*>(derivatives.data()),&one,forces.data(),&one);
+  return true;
+}
+
+void Value::setSparseDerivatives(bool s) {
+  sparseDerivatives=s;
+  if(sparseDerivatives) resetActiveDerivatives();
+  else {
+    activeDerivatives.clear();
+    activeMask.clear();
+  }
+}
+
+void Value::resetActiveDerivatives() {
+  activeDerivatives.clear();
+  activeMask.assign(derivatives.size(),0);
+  for(unsigned i=0; i<derivatives.size(); ++i) if(derivatives[i]!=0.0) activateDerivative(i);
+}
+
 void Value::setNotPeriodic() {
   min=0; max=0; periodicity=notperiodic;
 }
@@ -68,6 +68,17 @@ private:
   bool hasForce;
 /// The derivatives of the quantity stored in value
   std::vector<double> derivatives;
+/// If true, the indexes of the nonzero derivatives are tracked, so that clearing
+/// derivatives and applying forces cost O(number of nonzero derivatives)
+  bool sparseDerivatives;
+/// Indexes of the derivatives modified since the last call to clearDerivatives() (only with sparse derivatives)
+  std::vector<unsigned> activeDerivatives;
+/// activeMask[i] is nonzero if i is in activeDerivatives
+  std::vector<char> activeMask;
+/// Add i to the list of active derivatives
+  void activateDerivative(unsigned i);
+/// Rebuild the list of active derivatives from the nonzero ones
+  void resetActiveDerivatives();
   std::map<AtomNumber,Vector> gradients;
 /// The name of this quantiy
   std::string name;
@@ -117,6 +128,13 @@ public:
   void resizeDerivatives(int n);
 /// Set all the derivatives to zero
   void clearDerivatives();
+/// Track which derivatives are nonzero. This should be used for values depending on few atoms
+/// among those of their action: clearing derivatives and applying forces then only visit the nonzero derivatives
+  void setSparseDerivatives(bool);
+/// Check if the nonzero derivatives are tracked
+  bool hasSparseDerivatives() const;
+/// Get the indexes of the derivatives that might be nonzero (only with sparse derivatives)
+  const std::vector<unsigned>& getActiveDerivatives() const;
 /// Add some derivative to the ith component of the derivatives array
   void addDerivative(unsigned i,double d);
 /// Set the value of the ith component of the derivatives array
@@ -133,6 +151,11 @@ public:
   double getForce() const ;
 /// Apply the forces to the derivatives using the chain rule (if there are no forces this routine returns false)
   bool applyForce( std::vector<double>& forces ) const ;
+/// Add the forces to an array using the chain rule (if there are no forces this routine returns false).
+/// Unlike applyForce(), forces are accumulated, so that the forces from many values can be summed
+/// in the same array. With dense derivatives this is done with a single BLAS call,
+/// with sparse derivatives only the nonzero ones are visited
+  bool addForceTo( std::vector<double>& forces ) const ;
 /// Calculate the difference between the instantaneous value of the function and some other point: other_point-inst_val
   double difference(double)const;
 /// Calculate the difference between two values of this function: d2 -d1
@@ -236,24 +259,41 @@ bool Value::hasDerivatives() const {
 
 inline
 void Value::resizeDerivatives(int n) {
-  if(hasDeriv) derivatives.resize(n);
+  if(hasDeriv) {
+    derivatives.resize(n);
+    if(sparseDerivatives) resetActiveDerivatives();
+  }
+}
+
+inline
+void Value::activateDerivative(unsigned i) {
+  if(!activeMask[i]) {
+    activeMask[i]=1;
+    activeDerivatives.push_back(i);
+  }
 }
 
 inline
 void Value::addDerivative(unsigned i,double d) {
   plumed_dbg_massert(i<derivatives.size(),"derivative is out of bounds");
+  if(sparseDerivatives) activateDerivative(i);
   derivatives[i]+=d;
 }
 
 inline
 void Value::setDerivative(unsigned i, double d) {
   plumed_dbg_massert(i<derivatives.size(),"derivative is out of bounds");
+  if(sparseDerivatives) activateDerivative(i);
   derivatives[i]=d;
 }
 
 inline
 void Value::chainRule(double df) {
-  for(unsigned i=0; i<derivatives.size(); ++i) derivatives[i]*=df;
+  if(sparseDerivatives) {
+    for(const auto & i : activeDerivatives) derivatives[i]*=df;
+  } else {
+    for(unsigned i=0; i<derivatives.size(); ++i) derivatives[i]*=df;
+  }
 }
 
 inline
@@ -265,7 +305,26 @@ void Value::clearInputForce() {
 inline
 void Value::clearDerivatives() {
   value_set=false;
-  std::fill(derivatives.begin(), derivatives.end(), 0);
+  if(sparseDerivatives) {
+    for(const auto & i : activeDerivatives) {
+      derivatives[i]=0.0;
+      activeMask[i]=0;
+    }
+    activeDerivatives.clear();
+  } else {
+    std::fill(derivatives.begin(), derivatives.end(), 0);
+  }
+}
+
+inline
+bool Value::hasSparseDerivatives() const {
+  return sparseDerivatives;
+}
+
+inline
+const std::vector<unsigned>& Value::getActiveDerivatives() const {
+  plumed_dbg_massert(sparseDerivatives,"active derivatives are only tracked for values with sparse derivatives");
+  return activeDerivatives;
 }
 
 inline
@@ -20,6 +20,7 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "DimensionalityReductionBase.h"
+#include "Lanczos.h"
 #include "core/ActionRegister.h"
 
 //+PLUMEDOC DIMRED CLASSICAL_MDS
@@ -196,13 +197,14 @@ void ClassicalMultiDimensionalScaling::calculateProjections( const Matrix<double
     for(unsigned j=0; j<n; ++j) distances(j,i) -= sum/n;
   }
 
-  // Diagonalize matrix
-  std::vector<double> eigval(n); Matrix<double> eigvec(n,n);
-  diagMat( distances, eigval, eigvec );
+  // Only the eigenvectors with the largest eigenvalues are needed
+  unsigned nlow=projections.ncols(); std::vector<double> eigval; Matrix<double> eigvec; bool iterative;
+  if( Lanczos::diagonalize( distances, nlow, eigval, eigvec, iterative )!=0 ) error("diagonalization of the matrix of distances failed");
+  log.printf("  eigenvectors of the matrix of distances found with %s\n", iterative ? "a block Lanczos iteration" : "a full diagonalization" );
 
   // Pass final projections to map object
   for(unsigned i=0; i<n; ++i) {
-    for(unsigned j=0; j<projections.ncols(); ++j) projections(i,j)=sqrt(eigval[n-1-j])*eigvec(n-1-j,i);
+    for(unsigned j=0; j<nlow; ++j) projections(i,j)=sqrt(eigval[nlow-1-j])*eigvec(nlow-1-j,i);
   }
 }
 
@@ -0,0 +1,132 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2020 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "Lanczos.h"
+#include "tools/OpenMP.h"
+#include "tools/Random.h"
+#include <algorithm>
+#include <cmath>
+
+namespace PLMD {
+namespace dimred {
+
+/// Orthogonalize w against the first nbasis rows of basis (twice, for numerical stability) and return its norm
+static double orthogonalize( Matrix<double>& basis, const unsigned& nbasis, std::vector<double>& w, std::vector<double>& coef ) {
+  int nn=w.size(), nb=nbasis, inc=1; double one=1.0, minusone=-1.0, zero=0.0;
+  if( nbasis>0 ) {
+    for(unsigned iter=0; iter<2; ++iter) {
+      plumed_blas_dgemv("T",&nn,&nb,&one,&basis(0,0),&nn,w.data(),&inc,&zero,coef.data(),&inc);
+      plumed_blas_dgemv("N",&nn,&nb,&minusone,&basis(0,0),&nn,coef.data(),&inc,&one,w.data(),&inc);
+    }
+  }
+  double norm=0; for(unsigned i=0; i<w.size(); ++i) norm+=w[i]*w[i];
+  return std::sqrt(norm);
+}
+
+int Lanczos::diagonalize( const Matrix<double>& A, const unsigned& nvals, std::vector<double>& eigenvals, Matrix<double>& eigenvecs, bool& iterative ) {
+  const unsigned n=A.nrows(); plumed_assert( A.ncols()==n && nvals>0 && nvals<=n );
+  iterative=false;
+  MatrixWorkspace ws;
+  // Dense diagonalization is cheaper for small matrices or when many eigenvalues are required
+  if( n<minimumSize || 10*nvals>n ) return diagMat( A, nvals, eigenvals, eigenvecs, ws );
+
+  // A block of nvals vectors is iterated: a single vector only sees one direction of each eigenspace,
+  // so that an eigenvalue repeated among the nvals largest ones would be missed
+  const unsigned bsize=nvals;
+  const unsigned maxbasis=std::min( n, std::max( 300u, 30*nvals ) ) / bsize * bsize;
+  // The orthonormal basis of the Krylov subspace is stored row-wise, proj is the matrix projected on the basis
+  Matrix<double> basis( maxbasis, n ), proj( maxbasis, maxbasis ), block( bsize, n ), hsub, ritz;
+  std::vector<double> w( n ), coef( maxbasis ), theta;
+
+  // Start from random vectors with a fixed seed so that results are reproducible
+  Random rnd;
+  for(unsigned k=0; k<bsize; ++k) for(unsigned i=0; i<n; ++i) block(k,i)=rnd.RandU01()-0.5;
+
+  bool converged=false; unsigned nbasis=0, lastcheck=0;
+  while( nbasis+bsize<=maxbasis ) {
+    // Add the new block to the basis. Vectors that are (nearly) in the span of the basis are replaced by random ones
+    const unsigned start=nbasis;
+    for(unsigned k=0; k<bsize; ++k) {
+      double size=0; for(unsigned i=0; i<n; ++i) { w[i]=block(k,i); size+=w[i]*w[i]; }
+      double norm=orthogonalize( basis, nbasis, w, coef );
+      for(unsigned ntry=0; !(norm>1.e-8*std::sqrt(size)) && ntry<10; ++ntry) {
+        size=0; for(unsigned i=0; i<n; ++i) { w[i]=rnd.RandU01()-0.5; size+=w[i]*w[i]; }
+        norm=orthogonalize( basis, nbasis, w, coef );
+      }
+      if( !(norm>1.e-8*std::sqrt(size)) ) return diagMat( A, nvals, eigenvals, eigenvecs, ws );
+      for(unsigned i=0; i<n; ++i) basis(nbasis,i)=w[i]/norm;
+      nbasis++;
+    }
+
+    // Multiply the new basis vectors by the matrix and project the products on the basis
+    for(unsigned k=start; k<nbasis; ++k) {
+      #pragma omp parallel for num_threads(OpenMP::getNumThreads())
+      for(unsigned i=0; i<n; ++i) {
+        double tmp=0; for(unsigned j=0; j<n; ++j) tmp+=A(i,j)*basis(k,j);
+        w[i]=tmp;
+      }
+      int nn=n, nb=nbasis, inc=1; double one=1.0, zero=0.0;
+      plumed_blas_dgemv("T",&nn,&nb,&one,&basis(0,0),&nn,w.data(),&inc,&zero,coef.data(),&inc);
+      for(unsigned l=0; l<nbasis; ++l) { proj(l,k)=coef[l]; proj(k,l)=coef[l]; }
+      // The part of the product that is not in the basis gives the next block
+      orthogonalize( basis, nbasis, w, coef );
+      for(unsigned i=0; i<n; ++i) block(k-start,i)=w[i];
+    }
+
+    // Check for convergence of the Ritz pairs every few iterations
+    if( nbasis<lastcheck+10 && nbasis+bsize<=maxbasis ) continue;
+    lastcheck=nbasis;
+    hsub.resize( nbasis, nbasis );
+    for(unsigned i=0; i<nbasis; ++i) for(unsigned j=0; j<nbasis; ++j) hsub(i,j)=proj(i,j);
+    if( diagMat( hsub, nvals, theta, ritz, ws )!=0 ) break;
+    double scale=0; for(unsigned i=0; i<nvals; ++i) scale=std::max( scale, std::fabs(theta[i]) );
+    // The residual of each Ritz pair is the last block times the components of its eigenvector on the last basis vectors
+    converged=true;
+    for(unsigned i=0; i<nvals && converged; ++i) {
+      double res=0;
+      for(unsigned j=0; j<n; ++j) {
+        double tmp=0; for(unsigned k=0; k<bsize; ++k) tmp+=ritz(i,start+k)*block(k,j);
+        res+=tmp*tmp;
+      }
+      converged=( std::sqrt(res)<=1.e-10*scale );
+    }
+    if( converged ) break;
+  }
+  // Fall back to LAPACK if the iteration did not converge
+  if( !converged ) return diagMat( A, nvals, eigenvals, eigenvecs, ws );
+
+  // Assemble the eigenvectors from the basis vectors
+  eigenvals=theta; eigenvecs.resize( nvals, n ); eigenvecs=0;
+  for(unsigned i=0; i<nvals; ++i) {
+    for(unsigned l=0; l<nbasis; ++l) {
+      double c=ritz(i,l); for(unsigned j=0; j<n; ++j) eigenvecs(i,j)+=c*basis(l,j);
+    }
+    // Use the same phase as diagMat()
+    unsigned j;
+    for(j=0; j<n; j++) if(eigenvecs(i,j)*eigenvecs(i,j)>1e-14) break;
+    if(j<n) if(eigenvecs(i,j)<0.0) for(j=0; j<n; j++) eigenvecs(i,j)*=-1;
+  }
+  iterative=true;
+  return 0;
+}
+
+}
+}
@@ -0,0 +1,48 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2020 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_dimred_Lanczos_h
+#define __PLUMED_dimred_Lanczos_h
+
+#include <vector>
+#include "tools/Matrix.h"
+
+namespace PLMD {
+namespace dimred {
+
+/// Compute the largest eigenvalues of a symmetric matrix and the corresponding eigenvectors.
+///
+/// For large matrices a block Lanczos iteration with full reorthogonalization is used, so that the cost
+/// is dominated by a few hundred matrix-vector products instead of a full diagonalization.
+/// The block has nvals vectors, so that repeated eigenvalues are resolved.
+/// Small matrices and problems for which the iteration does not converge are passed to diagMat().
+/// Results are returned as in diagMat(): eigenvalues are in ascending order and eigenvectors are stored row-wise.
+/// iterative tells if the Lanczos iteration was used, rather than diagMat().
+class Lanczos {
+public:
+/// Matrices smaller than this are always diagonalized with LAPACK
+  static const unsigned minimumSize=1000;
+  static int diagonalize( const Matrix<double>& A, const unsigned& nvals, std::vector<double>& eigenvals, Matrix<double>& eigenvecs, bool& iterative );
+};
+
+}
+}
+#endif
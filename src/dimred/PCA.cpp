@@ -20,6 +20,7 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "PCA.h"
+#include "Lanczos.h"
 #include "tools/Matrix.h"
 #include "reference/MetricRegister.h"
 #include "reference/ReferenceValuePack.h"
@@ -227,10 +228,10 @@ void PCA::performAnalysis() {
     for(unsigned j=0; j<covar.ncols(); ++j) covar(i,j) *= inorm;
   }
 
-  // Diagonalise the covariance
-  std::vector<double> eigval( narg+3*natoms );
-  Matrix<double> eigvec( narg+3*natoms, narg+3*natoms );
-  diagMat( covar, eigval, eigvec );
+  // Diagonalise the covariance (only the eigenvectors with the largest eigenvalues are needed)
+  std::vector<double> eigval; Matrix<double> eigvec; bool iterative;
+  if( Lanczos::diagonalize( covar, nlow, eigval, eigvec, iterative )!=0 ) error("diagonalization of the covariance matrix failed");
+  log.printf("  eigenvectors of the covariance matrix found with %s\n", iterative ? "a block Lanczos iteration" : "a full diagonalization" );
 
   // Output the reference configuration
   mypdb.setAtomPositions( spos );
@@ -241,7 +242,7 @@ void PCA::performAnalysis() {
   // Store and print the eigenvectors
   std::vector<Vector> tmp_atoms( natoms );
   for(unsigned dim=0; dim<nlow; ++dim) {
-    unsigned idim = covar.ncols() - 1 - dim;
+    unsigned idim = nlow - 1 - dim;
     for(unsigned i=0; i<narg; ++i) mypdb.setArgumentValue( getArguments()[i]->getName(), eigvec(idim,i) );
     for(unsigned i=0; i<natoms; ++i) {
       for(unsigned k=0; k<3; ++k) tmp_atoms[i][k]=eigvec(idim,narg+3*i+k);
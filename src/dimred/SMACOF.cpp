@@ -46,7 +46,7 @@ void SMACOF::run( const Matrix<double>& Weights, const Matrix<double>& Distances
   Matrix<double> dists( M, M ); double myfirstsig = calculateSigma( Weights, Distances, InitialZ, dists ) / totalWeight;
 
   // initial sigma is made up of the original distances minus the distances between the projections all squared.
-  Matrix<double> temp( M, M ), BZ( M, M ), newZ( M, InitialZ.ncols() );
+  Matrix<double> temp( M, InitialZ.ncols() ), BZ( M, M ), newZ( M, InitialZ.ncols() );
   for(unsigned n=0; n<maxloops; ++n) {
     if(n==maxloops-1) plumed_merror("ran out of steps in SMACOF algorithm");
 
@@ -66,7 +66,8 @@ void SMACOF::run( const Matrix<double>& Weights, const Matrix<double>& Distances
       }
     }
 
-    mult( mypseudo, BZ, temp); mult(temp, InitialZ, newZ);
+    // BZ*InitialZ is computed first, so that no product of two MxM matrices is needed
+    mult( BZ, InitialZ, temp); mult(mypseudo, temp, newZ);
     //Compute new sigma
     double newsig = calculateSigma( Weights, Distances, newZ, dists ) / totalWeight;
     //Computing whether the algorithm has converged (has the mass of the potato changed
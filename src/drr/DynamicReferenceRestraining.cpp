@@ -235,6 +235,7 @@ public:
   void load(const string &filename);
   void backupFile(const string &filename);
   static void registerKeywords(Keywords &keys);
+  bool dependsOnPreviousSteps()const override {return true;}
   bool is_file_exist(const char *fileName);
 };
 
@@ -194,6 +194,7 @@ private:
   Matrix<double> covar_;
   Matrix<double> covar2_;
   Matrix<double> lm_inv_;
+  MatrixWorkspace lm_workspace_;
   std::string in_restart_name_;
   std::string out_restart_name_;
   std::string fmt_;
@@ -244,6 +245,7 @@ public:
   void update();
   void turnOnDerivatives();
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
   ~EDS();
 };
 
@@ -740,7 +742,6 @@ void EDS::apply_bias() {
 }
 
 void EDS::update_statistics()  {
-  double s;
   double N = fmax(1,update_calls_);
   std::vector<double> deltas(ncvs_);
   //Welford, West, and Hanso online variance method
@@ -750,16 +751,9 @@ void EDS::update_statistics()  {
     if(!b_covar_ && !b_lm_)
       ssds_[i] += deltas[i]*difference(i,means_[i],getArgument(i));
   }
-  if(b_covar_ || b_lm_) {
-    for(unsigned int i = 0; i < ncvs_; ++i) {
-      for(unsigned int j = i; j < ncvs_; ++j) {
-        s = (N - 1) * deltas[i] * deltas[j] / N / N - covar_(i,j) / N;
-        covar_(i,j) += s;
-        //do this so we don't double count
-        covar_(j,i) = covar_(i,j);
-      }
-    }
-  }
+  //covar += (N - 1) * deltas * deltas^T / N / N - covar / N
+  if(b_covar_ || b_lm_)
+    symmetricUpdate((N - 1) / N / N, deltas, 1 - 1 / N, covar_);
   if(b_virial_)
     update_pseudo_virial();
 }
@@ -793,7 +787,7 @@ void EDS::calc_lm_step_size() {
 
 // "step_size_vec" = 2*inv(covar*covar+ lambda diag(covar*covar))*covar*(mean-center)
   mult(covar_,differences_,alpha_vector_);
-  Invert(covar2_,lm_inv_);
+  Invert(covar2_,lm_inv_,lm_workspace_);
   mult(lm_inv_,alpha_vector_,alpha_vector_2_);
 
   for(unsigned int i = 0; i< ncvs_; ++i) {
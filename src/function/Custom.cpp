@@ -165,14 +165,13 @@ progression (S) and distance (Z) variables \cite perez2015atp.
 class Custom :
   public Function
 {
+/// Function and its derivatives, evaluated in a single pass
   lepton::CompiledExpression expression;
-  std::vector<lepton::CompiledExpression> expression_deriv;
   vector<string> var;
   string func;
   vector<double> values;
   vector<char*> names;
   vector<double*> lepton_ref;
-  vector<double*> lepton_ref_deriv;
 public:
   explicit Custom(const ActionOptions&);
   void calculate() override;
@@ -221,11 +220,9 @@ void Custom::registerKeywords(Keywords& keys) {
 Custom::Custom(const ActionOptions&ao):
   Action(ao),
   Function(ao),
-  expression_deriv(getNumberOfArguments()),
   values(getNumberOfArguments()),
   names(getNumberOfArguments()),
-  lepton_ref(getNumberOfArguments(),nullptr),
-  lepton_ref_deriv(getNumberOfArguments()*getNumberOfArguments(),nullptr)
+  lepton_ref(getNumberOfArguments(),nullptr)
 {
   parseVector("VAR",var);
   if(var.size()==0) {
@@ -249,18 +246,21 @@ Custom::Custom(const ActionOptions&ao):
 
   lepton::ParsedExpression pe=lepton::Parser::parse(func).optimize(lepton::Constants());
   log<<"  function as parsed by lepton: "<<pe<<"\n";
-  expression=pe.createCompiledExpression();
+  std::vector<lepton::ParsedExpression> pes(1,pe);
+  log<<"  derivatives as computed by lepton:\n";
+  for(unsigned i=0; i<getNumberOfArguments(); i++) {
+    pes.push_back(lepton::Parser::parse(func).differentiate(var[i]).optimize(lepton::Constants()));
+    log<<"    "<<pes.back()<<"\n";
+  }
+// the function and its derivatives are compiled together, so that
+// subexpressions they have in common are only computed once
+  expression=lepton::CompiledExpression(pes);
+// derivatives do not introduce new variables, so these are those of the function
   for(auto &p: expression.getVariables()) {
     if(std::find(var.begin(),var.end(),p)==var.end()) {
       error("variable " + p + " is not defined");
     }
   }
-  log<<"  derivatives as computed by lepton:\n";
-  for(unsigned i=0; i<getNumberOfArguments(); i++) {
-    lepton::ParsedExpression pe=lepton::Parser::parse(func).differentiate(var[i]).optimize(lepton::Constants());
-    log<<"    "<<pe<<"\n";
-    expression_deriv[i]=pe.createCompiledExpression();
-  }
 
   for(unsigned i=0; i<getNumberOfArguments(); i++) {
     try {
@@ -270,29 +270,15 @@ Custom::Custom(const ActionOptions&ao):
 // e.g. func=0*x
     }
   }
-  for(unsigned i=0; i<getNumberOfArguments(); i++) {
-    for(unsigned j=0; j<getNumberOfArguments(); j++) {
-      try {
-        lepton_ref_deriv[i*getNumberOfArguments()+j]=&expression_deriv[i].getVariableReference(var[j]);
-      } catch(const PLMD::lepton::Exception& exc) {
-// this is necessary since in some cases lepton things a variable is not present even though it is present
-// e.g. func=0*x
-      }
-    }
-  }
 }
 
 void Custom::calculate() {
   for(unsigned i=0; i<getNumberOfArguments(); i++) {
     if(lepton_ref[i]) *lepton_ref[i]=getArgument(i);
   }
-  setValue(expression.evaluate());
-  for(unsigned i=0; i<getNumberOfArguments(); i++) {
-    for(unsigned j=0; j<getNumberOfArguments(); j++) {
-      if(lepton_ref_deriv[i*getNumberOfArguments()+j]) *lepton_ref_deriv[i*getNumberOfArguments()+j]=getArgument(j);
-    }
-    setDerivative(i,expression_deriv[i].evaluate());
-  }
+  const auto & res=expression.evaluateAll();
+  setValue(res[0]);
+  for(unsigned i=0; i<getNumberOfArguments(); i++) setDerivative(i,res[i+1]);
 }
 
 }
@@ -0,0 +1 @@
+#include "../../bias/Bias.h"
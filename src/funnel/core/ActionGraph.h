@@ -0,0 +1 @@
+#include "../../core/ActionGraph.h"
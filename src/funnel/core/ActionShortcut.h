@@ -0,0 +1 @@
+#include "../../core/ActionShortcut.h"
@@ -0,0 +1 @@
+#include "../../core/CLToolMain.h"
@@ -0,0 +1 @@
+#include "../../core/PlumedMainInitializer.h"
@@ -0,0 +1 @@
+#include "../../core/SetupMolInfo.h"
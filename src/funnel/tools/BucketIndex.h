@@ -0,0 +1 @@
+#include "../../tools/BucketIndex.h"
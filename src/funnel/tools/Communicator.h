@@ -0,0 +1 @@
+#include "../../tools/Communicator.h"
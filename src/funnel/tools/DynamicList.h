@@ -0,0 +1 @@
+#include "../../tools/DynamicList.h"
@@ -0,0 +1 @@
+#include "../../tools/Minimise1DBrent.h"
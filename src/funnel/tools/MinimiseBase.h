@@ -0,0 +1 @@
+#include "../../tools/MinimiseBase.h"
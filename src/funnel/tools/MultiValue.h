@@ -0,0 +1 @@
+#include "../../tools/MultiValue.h"
@@ -0,0 +1 @@
+#include "../../tools/PlumedHandle.h"
@@ -0,0 +1 @@
+#include "../../tools/RMSD.h"
@@ -0,0 +1 @@
+#include "../../tools/Vector.h"
@@ -23,6 +23,7 @@
 #include "core/ActionPilot.h"
 #include "core/ActionSet.h"
 #include "core/PlumedMain.h"
+#include "tools/Communicator.h"
 
 using namespace std;
 
@@ -40,10 +41,24 @@ Can be used while debugging or optimizing plumed.
 \plumedfile
 # print detailed (action-by-action) timers at the end of simulation
 DEBUG DETAILED_TIMERS
+# calculate and apply independent actions concurrently using OpenMP threads
+DEBUG TASK_GRAPH
 # dump every two steps which are the atoms required from the MD code
 DEBUG logRequestedAtoms STRIDE=2
 \endplumedfile
 
+With TASK_GRAPH, the dependencies between active actions (arguments, virtual atoms, etc.)
+are used to build a graph that is only updated when the active actions change.
+Actions that do not depend on each other are then calculated, and their forces applied,
+concurrently on the OpenMP threads (see \ref Openmp). This is useful when many
+inexpensive and independent collective variables are used. Actions that modify the
+global positions or forces (e.g. \ref WHOLEMOLECULES or \ref FIT_TO_TEMPLATE) and actions without
+values (e.g. \ref PRINT) are never run concurrently with other actions. Since actions
+cannot call MPI from several threads at the same time, this option is ignored whenever
+MPI is initialized, even with a single process (run plumed with --no-mpi to use it).
+Messages written by actions on the log are not mixed, but their order may change.
+Detailed timers cannot be collected for actions run concurrently.
+
 */
 //+ENDPLUMEDOC
 class Debug:
@@ -54,6 +69,7 @@ class Debug:
   bool logRequestedAtoms;
   bool novirial;
   bool detailedTimers;
+  bool taskGraph;
 public:
   explicit Debug(const ActionOptions&ao);
 /// Register all the relevant keywords for the action
@@ -72,6 +88,7 @@ void Debug::registerKeywords( Keywords& keys ) {
   keys.addFlag("logRequestedAtoms",false,"write in the log which atoms have been requested at a given time");
   keys.addFlag("NOVIRIAL",false,"switch off the virial contribution for the entirety of the simulation");
   keys.addFlag("DETAILED_TIMERS",false,"switch on detailed timers");
+  keys.addFlag("TASK_GRAPH",false,"calculate and apply independent actions concurrently");
   keys.add("optional","FILE","the name of the file on which to output these quantities");
 }
 
@@ -93,6 +110,16 @@ Debug::Debug(const ActionOptions&ao):
     log.printf("  Detailed timing on\n");
     plumed.detailedTimers=true;
   }
+  parseFlag("TASK_GRAPH",taskGraph);
+  if(taskGraph) {
+// collective calls (even on a single process) cannot be made concurrently from several threads
+    if(Communicator::initialized()) {
+      log.printf("  Task graph is not available when MPI is initialized, actions will be calculated serially\n");
+    } else {
+      log.printf("  Independent actions will be calculated concurrently\n");
+      plumed.taskGraph=true;
+    }
+  }
   ofile.link(*this);
   std::string file;
   parse("FILE",file);
@@ -234,11 +234,10 @@ DumpAtoms::DumpAtoms(const ActionOptions&ao):
   log<<"  Writing on file "<<path<<"\n";
 #ifdef __PLUMED_HAS_XDRFILE
   std::string mode=of.getMode();
+// of is left open (and empty) so that the file is still listed among the outputs, e.g. by driver --parallel-frames
   if(type=="xtc") {
-    of.close();
     xd=xdrfile_open(path.c_str(),mode.c_str());
   } else if(type=="trr") {
-    of.close();
     xd=xdrfile_open(path.c_str(),mode.c_str());
   }
 #endif
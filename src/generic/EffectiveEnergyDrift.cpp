@@ -115,6 +115,7 @@ public:
   ~EffectiveEnergyDrift();
 
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return true;}
 
   void calculate() override {};
   void apply() override {};
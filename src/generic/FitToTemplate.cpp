@@ -198,6 +198,8 @@ public:
   void calculate() override;
   void apply() override;
   unsigned getNumberOfDerivatives() override {plumed_merror("You should not call this function");};
+/// global positions and forces are modified
+  bool modifiesGlobalData()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(FitToTemplate,"FIT_TO_TEMPLATE")
@@ -94,6 +94,7 @@ private:
   std::vector<std::unique_ptr<Value>> readvals;
 public:
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return true;}
   explicit Read(const ActionOptions&);
   void prepare() override;
   void apply() override {}
@@ -22,6 +22,8 @@
 #include "GridPrintingBase.h"
 #include "core/ActionRegister.h"
 #include "tools/OFile.h"
+#include "tools/Grid.h"
+#include <cstdio>
 
 namespace PLMD {
 namespace gridtools {
@@ -63,6 +65,10 @@ x=0 and 100 values of y between 0.0 and 3.0 will be provided.  This block of dat
 There will then be a second block of values which will all have been evaluated the same value of x and all possible values
 for y.  This block is then followed by a blank line again and this pattern continues until all points of the grid have been covered.
 
+If the name of the output file has extension .bin the grid is written in a binary format, which is faster to write and to read and
+takes less disk space.  The binary file starts with a short text header that contains the same information described above.
+Files in this format can be read by the actions that take grids in input, e.g. \ref EXTERNAL.
+
 \par Examples
 
 The following input monitors two torsional angles during a simulation
@@ -161,6 +167,27 @@ DumpGrid::DumpGrid(const ActionOptions&ao):
 }
 
 void DumpGrid::printGrid( OFile& ofile ) const {
+  if( GridBase::useBinaryFormat( ofile.getPath() ) ) {
+    BinaryGridHeader header;
+    for(unsigned i=0; i<ingrid->getDimension(); ++i) {
+      header.names.push_back( ingrid->getComponentName(i) );
+      header.periodic.push_back( ingrid->isPeriodic(i) );
+    }
+    header.min=ingrid->getMin(); header.max=ingrid->getMax(); header.nbins=ingrid->getNbin();
+    for(unsigned j=0; j<ingrid->getNumberOfQuantities(); ++j) header.fields.push_back( ingrid->arg_names[ingrid->dimension+j] );
+    char norm[64]; std::snprintf(norm,sizeof(norm),"%.17g",ingrid->getNorm());
+    header.constants.push_back( std::pair<std::string,std::string>("normalisation",norm) );
+    header.npoints=ingrid->getNumberOfPoints();
+    header.littleEndian=BinaryGridHeader::isLittleEndian();
+    header.write( ofile );
+    // All the points are written at once, the grid is already stored in memory anyway
+    std::vector<double> buffer( header.npoints*header.fields.size() );
+    for(unsigned i=0; i<ingrid->getNumberOfPoints(); ++i) {
+      for(unsigned j=0; j<ingrid->getNumberOfQuantities(); ++j) buffer[i*header.fields.size()+j]=ingrid->getGridElement( i, j );
+    }
+    if( buffer.size()>0 ) ofile.writeBinary( buffer.data(), buffer.size()*sizeof(double) );
+    return;
+  }
   ofile.addConstantField("normalisation");
   for(unsigned i=0; i<ingrid->getDimension(); ++i) {
     ofile.addConstantField("min_" + ingrid->getComponentName(i) );
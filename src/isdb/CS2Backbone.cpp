@@ -34,12 +34,15 @@
 #include <fstream>
 #include <iterator>
 #include <sstream>
+#include <algorithm>
 
 #include "MetainferenceBase.h"
 #include "core/ActionRegister.h"
 #include "tools/Pbc.h"
 #include "tools/PDB.h"
 #include "tools/Torsion.h"
+#include "tools/Communicator.h"
+#include "tools/LinkCells.h"
 
 using namespace std;
 
@@ -410,7 +413,6 @@ class CS2Backbone : public MetainferenceBase {
     vector<unsigned> side_chain;// atoms for the current sidechain
     vector<int> xd1;            // additional couple of atoms
     vector<int> xd2;            // additional couple of atoms
-    vector<unsigned> box_nb;    // non-bonded atoms
 
     ChemicalShift():
       exp_cs(0.),
@@ -431,7 +433,6 @@ class CS2Backbone : public MetainferenceBase {
     {
       xd1.reserve(26);
       xd2.reserve(26);
-      box_nb.reserve(150);
     }
   };
 
@@ -470,6 +471,13 @@ class CS2Backbone : public MetainferenceBase {
   bool             camshift;
   bool             pbc;
   bool             serial;
+  // non-bonded atoms of chemical shift cs are box_nb[box_start[cs]] ... box_nb[box_start[cs+1]-1]
+  vector<unsigned> box_start;
+  vector<unsigned> box_nb;
+  vector<Vector>   box_positions;
+  vector<unsigned> box_indices;
+  Communicator     serialcomm;
+  LinkCells        linkcells;
 
   void init_cs(const string &file, const string &k, const PDB &pdb);
   void update_neighb();
@@ -522,7 +530,8 @@ CS2Backbone::CS2Backbone(const ActionOptions&ao):
   max_cs_atoms(0),
   camshift(false),
   pbc(true),
-  serial(false)
+  serial(false),
+  linkcells(serialcomm)
 {
   vector<AtomNumber> used_atoms;
   parseAtomList("ATOMS",used_atoms);
@@ -1216,9 +1225,10 @@ void CS2Backbone::calculate()
       //NON BOND
       const double * CONST_CO_SPHERE3 = db.CO_SPHERE(aa_kind,at_kind,0);
       const double * CONST_CO_SPHERE  = db.CO_SPHERE(aa_kind,at_kind,1);
-      const unsigned boxsize = myfrag->box_nb.size();
+      const unsigned boxfirst = box_start[cs];
+      const unsigned boxsize = box_start[cs+1]-boxfirst;
       for(unsigned q=0; q<boxsize; q++) {
-        const unsigned jpos = myfrag->box_nb[q];
+        const unsigned jpos = box_nb[boxfirst+q];
         const Vector distance = delta(getPosition(jpos),getPosition(ipos));
         const double d2 = distance.modulo2();
 
@@ -1351,21 +1361,62 @@ void CS2Backbone::calculate()
 }
 
 void CS2Backbone::update_neighb() {
-  max_cs_atoms=0;
+  const unsigned ncs = chemicalshifts.size();
+  const unsigned boxsize = getNumberOfAtoms();
+  box_start.assign(ncs+1,0);
+  box_positions.resize(boxsize);
+  box_indices.resize(boxsize);
+  for(unsigned bat=0; bat<boxsize; bat++) {
+    box_positions[bat] = getPosition(bat);
+    box_indices[bat] = bat;
+  }
+  linkcells.setCutoff(cutOffNB);
+  linkcells.buildCellLists(box_positions,box_indices);
+
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*2>ncs) nt=1;
+
   // cycle over chemical shifts
-  for(unsigned cs=0; cs<chemicalshifts.size(); cs++) {
-    const unsigned boxsize = getNumberOfAtoms();
-    chemicalshifts[cs].box_nb.clear();
-    chemicalshifts[cs].box_nb.reserve(150);
-    const unsigned res_curr = res_num[chemicalshifts[cs].ipos];
-    for(unsigned bat=0; bat<boxsize; bat++) {
-      const unsigned res_dist = abs(static_cast<int>(res_curr-res_num[bat]));
-      if(res_dist<2) continue;
-      const Vector distance = delta(getPosition(bat),getPosition(chemicalshifts[cs].ipos));
-      const double d2=distance.modulo2();
-      if(d2<cutOffNB2) chemicalshifts[cs].box_nb.push_back(bat);
+  #pragma omp parallel num_threads(nt)
+  {
+    // with a static schedule each thread gets a contiguous range of chemical shifts,
+    // so that its neighbors can be copied at once in the final list
+    vector<unsigned> box_omp, cells, cellatoms(boxsize+1);
+    unsigned first = ncs;
+    #pragma omp for schedule(static)
+    for(unsigned cs=0; cs<ncs; cs++) {
+      if(first==ncs) first = cs;
+      const unsigned ipos = chemicalshifts[cs].ipos;
+      const unsigned res_curr = res_num[ipos];
+      unsigned natoms = 1;
+      cellatoms[0] = ipos;
+      linkcells.retrieveNeighboringAtoms(getPosition(ipos),cells,natoms,cellatoms);
+      std::sort(cellatoms.begin()+1,cellatoms.begin()+natoms);
+      unsigned count = 0;
+      for(unsigned k=1; k<natoms; k++) {
+        const unsigned bat = cellatoms[k];
+        const unsigned res_dist = abs(static_cast<int>(res_curr-res_num[bat]));
+        if(res_dist<2) continue;
+        const Vector distance = delta(getPosition(bat),getPosition(ipos));
+        const double d2=distance.modulo2();
+        if(d2<cutOffNB2) {
+          box_omp.push_back(bat);
+          count++;
+        }
+      }
+      box_start[cs+1] = count;
+      chemicalshifts[cs].totcsatoms = chemicalshifts[cs].csatoms + count;
+    }
+    #pragma omp single
+    {
+      for(unsigned cs=0; cs<ncs; cs++) box_start[cs+1] += box_start[cs];
+      box_nb.resize(box_start[ncs]);
     }
-    chemicalshifts[cs].totcsatoms = chemicalshifts[cs].csatoms + chemicalshifts[cs].box_nb.size();
+    if(first<ncs) std::copy(box_omp.begin(),box_omp.end(),box_nb.begin()+box_start[first]);
+  }
+
+  max_cs_atoms=0;
+  for(unsigned cs=0; cs<ncs; cs++) {
     if(chemicalshifts[cs].totcsatoms>max_cs_atoms) max_cs_atoms = chemicalshifts[cs].totcsatoms;
   }
 }
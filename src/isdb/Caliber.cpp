@@ -94,6 +94,7 @@ class Caliber : public bias::Bias {
 public:
   explicit Caliber(const ActionOptions&);
   void calculate();
+  bool dependsOnPreviousSteps()const override {return true;}
   static void registerKeywords( Keywords& keys );
 private:
   vector<double> time;
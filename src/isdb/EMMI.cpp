@@ -251,6 +251,7 @@ public:
 // active methods:
   void prepare() override;
   void calculate() override;
+  bool dependsOnPreviousSteps()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(EMMI,"EMMI")
@@ -46,7 +46,6 @@ class MetainferenceBase :
   public ActionWithValue
 {
 private:
-  std::vector<double> forces;
   std::vector<double> forcesToApply;
 
   // activate metainference
@@ -175,6 +174,7 @@ private:
 
 public:
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return doscore_;}
   explicit MetainferenceBase(const ActionOptions&);
   ~MetainferenceBase();
   void Initialise(const unsigned input);
@@ -284,7 +284,7 @@ void MetainferenceBase::setDerivatives() {
   }
 
   // Resize all derivative arrays
-  forces.resize( nder ); forcesToApply.resize( nder );
+  forcesToApply.resize( nder );
   for(int i=0; i<getNumberOfComponents(); ++i) getPntrToComponent(i)->resizeDerivatives(nder);
 }
 
@@ -334,10 +334,7 @@ inline
 void MetainferenceBase::apply() {
   bool wasforced=false; forcesToApply.assign(forcesToApply.size(),0.0);
   for(int i=0; i<getNumberOfComponents(); ++i) {
-    if( getPntrToComponent(i)->applyForce( forces ) ) {
-      wasforced=true;
-      for(unsigned i=0; i<forces.size(); ++i) forcesToApply[i]+=forces[i];
-    }
+    if( getPntrToComponent(i)->addForceTo( forcesToApply ) ) wasforced=true;
   }
   if( wasforced ) {
     addForcesOnArguments( forcesToApply );
@@ -162,6 +162,8 @@ NOE::NOE(const ActionOptions&ao):
   log << " Bibliography" << plumed.cite("Bonomi, Camilloni, Bioinformatics, 33, 3999 (2017)") << "\n";
 
   if(!getDoScore()) {
+// each component only depends on the atoms of its restraint
+    useSparseDerivatives();
     for(unsigned i=0; i<nga.size(); i++) {
       string num; Tools::convert(i,num);
       addComponentWithDerivatives("noe-"+num);
@@ -35,6 +35,7 @@
 #include <string>
 #include <cmath>
 #include <map>
+#include <algorithm>
 
 #ifdef __PLUMED_HAS_ARRAYFIRE
 #include <arrayfire.h>
@@ -63,6 +64,10 @@ The calculated intensities can be scaled using the SCALEINT keywords. This is ap
 Experimental reference intensities can be added using the EXPINT keywords.
 By default SAXS is calculated using Debye on CPU, by adding the GPU flag it is possible to solve the equation on a GPU
 if the ARRAYFIRE libraries are installed and correctly linked.
+On CPU, large systems can be treated with HISTOGRAM_TOL: pair distances are then collected in a histogram whose bin width,
+\f$\sqrt{24\,tol}/q_{max}\f$ with \f$q_{max}\f$ the largest QVALUE converted to nm\f$^{-1}\f$,
+is chosen so that the error on the \f$\sin(qr)/(qr)\f$ term of each pair, as well as on its derivative with respect to \f$qr\f$,
+is lower than the given tolerance. Trigonometric functions are then only evaluated once per bin rather than once per pair.
 \ref METAINFERENCE can be activated using DOSCORE and the other relevant keywords.
 
 \par Examples
@@ -124,14 +129,18 @@ private:
   bool                       serial;
   bool                       gpu;
   int                        deviceid;
+  double                     histo_width;
   vector<unsigned>           atoi;
   vector<double>             q_list;
   vector<double>             FF_rank;
   vector<vector<double> >    FF_value;
+  // form factors of each atom (times sqrt(2)), q-major on CPU or atom-major with HISTOGRAM_TOL
+  vector<double>             FF_flat;
   vector<vector<float> >     FFf_value;
 
   void calculate_gpu(vector<Vector> &deriv);
   void calculate_cpu(vector<Vector> &deriv);
+  void calculate_histogram(vector<Vector> &deriv);
   void getMartiniSFparam(const vector<AtomNumber> &atoms, vector<vector<long double> > &parameter);
   double calculateASF(const vector<AtomNumber> &atoms, vector<vector<long double> > &FF_tmp, const double rho);
 
@@ -153,6 +162,7 @@ void SAXS::registerKeywords(Keywords& keys) {
   keys.addFlag("GPU",false,"calculate SAXS using ARRAYFIRE on an accelerator device");
   keys.addFlag("ATOMISTIC",false,"calculate SAXS for an atomistic model");
   keys.addFlag("MARTINI",false,"calculate SAXS for a Martini model");
+  keys.add("optional","HISTOGRAM_TOL","use a histogram of the pair distances on CPU, with a bin width such that the error on sin(qr)/qr is lower than this value");
   keys.add("atoms","ATOMS","The atoms to be included in the calculation, e.g. the whole protein.");
   keys.add("numbered","QVALUE","Selected scattering lengths in Angstrom are given as QVALUE1, QVALUE2, ... .");
   keys.add("numbered","PARAMETERS","Used parameter Keywords like PARAMETERS1, PARAMETERS2. These are used to calculate the structure factor for the \\f$i\\f$th atom/bead.");
@@ -168,7 +178,8 @@ SAXS::SAXS(const ActionOptions&ao):
   pbc(true),
   serial(false),
   gpu(false),
-  deviceid(0)
+  deviceid(0),
+  histo_width(0.)
 {
   vector<AtomNumber> atoms;
   parseAtomList("ATOMS",atoms);
@@ -211,6 +222,19 @@ SAXS::SAXS(const ActionOptions&ao):
     log.printf("  my q: %lf \n",q_list[i]);
   }
 
+  double histo_tol=0.;
+  parse("HISTOGRAM_TOL",histo_tol);
+  if(histo_tol<0.) error("HISTOGRAM_TOL should be positive");
+  if(histo_tol>0.) {
+    if(gpu) error("HISTOGRAM_TOL cannot be used together with GPU");
+    if(numq==0) error("HISTOGRAM_TOL requires at least one QVALUE");
+    // the error of a first order expansion of sinc around the closest bin center
+    // is bounded by (q*width)^2/24, since |sinc''|<=1/3 (and |sinc'''|<=1/4).
+    // Here q is still in A^-1 (it is converted below), the factor 10 gives the width in nm
+    histo_width=std::sqrt(24.*histo_tol)/(10.*q_list[numq-1]);
+    log.printf("  using a histogram of pair distances with bin width %lf nm\n",histo_width);
+  }
+
   bool atomistic=false;
   parseFlag("ATOMISTIC",atomistic);
   bool martini=false;
@@ -294,6 +318,12 @@ SAXS::SAXS(const ActionOptions&ao):
       for(unsigned i=0; i<n_atom_types; i++) FF_value[i][k] = static_cast<double>(FF_tmp[k][i])/sqrt(scale_int);
       for(unsigned i=0; i<size; i++) FF_rank[k] += FF_value[atoi[i]][k]*FF_value[atoi[i]][k];
     }
+    FF_flat.resize(size*numq);
+    for(unsigned k=0; k<numq; ++k) for(unsigned i=0; i<size; i++) {
+        const double ff=std::sqrt(2.)*FF_value[atoi[i]][k];
+        if(histo_width>0.) FF_flat[i*numq+k]=ff;
+        else FF_flat[k*size+i]=ff;
+      }
   } else {
     FFf_value.resize(numq,vector<float>(size));
     for(unsigned k=0; k<numq; ++k) {
@@ -459,6 +489,30 @@ void SAXS::calculate_gpu(vector<Vector> &deriv)
 #endif
 }
 
+/// Branch-free sine and cosine for non-negative arguments, so that loops calling it can be vectorized.
+/// The argument is reduced to [-pi/4,pi/4] with a three-part Cody-Waite reduction, accurate for x<1e6,
+/// and the kernels are the minimax polynomials of fdlibm.
+static inline void sincosDebye(const double x, double & s, double & c) {
+  const double invpio2=6.36619772367581382433e-01;
+  const double pio2_1=1.57079632673412561417e+00;
+  const double pio2_2=6.07710050630396597660e-11;
+  const double pio2_3=2.02226624871116645580e-21;
+  // round to nearest without calling a library function
+  const double shift=6755399441055744.0;
+  const double n=(x*invpio2+shift)-shift;
+  const double r=((x-n*pio2_1)-n*pio2_2)-n*pio2_3;
+  const double z=r*r;
+  const double ks=r+r*z*(-1.66666666666666324348e-01+z*(8.33333333332248946124e-03+z*(-1.98412698298579493134e-04
+                              +z*(2.75573137070700676789e-06+z*(-2.50507602534068634195e-08+z*1.58969099521155010221e-10)))));
+  const double kc=1.0-0.5*z+z*z*(4.16666666666666019037e-02+z*(-1.38888888888741095749e-03+z*(2.48015872894767294178e-05
+                                 +z*(-2.75573143513906633035e-07+z*(2.08757232129817482790e-09+z*-1.13596475577881948265e-11)))));
+  const int quadrant=static_cast<int>(n);
+  const double ss=(quadrant&1)?kc:ks;
+  const double cc=(quadrant&1)?ks:kc;
+  s=(quadrant&2)?-ss:ss;
+  c=((quadrant+1)&2)?-cc:cc;
+}
+
 void SAXS::calculate_cpu(vector<Vector> &deriv)
 {
   const unsigned size = getNumberOfAtoms();
@@ -471,52 +525,86 @@ void SAXS::calculate_cpu(vector<Vector> &deriv)
     rank   = 0;
   }
 
+  // positions are stored by coordinate so that the loops over blocks of partners are vectorized
+  vector<double> pos(3*size);
+  for(unsigned i=0; i<size; i++) {
+    const Vector & p=getPosition(i);
+    pos[i]=p[0]; pos[size+i]=p[1]; pos[2*size+i]=p[2];
+  }
+  const double* px=&pos[0];
+  const double* py=px+size;
+  const double* pz=py+size;
+
+  const unsigned block=128;
   vector<double> sum(numq,0);
+  vector<double> dsum(3*numq*size,0.);
   unsigned nt=OpenMP::getNumThreads();
   #pragma omp parallel num_threads(nt)
   {
-    std::vector<Vector> omp_deriv(deriv.size());
+    // derivatives are stored as [(3*k+component)*size+atom]
+    std::vector<double> omp_deriv(nt>1?dsum.size():0,0.);
+    double* d=(nt>1?omp_deriv.data():dsum.data());
     std::vector<double> omp_sum(numq,0);
-    #pragma omp for nowait
-    for (unsigned i=rank; i<size-1; i+=stride) {
-      Vector posi = getPosition(i);
-      for (unsigned j=i+1; j<size ; j++) {
-        Vector c_distances = delta(posi,getPosition(j));
-        double m_distances = c_distances.modulo();
-        c_distances = c_distances/m_distances/m_distances;
+    std::vector<double> rij(block), ux(block), uy(block), uz(block);
+    #pragma omp for schedule(dynamic) nowait
+    for (unsigned i=rank; i<size; i+=stride) {
+      for(unsigned j0=i+1; j0<size; j0+=block) {
+        const unsigned nj=std::min(block,size-j0);
+        #pragma omp simd
+        for(unsigned jj=0; jj<nj; jj++) {
+          const double dx=px[j0+jj]-px[i];
+          const double dy=py[j0+jj]-py[i];
+          const double dz=pz[j0+jj]-pz[i];
+          const double r2=dx*dx+dy*dy+dz*dz;
+          const double inv=1./r2;
+          rij[jj]=std::sqrt(r2);
+          ux[jj]=dx*inv; uy[jj]=dy*inv; uz[jj]=dz*inv;
+        }
         for (unsigned k=0; k<numq; k++) {
-          unsigned kdx=k*size;
-          double qdist = q_list[k]*m_distances;
-          double FFF = 2.*FF_value[atoi[i]][k]*FF_value[atoi[j]][k];
-          double tsq = sin(qdist)/qdist;
-          double tcq = cos(qdist);
-          double tmp = FFF*(tcq-tsq);
-          Vector dd  = c_distances*tmp;
-          if(nt>1) {
-            omp_deriv[kdx+i] -=dd;
-            omp_deriv[kdx+j] +=dd;
-            omp_sum[k] += FFF*tsq;
-          } else {
-            deriv[kdx+i] -= dd;
-            deriv[kdx+j] += dd;
-            sum[k]       += FFF*tsq;
+          const double q=q_list[k];
+          const double ffi=FF_flat[k*size+i];
+          const double* ffj=&FF_flat[k*size+j0];
+          double* dx=d+3*k*size;
+          double* dy=dx+size;
+          double* dz=dy+size;
+          double s=0., dix=0., diy=0., diz=0.;
+          #pragma omp simd reduction(+:s,dix,diy,diz)
+          for(unsigned jj=0; jj<nj; jj++) {
+            const double qdist=q*rij[jj];
+            double tsin, tcq;
+            sincosDebye(qdist,tsin,tcq);
+            const double FFF=ffi*ffj[jj];
+            const double tsq=tsin/qdist;
+            const double tmp=FFF*(tcq-tsq);
+            s+=FFF*tsq;
+            dx[j0+jj]+=ux[jj]*tmp;
+            dy[j0+jj]+=uy[jj]*tmp;
+            dz[j0+jj]+=uz[jj]*tmp;
+            dix+=ux[jj]*tmp;
+            diy+=uy[jj]*tmp;
+            diz+=uz[jj]*tmp;
           }
+          omp_sum[k]+=s;
+          dx[i]-=dix;
+          dy[i]-=diy;
+          dz[i]-=diz;
         }
       }
     }
     #pragma omp critical
-    if(nt>1) {
-      for(unsigned i=0; i<deriv.size(); i++) deriv[i]+=omp_deriv[i];
+    {
+      if(nt>1) for(unsigned i=0; i<dsum.size(); i++) dsum[i]+=omp_deriv[i];
       for(unsigned k=0; k<numq; k++) sum[k]+=omp_sum[k];
     }
   }
 
   if(!serial) {
-    comm.Sum(&deriv[0][0], 3*deriv.size());
-    comm.Sum(&sum[0], numq);
+    comm.Sum(dsum);
+    comm.Sum(sum);
   }
 
   for (unsigned k=0; k<numq; k++) {
+    for(unsigned i=0; i<size; i++) deriv[k*size+i]=Vector(dsum[3*k*size+i],dsum[(3*k+1)*size+i],dsum[(3*k+2)*size+i]);
     sum[k]+=FF_rank[k];
     string num; Tools::convert(k,num);
     Value* val=getPntrToComponent("q-"+num);
@@ -525,6 +613,114 @@ void SAXS::calculate_cpu(vector<Vector> &deriv)
   }
 }
 
+void SAXS::calculate_histogram(vector<Vector> &deriv)
+{
+  const unsigned size = getNumberOfAtoms();
+  const unsigned numq = q_list.size();
+
+  unsigned stride = comm.Get_size();
+  unsigned rank   = comm.Get_rank();
+  if(serial) {
+    stride = 1;
+    rank   = 0;
+  }
+
+  // the largest distance is bound by the diagonal of the box enclosing the atoms
+  Vector lo=getPosition(0), hi=getPosition(0);
+  for(unsigned i=1; i<size; i++) {
+    const Vector & p=getPosition(i);
+    for(unsigned c=0; c<3; c++) {
+      lo[c]=std::min(lo[c],p[c]);
+      hi[c]=std::max(hi[c],p[c]);
+    }
+  }
+  const double invwidth=1./histo_width;
+  const unsigned nbins=static_cast<unsigned>((hi-lo).modulo()*invwidth)+2;
+
+  // sinc and its first two derivatives with respect to r at the bin centers
+  vector<double> sinc(nbins*numq), dsinc(nbins*numq), d2sinc(nbins*numq);
+  for(unsigned b=0; b<nbins; b++) {
+    for(unsigned k=0; k<numq; k++) {
+      const double q=q_list[k];
+      const double x=q*b*histo_width;
+      double s=1., ds=0., d2s=-1./3.;
+      if(b>0) {
+        s=std::sin(x)/x;
+        ds=(std::cos(x)-s)/x;
+        d2s=-s-2.*ds/x;
+      }
+      sinc[b*numq+k]=s;
+      dsinc[b*numq+k]=q*ds;
+      d2sinc[b*numq+k]=q*q*d2s;
+    }
+  }
+
+  // histograms of the products of form factors (h0) and of their products with the
+  // distance from the bin center (h1), so that the intensity is sum(sinc*h0+dsinc*h1)
+  vector<double> h0(nbins*numq,0.), h1(nbins*numq,0.);
+  vector<Vector> dsum(numq*size);
+  unsigned nt=OpenMP::getNumThreads();
+  #pragma omp parallel num_threads(nt)
+  {
+    // derivatives are stored as [atom*numq+k]
+    std::vector<Vector> omp_deriv(dsum.size());
+    std::vector<double> omp_h0(h0.size(),0.), omp_h1(h1.size(),0.);
+    std::vector<Vector> di(numq);
+    #pragma omp for schedule(dynamic) nowait
+    for (unsigned i=rank; i<size; i+=stride) {
+      const Vector posi=getPosition(i);
+      const double* ffi=&FF_flat[i*numq];
+      for(unsigned k=0; k<numq; k++) di[k].zero();
+      for (unsigned j=i+1; j<size; j++) {
+        const Vector c_distances=delta(posi,getPosition(j));
+        const double m_distances=c_distances.modulo();
+        const Vector u=c_distances/m_distances;
+        const unsigned b=static_cast<unsigned>(m_distances*invwidth+0.5);
+        const double shift=m_distances-b*histo_width;
+        const double* ffj=&FF_flat[j*numq];
+        double* b0=&omp_h0[b*numq];
+        double* b1=&omp_h1[b*numq];
+        const double* t1=&dsinc[b*numq];
+        const double* t2=&d2sinc[b*numq];
+        Vector* dj=&omp_deriv[j*numq];
+        for(unsigned k=0; k<numq; k++) {
+          const double FFF=ffi[k]*ffj[k];
+          b0[k]+=FFF;
+          b1[k]+=FFF*shift;
+          const Vector dd=u*(FFF*(t1[k]+shift*t2[k]));
+          di[k]-=dd;
+          dj[k]+=dd;
+        }
+      }
+      for(unsigned k=0; k<numq; k++) omp_deriv[i*numq+k]+=di[k];
+    }
+    #pragma omp critical
+    {
+      for(unsigned i=0; i<size; i++) for(unsigned k=0; k<numq; k++) dsum[k*size+i]+=omp_deriv[i*numq+k];
+      for(unsigned n=0; n<h0.size(); n++) {
+        h0[n]+=omp_h0[n];
+        h1[n]+=omp_h1[n];
+      }
+    }
+  }
+
+  if(!serial) {
+    comm.Sum(&dsum[0][0], 3*dsum.size());
+    comm.Sum(h0);
+    comm.Sum(h1);
+  }
+
+  for (unsigned k=0; k<numq; k++) {
+    double sum=FF_rank[k];
+    for(unsigned b=0; b<nbins; b++) sum+=sinc[b*numq+k]*h0[b*numq+k]+dsinc[b*numq+k]*h1[b*numq+k];
+    for(unsigned i=0; i<size; i++) deriv[k*size+i]=dsum[k*size+i];
+    string num; Tools::convert(k,num);
+    Value* val=getPntrToComponent("q-"+num);
+    val->set(sum);
+    if(getDoScore()) setCalcData(k, sum);
+  }
+}
+
 void SAXS::calculate()
 {
   if(pbc) makeWhole();
@@ -534,6 +730,7 @@ void SAXS::calculate()
 
   vector<Vector> deriv(numq*size);
   if(gpu) calculate_gpu(deriv);
+  else if(histo_width>0.) calculate_histogram(deriv);
   else calculate_cpu(deriv);
 
   if(getDoScore()) {
@@ -67,6 +67,7 @@
 #ifdef __PLUMED_HAS_ASMJIT
     #include "asmjit/asmjit.h"
 #endif
+#include <algorithm>
 #include <utility>
 
 namespace PLMD {
@@ -109,10 +110,19 @@ AsmJitRuntimePtr::~AsmJitRuntimePtr()
 CompiledExpression::CompiledExpression() : jitCode(NULL) {
 }
 
-CompiledExpression::CompiledExpression(const ParsedExpression& expression) : jitCode(NULL) {
-    ParsedExpression expr = expression.optimize(); // Just in case it wasn't already optimized.
+CompiledExpression::CompiledExpression(const ParsedExpression& expression) : CompiledExpression(vector<ParsedExpression>(1, expression)) {
+}
+
+CompiledExpression::CompiledExpression(const vector<ParsedExpression>& expressions) : jitCode(NULL) {
+    if (expressions.size() == 0)
+        throw Exception("CompiledExpression: at least one expression is needed");
     vector<pair<ExpressionTreeNode, int> > temps;
-    compileExpression(expr.getRootNode(), temps);
+    for (int i = 0; i < (int) expressions.size(); i++) {
+        ParsedExpression expr = expressions[i].optimize(); // Just in case it wasn't already optimized.
+        compileExpression(expr.getRootNode(), temps);
+        resultIndex.push_back(findTempIndex(expr.getRootNode(), temps));
+    }
+    results.resize(resultIndex.size());
     int maxArguments = 1;
     for (int i = 0; i < (int) operation.size(); i++)
         if (operation[i]->getNumArguments() > maxArguments)
@@ -136,6 +146,8 @@ CompiledExpression::CompiledExpression(const CompiledExpression& expression) : j
 CompiledExpression& CompiledExpression::operator=(const CompiledExpression& expression) {
     arguments = expression.arguments;
     target = expression.target;
+    resultIndex = expression.resultIndex;
+    results.resize(expression.results.size());
     variableIndices = expression.variableIndices;
     variableNames = expression.variableNames;
     workspace.resize(expression.workspace.size());
@@ -252,7 +264,168 @@ double CompiledExpression::evaluate() const {
             workspace[target[step]] = operation[step]->evaluate(&argValues[0], dummyVariables);
         }
     }
-    return workspace[workspace.size()-1];
+    if (resultIndex.size() > 1)
+        for (int i = 0; i < (int) resultIndex.size(); i++)
+            results[i] = workspace[resultIndex[i]];
+    return workspace[resultIndex[0]];
+}
+
+const vector<double>& CompiledExpression::evaluateAll() const {
+    // With more than one expression, evaluate() also stores all the results.
+    
+    double value = evaluate();
+    if (resultIndex.size() == 1)
+        results[0] = value;
+    return results;
+}
+
+void CompiledExpression::evaluateArrays(int n, const double* const* variableValues, double* const* resultValues) const {
+    // The workspace holds blockSize values for each temporary.
+    
+    const int blockSize = 64;
+    blockWorkspace.resize(blockSize*workspace.size());
+    vector<int> args;
+    for (int start = 0; start < n; start += blockSize) {
+        const int size = min(blockSize, n-start);
+        
+        // Copy the values of the variables.
+        
+        int var = 0;
+        for (set<string>::const_iterator iter = variableNames.begin(); iter != variableNames.end(); ++iter, ++var) {
+            double* dest = &blockWorkspace[blockSize*variableIndices.find(*iter)->second];
+            const double* src = variableValues[var]+start;
+            for (int i = 0; i < size; i++)
+                dest[i] = src[i];
+        }
+        
+        // Loop over the operations and apply each one to the whole block.
+        
+        for (int step = 0; step < (int) operation.size(); step++) {
+            const Operation& op = *operation[step];
+            args = arguments[step];
+            if (args.size() == 1) {
+                // One or more sequential arguments.  Fill out the list.
+                
+                for (int i = 1; i < op.getNumArguments(); i++)
+                    args.push_back(args[0]+i);
+            }
+            double* result = &blockWorkspace[blockSize*target[step]];
+            const double* arg0 = &blockWorkspace[blockSize*args[0]];
+            const double* arg1 = (args.size() > 1 ? &blockWorkspace[blockSize*args[1]] : NULL);
+            switch (op.getId()) {
+                case Operation::CONSTANT: {
+                    const double value = dynamic_cast<const Operation::Constant&>(op).getValue();
+                    for (int i = 0; i < size; i++)
+                        result[i] = value;
+                    break;
+                }
+                case Operation::ADD:
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]+arg1[i];
+                    break;
+                case Operation::SUBTRACT:
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]-arg1[i];
+                    break;
+                case Operation::MULTIPLY:
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]*arg1[i];
+                    break;
+                case Operation::DIVIDE:
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]/arg1[i];
+                    break;
+                case Operation::NEGATE:
+                    for (int i = 0; i < size; i++)
+                        result[i] = -arg0[i];
+                    break;
+                case Operation::SQRT:
+                    for (int i = 0; i < size; i++)
+                        result[i] = std::sqrt(arg0[i]);
+                    break;
+                case Operation::EXP:
+                    for (int i = 0; i < size; i++)
+                        result[i] = std::exp(arg0[i]);
+                    break;
+                case Operation::LOG:
+                    for (int i = 0; i < size; i++)
+                        result[i] = std::log(arg0[i]);
+                    break;
+                case Operation::STEP:
+                    for (int i = 0; i < size; i++)
+                        result[i] = (arg0[i] >= 0.0 ? 1.0 : 0.0);
+                    break;
+                case Operation::SQUARE:
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]*arg0[i];
+                    break;
+                case Operation::CUBE:
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]*arg0[i]*arg0[i];
+                    break;
+                case Operation::RECIPROCAL:
+                    for (int i = 0; i < size; i++)
+                        result[i] = 1.0/arg0[i];
+                    break;
+                case Operation::ADD_CONSTANT: {
+                    const double value = dynamic_cast<const Operation::AddConstant&>(op).getValue();
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]+value;
+                    break;
+                }
+                case Operation::MULTIPLY_CONSTANT: {
+                    const double value = dynamic_cast<const Operation::MultiplyConstant&>(op).getValue();
+                    for (int i = 0; i < size; i++)
+                        result[i] = arg0[i]*value;
+                    break;
+                }
+                case Operation::POWER_CONSTANT: {
+                    const double value = dynamic_cast<const Operation::PowerConstant&>(op).getValue();
+                    int exponent = (int) value;
+                    if (exponent == value) {
+                        // Same repeated multiplication as PowerConstant::evaluate(), one bit of the exponent at a time.
+                        
+                        double base[blockSize];
+                        for (int i = 0; i < size; i++) {
+                            base[i] = (exponent < 0 ? 1.0/arg0[i] : arg0[i]);
+                            result[i] = 1.0;
+                        }
+                        if (exponent < 0)
+                            exponent = -exponent;
+                        while (exponent != 0) {
+                            if ((exponent&1) == 1)
+                                for (int i = 0; i < size; i++)
+                                    result[i] *= base[i];
+                            for (int i = 0; i < size; i++)
+                                base[i] *= base[i];
+                            exponent = exponent>>1;
+                        }
+                    }
+                    else
+                        for (int i = 0; i < size; i++)
+                            result[i] = std::pow(arg0[i], value);
+                    break;
+                }
+                default:
+                    // Evaluate the operation one point at a time.
+                    
+                    for (int i = 0; i < size; i++) {
+                        for (int j = 0; j < (int) args.size(); j++)
+                            argValues[j] = blockWorkspace[blockSize*args[j]+i];
+                        result[i] = op.evaluate(&argValues[0], dummyVariables);
+                    }
+            }
+        }
+        
+        // Copy the results.
+        
+        for (int j = 0; j < (int) resultIndex.size(); j++) {
+            const double* src = &blockWorkspace[blockSize*resultIndex[j]];
+            double* dest = resultValues[j]+start;
+            for (int i = 0; i < size; i++)
+                dest[i] = src[i];
+        }
+    }
 }
 
 #ifdef __PLUMED_HAS_ASMJIT
@@ -460,7 +633,15 @@ void CompiledExpression::generateJitCode() {
                 call->setRet(0, workspaceVar[target[step]]);
         }
     }
-    c.ret(workspaceVar[workspace.size()-1]);
+    if (resultIndex.size() > 1) {
+        // Store the values of all the expressions.
+        
+        X86Gp resultsPointer = c.newIntPtr();
+        c.mov(resultsPointer, imm_ptr(&results[0]));
+        for (int i = 0; i < (int) resultIndex.size(); i++)
+            c.movsd(x86::ptr(resultsPointer, 8*i, 0), workspaceVar[resultIndex[i]]);
+    }
+    c.ret(workspaceVar[resultIndex[0]]);
     c.endFunc();
     c.finalize();
     typedef double (*Func0)(void);
@@ -115,6 +115,12 @@ class ParsedExpression;
 class LEPTON_EXPORT CompiledExpression {
 public:
     CompiledExpression();
+    /**
+     * Create a CompiledExpression that evaluates several expressions in a single pass.  Subexpressions that appear
+     * in more than one of them (as it typically happens for a function and its derivatives) are only computed once.
+     * Call evaluateAll() to get the values of all the expressions; evaluate() returns the value of the first one.
+     */
+    explicit CompiledExpression(const std::vector<ParsedExpression>& expressions);
     CompiledExpression(const CompiledExpression& expression);
     ~CompiledExpression();
     CompiledExpression& operator=(const CompiledExpression& expression);
@@ -137,6 +143,20 @@ public:
      * Evaluate the expression.  The values of all variables should have been set before calling this.
      */
     double evaluate() const;
+    /**
+     * Evaluate all the expressions this object was created from.  The values of all variables should have been set
+     * before calling this.  The returned vector contains the value of each expression, in the order they were
+     * passed to the constructor, and is overwritten by the next call.
+     */
+    const std::vector<double>& evaluateAll() const;
+    /**
+     * Evaluate all the expressions for n different values of the variables.  variableValues[i] should point to
+     * an array with the n values of the i-th variable, in the order returned by getVariables().  resultValues[j]
+     * should point to an array of size n, where the values of the j-th expression are stored.  Points are processed
+     * in blocks, applying each operation to all the points of a block at once, so that the loops can be vectorized
+     * by the compiler.  The results are identical to those obtained calling evaluateAll() on each point.
+     */
+    void evaluateArrays(int n, const double* const* variableValues, double* const* resultValues) const;
 private:
     friend class ParsedExpression;
     CompiledExpression(const ParsedExpression& expression);
@@ -146,11 +166,14 @@ private:
     std::vector<std::pair<double*, double*> > variablesToCopy;
     std::vector<std::vector<int> > arguments;
     std::vector<int> target;
+    std::vector<int> resultIndex;
+    mutable std::vector<double> results;
     std::vector<Operation*> operation;
     std::map<std::string, int> variableIndices;
     std::set<std::string> variableNames;
     mutable std::vector<double> workspace;
     mutable std::vector<double> argValues;
+    mutable std::vector<double> blockWorkspace;
     std::map<std::string, double> dummyVariables;
     void* jitCode;
     void generateJitCode();
@@ -404,6 +404,7 @@ class LogMFD : public Bias {
 
 public:
   static void registerKeywords(Keywords& keys);
+  bool dependsOnPreviousSteps()const override {return true;}
 
   explicit LogMFD(const ActionOptions&);
   void calculate();
@@ -102,6 +102,7 @@ private:
   std::vector<Direction> pdisplacements;
 public:
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return true;}
   explicit AdaptivePath(const ActionOptions&);
   void calculate() override;
   void performTask( const unsigned&, const unsigned&, MultiValue& ) const override;
@@ -95,6 +95,11 @@ public:
    */
   void prepare();
 
+  /**
+   * The optimal solution is updated at every step starting from the previous one.
+   */
+  bool dependsOnPreviousSteps() const override { return true; }
+
   /**
    * Score a ligand-protein configuration.
    *
@@ -132,6 +132,11 @@ public:
    */
   void calculate();
 
+  /**
+   * The biasing direction and the pulling are updated at every step.
+   */
+  bool dependsOnPreviousSteps() const override { return true; }
+
 private:
   /**
    * Biased collective variable with Cartesian components, i.e., position,
@@ -0,0 +1,163 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2020 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "BucketIndex.h"
+#include "Exception.h"
+#include <algorithm>
+#include <cmath>
+
+namespace PLMD {
+
+BucketIndex::BucketIndex(const std::vector<bool> & periodic,const std::vector<double> & pmin,const std::vector<double> & pmax):
+  ndim(std::min(unsigned(periodic.size()),maxdim)),
+  periodic(periodic),
+  pmin(pmin),
+  period(pmax.size())
+{
+  plumed_assert(pmin.size()==periodic.size() && pmax.size()==periodic.size());
+  for(unsigned i=0; i<period.size(); i++) period[i]=pmax[i]-pmin[i];
+}
+
+long BucketIndex::getBucket(unsigned i,double x) const {
+  long b=static_cast<long>(std::floor((x-pmin[i])/width[i]));
+  if(periodic[i]) {
+    b%=nperiodic[i];
+    if(b<0) b+=nperiodic[i];
+  }
+  return b;
+}
+
+void BucketIndex::setWidth(const double* halfwidth) {
+  width.resize(ndim);
+  nperiodic.assign(ndim,1);
+  for(unsigned i=0; i<ndim; i++) {
+    width[i]=2.0*halfwidth[i];
+    if(periodic[i]) {
+      nperiodic[i]=std::max(1L,static_cast<long>(std::floor(period[i]/width[i])));
+      width[i]=period[i]/nperiodic[i];
+    }
+  }
+}
+
+bool BucketIndex::assign(unsigned id,const double* center,const double* halfwidth) {
+// range of buckets overlapped by the box along each direction.
+// the box is slightly enlarged to be robust with respect to rounding errors
+  std::array<long,maxdim> first,n;
+  for(unsigned i=0; i<maxdim; i++) {
+    first[i]=0;
+    n[i]=1;
+  }
+  for(unsigned i=0; i<ndim; i++) {
+    const double h=halfwidth[i]*(1.0+1e-8);
+    if(periodic[i] && (!std::isfinite(h) || 2.0*h>=period[i])) {
+      n[i]=nperiodic[i];
+      continue;
+    }
+    first[i]=static_cast<long>(std::floor((center[i]-h-pmin[i])/width[i]));
+    n[i]=static_cast<long>(std::floor((center[i]+h-pmin[i])/width[i]))-first[i]+1;
+    if(periodic[i]) n[i]=std::min(n[i],nperiodic[i]);
+  }
+// boxes much larger than the buckets are cheaper to store separately
+  if(n[0]>maxbuckets || n[1]>maxbuckets || n[2]>maxbuckets || n[0]*n[1]*n[2]>maxbuckets) return false;
+  Key key;
+  for(long i0=0; i0<n[0]; i0++) for(long i1=0; i1<n[1]; i1++) for(long i2=0; i2<n[2]; i2++) {
+        key[0]=first[0]+i0;
+        key[1]=first[1]+i1;
+        key[2]=first[2]+i2;
+        for(unsigned i=0; i<ndim; i++) if(periodic[i]) {
+            key[i]%=nperiodic[i];
+            if(key[i]<0) key[i]+=nperiodic[i];
+          }
+        buckets[key].push_back(id);
+      }
+  return true;
+}
+
+void BucketIndex::add(unsigned id,const std::vector<double> & center,const std::vector<double> & halfwidth) {
+  plumed_dbg_assert(center.size()==periodic.size() && halfwidth.size()==periodic.size());
+// boxes with an undefined size, or infinite along a non periodic direction, cannot be assigned to buckets
+  for(unsigned i=0; i<ndim; i++) {
+    if(!(halfwidth[i]>0.0) || !std::isfinite(center[i]) || (!periodic[i] && !std::isfinite(halfwidth[i]))) {
+      always.push_back(id);
+      return;
+    }
+  }
+  if(width.empty()) {
+// the first valid box sets the size of the buckets
+    setWidth(halfwidth.data());
+  } else {
+// boxes spanning more than two buckets make the buckets larger. Since their size
+// is then at least doubled, boxes are assigned again only a few times
+    bool grow=false;
+    std::array<double,maxdim> h;
+    for(unsigned i=0; i<ndim; i++) {
+      h[i]=0.5*width[i];
+      if(halfwidth[i]>width[i] && !(periodic[i] && nperiodic[i]==1)) {
+        h[i]=halfwidth[i];
+        grow=true;
+      }
+    }
+    if(grow) {
+      setWidth(h.data());
+      buckets.clear();
+      for(unsigned k=0; k<stored_id.size(); k++) {
+        const bool ok=assign(stored_id[k],&stored_center[k*ndim],&stored_halfwidth[k*ndim]);
+        plumed_assert(ok);
+      }
+    }
+  }
+  if(!assign(id,center.data(),halfwidth.data())) {
+    always.push_back(id);
+    return;
+  }
+  stored_id.push_back(id);
+  stored_center.insert(stored_center.end(),center.begin(),center.begin()+ndim);
+  stored_halfwidth.insert(stored_halfwidth.end(),halfwidth.begin(),halfwidth.begin()+ndim);
+}
+
+const std::vector<unsigned> & BucketIndex::getCandidates(const std::vector<double> & x,std::vector<unsigned> & ids) const {
+  plumed_dbg_assert(x.size()==periodic.size());
+  static const std::vector<unsigned> empty;
+  const std::vector<unsigned>* bucket=&empty;
+  if(!width.empty()) {
+    Key key;
+    for(unsigned i=0; i<maxdim; i++) key[i]=(i<ndim?getBucket(i,x[i]):0);
+    const auto it=buckets.find(key);
+    if(it!=buckets.end()) bucket=&it->second;
+  }
+// the content of the bucket is returned directly, unless boxes that are always returned should be added
+  if(always.empty()) return *bucket;
+  ids.resize(bucket->size()+always.size());
+  std::merge(bucket->begin(),bucket->end(),always.begin(),always.end(),ids.begin());
+  return ids;
+}
+
+void BucketIndex::clear() {
+  width.clear();
+  nperiodic.clear();
+  buckets.clear();
+  always.clear();
+  stored_id.clear();
+  stored_center.clear();
+  stored_halfwidth.clear();
+}
+
+}
@@ -0,0 +1,97 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2020 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_BucketIndex_h
+#define __PLUMED_tools_BucketIndex_h
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstddef>
+
+namespace PLMD {
+
+/// \ingroup TOOLBOX
+/// A class for finding quickly which of many boxes contain a given point.
+///
+/// Space is divided in buckets of fixed size, and each box is stored in all the buckets it overlaps.
+/// The bucket size follows the largest box added so far (e.g. the support of metadynamics hills,
+/// also when their width is adaptive): when a box spans more than a few buckets the size is increased
+/// and the boxes are assigned again, so that this only happens a logarithmic number of times.
+/// Only the first maxdim dimensions are used to assign the buckets, so that
+/// the boxes returned by getCandidates() might not contain the point along the other dimensions.
+/// Boxes with infinite or invalid size are always returned.
+class BucketIndex {
+public:
+/// Maximum number of dimensions used to assign the buckets
+  static const unsigned maxdim=3;
+/// Maximum number of buckets overlapped by a single box
+  static const long maxbuckets=4096;
+private:
+  typedef std::array<long,maxdim> Key;
+  struct KeyHash {
+    std::size_t operator()(const Key & k) const {
+      std::size_t h=0;
+      for(unsigned i=0; i<maxdim; i++) h=h*1000003u+static_cast<std::size_t>(k[i]);
+      return h;
+    }
+  };
+/// Number of dimensions used to assign the buckets
+  unsigned ndim;
+/// Periodicity of each dimension
+  std::vector<bool> periodic;
+/// Lower boundary and period of periodic dimensions
+  std::vector<double> pmin,period;
+/// Size of the buckets, empty if not set yet
+  std::vector<double> width;
+/// Number of buckets along periodic dimensions
+  std::vector<long> nperiodic;
+/// Boxes stored in each bucket
+  std::unordered_map<Key,std::vector<unsigned>,KeyHash> buckets;
+/// Boxes that should always be returned
+  std::vector<unsigned> always;
+/// Identifiers, centers and half widths (along the first ndim dimensions) of the boxes stored in the buckets,
+/// used to assign them again when the size of the buckets changes
+  std::vector<unsigned> stored_id;
+  std::vector<double> stored_center,stored_halfwidth;
+/// Bucket containing a single coordinate along dimension i
+  long getBucket(unsigned i,double x) const;
+/// Set the size of the buckets from the half width of the largest box
+  void setWidth(const double* halfwidth);
+/// Store a box in the buckets. Returns false if it is too large and should always be returned
+  bool assign(unsigned id,const double* center,const double* halfwidth);
+public:
+/// Create an index. pmin and pmax are only used for periodic dimensions
+  BucketIndex(const std::vector<bool> & periodic,const std::vector<double> & pmin,const std::vector<double> & pmax);
+/// Add the box with identifier id, defined by its center and its half width along each dimension.
+/// Identifiers should be added in increasing order
+  void add(unsigned id,const std::vector<double> & center,const std::vector<double> & halfwidth);
+/// Get the identifiers of the boxes that might contain x, in increasing order.
+/// The returned vector is either the content of a bucket or ids, filled when boxes from a bucket
+/// and boxes that are always returned have to be merged.
+  const std::vector<unsigned> & getCandidates(const std::vector<double> & x,std::vector<unsigned> & ids) const;
+/// Remove all the boxes
+  void clear();
+};
+
+}
+
+#endif
@@ -35,11 +35,114 @@
 #include <sstream>
 #include <cstdio>
 #include <cfloat>
+#include <limits>
 #include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <unistd.h>
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES>0
+#define __PLUMED_GRID_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+#endif
 
 using namespace std;
 namespace PLMD {
 
+bool BinaryGridHeader::isLittleEndian() {
+  const uint16_t one=1;
+  unsigned char c;
+  std::memcpy(&c,&one,1);
+  return c==1;
+}
+
+bool BinaryGridHeader::isBinaryFile(const std::string&path) {
+  if(Tools::extension(path)=="gz") return false;
+  FILE* fp=std::fopen(path.c_str(),"rb");
+  if(!fp) return false;
+  const std::string magic="PLUMED_BINARY_GRID ";
+  std::vector<char> buffer(magic.length());
+  const size_t n=std::fread(buffer.data(),1,buffer.size(),fp);
+  std::fclose(fp);
+  return n==magic.length() && std::string(buffer.data(),n)==magic;
+}
+
+void BinaryGridHeader::write(OFile&ofile) const {
+  std::string h="PLUMED_BINARY_GRID 1\n";
+  h+=std::string("ENDIAN ")+(littleEndian?"little":"big")+"\n";
+  h+="VARIABLES "+std::to_string(names.size())+"\n";
+  for(unsigned i=0; i<names.size(); ++i)
+    h+="VARIABLE "+names[i]+" "+min[i]+" "+max[i]+" "+std::to_string(nbins[i])+" "+(periodic[i]?"true":"false")+"\n";
+  h+="FIELDS "+std::to_string(fields.size());
+  for(const auto & f : fields) h+=" "+f;
+  h+="\n";
+  for(const auto & c : constants) h+="SET "+c.first+" "+c.second+"\n";
+  h+="POINTS "+std::to_string(npoints)+" "+(sparse?"sparse":"dense")+"\n";
+// pad so that data are aligned to 8 bytes
+  h+="END";
+  while((h.length()+1)%8!=0) h+=" ";
+  h+="\n";
+  ofile.writeBinary(h.c_str(),h.length());
+}
+
+static bool readBinaryGridHeaderLine(FILE*fp,std::string&line) {
+  line.clear();
+  int c;
+  while((c=std::fgetc(fp))!=EOF) {
+    if(c=='\n') return true;
+    line+=static_cast<char>(c);
+  }
+  return line.length()>0;
+}
+
+bool BinaryGridHeader::read(FILE*fp,const std::string&path) {
+  std::string line;
+  if(!readBinaryGridHeaderLine(fp,line)) return false;
+  std::vector<std::string> words=Tools::getWords(line);
+  plumed_massert(words.size()==2 && words[0]=="PLUMED_BINARY_GRID","file " + path + " does not contain a binary grid");
+  plumed_massert(words[1]=="1","file " + path + ": unsupported version of binary grid format " + words[1]);
+  names.clear(); min.clear(); max.clear(); nbins.clear(); periodic.clear();
+  fields.clear(); constants.clear();
+  npoints=0; sparse=false; littleEndian=true;
+  unsigned nvar=0;
+  while(true) {
+    plumed_massert(readBinaryGridHeaderLine(fp,line),"file " + path + ": truncated binary grid header");
+    words=Tools::getWords(line);
+    if(words.empty()) continue;
+    bool ok=true;
+    if(words[0]=="END") break;
+    else if(words[0]=="ENDIAN" && words.size()==2) littleEndian=(words[1]=="little");
+    else if(words[0]=="VARIABLES" && words.size()==2) ok=Tools::convert(words[1],nvar);
+    else if(words[0]=="VARIABLE" && words.size()==6) {
+      unsigned n=0;
+      ok=Tools::convert(words[4],n);
+      names.push_back(words[1]); min.push_back(words[2]); max.push_back(words[3]);
+      nbins.push_back(n); periodic.push_back(words[5]=="true");
+    } else if(words[0]=="FIELDS" && words.size()>=2) {
+      unsigned n=0;
+      ok=Tools::convert(words[1],n) && words.size()==n+2;
+      fields.assign(words.begin()+2,words.end());
+    } else if(words[0]=="SET" && words.size()==3) constants.push_back(std::pair<std::string,std::string>(words[1],words[2]));
+    else if(words[0]=="POINTS" && words.size()==3) {
+      long int n=0;
+      ok=Tools::convert(words[1],n) && n>=0;
+      npoints=n; sparse=(words[2]=="sparse");
+    } else ok=false;
+    plumed_massert(ok,"file " + path + ": cannot parse line of binary grid header: " + line);
+  }
+  plumed_massert(names.size()==nvar,"file " + path + ": wrong number of variables in binary grid header");
+  return true;
+}
+
+uint64_t BinaryGridHeader::dataSize() const {
+  return (sparse?npoints*sizeof(uint64_t):0) + npoints*fields.size()*sizeof(double);
+}
+
 constexpr size_t GridBase::maxdim;
 
 GridBase::GridBase(const std::string& funcl, const std::vector<Value*> & args, const vector<std::string> & gmin,
@@ -498,12 +601,56 @@ void Grid::clear() {
   if(usederiv_) der_.assign(maxsize_*dimension_,0.0);
 }
 
-void Grid::writeToFile(OFile& ofile) {
+bool GridBase::useBinaryFormat(const std::string&path) {
+  return Tools::extension(path)=="bin";
+}
+
+void GridBase::writeBinaryToFile(OFile& ofile,const std::vector<index_t>*indexes) {
+  BinaryGridHeader header;
+  header.names=argnames;
+  header.min=str_min_;
+  header.max=str_max_;
+  header.nbins=nbin_;
+  header.periodic=pbc_;
+  header.fields.push_back(funcname);
+  if(usederiv_) for(unsigned j=0; j<dimension_; ++j) header.fields.push_back("der_" + argnames[j]);
+  header.sparse=(indexes!=nullptr);
+  header.npoints=(indexes?indexes->size():maxsize_);
+  header.littleEndian=BinaryGridHeader::isLittleEndian();
+  header.write(ofile);
+  if(indexes) {
+    vector<uint64_t> ii(indexes->begin(),indexes->end());
+    if(!ii.empty()) ofile.writeBinary(ii.data(),ii.size()*sizeof(uint64_t));
+  }
+// data are written in chunks to limit memory usage
+  const unsigned stride=header.fields.size();
+  const index_t chunk=4096;
+  vector<double> buffer(chunk*stride);
+  vector<double> der(dimension_);
+  for(index_t i0=0; i0<header.npoints; i0+=chunk) {
+    const index_t n=std::min(chunk,static_cast<index_t>(header.npoints)-i0);
+    for(index_t i=0; i<n; ++i) {
+      const index_t index=(indexes?(*indexes)[i0+i]:i0+i);
+      double* p=&buffer[i*stride];
+      if(usederiv_) {
+        p[0]=getValueAndDerivatives(index,der);
+        for(unsigned j=0; j<dimension_; ++j) p[j+1]=der[j];
+      } else p[0]=getValue(index);
+    }
+    ofile.writeBinary(buffer.data(),n*stride*sizeof(double));
+  }
+}
+
+void GridBase::writeDenseToFile(OFile& ofile) {
+  if(useBinaryFormat(ofile.getPath())) {
+    writeBinaryToFile(ofile);
+    return;
+  }
   vector<double> xx(dimension_);
   vector<double> der(dimension_);
   double f;
   writeHeader(ofile);
-  for(index_t i=0; i<getSize(); ++i) {
+  for(index_t i=0; i<maxsize_; ++i) {
     xx=getPoint(i);
     if(usederiv_) {f=getValueAndDerivatives(i,der);}
     else {f=getValue(i);}
@@ -522,6 +669,10 @@ void Grid::writeToFile(OFile& ofile) {
   }
 }
 
+void Grid::writeToFile(OFile& ofile) {
+  writeDenseToFile(ofile);
+}
+
 void GridBase::writeCubeFile(OFile& ofile, const double& lunit) {
   plumed_assert( dimension_==3 );
   ofile.printf("PLUMED CUBE FILE\n");
@@ -562,8 +713,97 @@ std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::
   return grid;
 }
 
-std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, bool dosparse, bool dospline, bool doder)
+// read the last grid stored in a binary file
+static std::unique_ptr<GridBase> createFromBinaryFile(const std::string& funcl, const std::vector<Value*> & args, const std::string& path,
+    bool dosparse, bool dospline, bool doder, bool readonly)
+{
+  std::unique_ptr<FILE,int(*)(FILE*)> fp(std::fopen(path.c_str(),"rb"),&std::fclose);
+  plumed_massert(fp,"cannot open file " + path);
+  BinaryGridHeader header,next;
+  plumed_massert(header.read(fp.get(),path),"file " + path + " does not contain a binary grid");
+  long offset=std::ftell(fp.get());
+// several grids might be stored one after the other, we use the last one
+  while(std::fseek(fp.get(),offset+header.dataSize(),SEEK_SET)==0 && next.read(fp.get(),path)) {
+    header=next;
+    offset=std::ftell(fp.get());
+  }
+  plumed_massert(std::fseek(fp.get(),0,SEEK_END)==0 && std::ftell(fp.get())>=static_cast<long>(offset+header.dataSize()),
+                 "file " + path + ": truncated binary grid");
+
+  unsigned nvar=args.size();
+  plumed_massert(header.littleEndian==BinaryGridHeader::isLittleEndian(),"file " + path + " was written on a machine with different endianness");
+  plumed_massert(header.names.size()==nvar,"number of variables in grid file " + path + " does not match number of arguments");
+  std::vector<std::string> gmin(nvar),gmax(nvar);
+  std::vector<unsigned> gbin(nvar);
+  GridBase::index_t ntot=1;
+  for(unsigned i=0; i<nvar; ++i) {
+    if(header.names[i]!=args[i]->getName()) {
+      for(unsigned k=0; k<nvar; ++k) if(header.names[i]==args[k]->getName()) plumed_merror("arguments in input are not in same order as in grid file");
+      plumed_merror("no variable labelled " + args[i]->getName() + " in grid file " + path);
+    }
+    gmin[i]=header.min[i];
+    gmax[i]=header.max[i];
+    plumed_assert( header.nbins[i]>0 );
+    ntot*=header.nbins[i];
+    if( args[i]->isPeriodic() ) {
+      plumed_massert( header.periodic[i], "input value is periodic but grid is not");
+      std::string pmin, pmax;
+      args[i]->getDomain( pmin, pmax ); gbin[i]=header.nbins[i];
+      if( pmin!=gmin[i] || pmax!=gmax[i] ) plumed_merror("mismatch between grid boundaries and periods of values");
+    } else {
+      gbin[i]=header.nbins[i]-1;  // as in text files, the header indicates one more bin when data is not periodic
+      plumed_massert( !header.periodic[i], "input value is not periodic but grid is");
+    }
+  }
+  plumed_massert(header.sparse || header.npoints==ntot,"file " + path + ": wrong number of points in dense binary grid");
+
+  auto ifield=[&](const std::string&name) {
+    auto it=std::find(header.fields.begin(),header.fields.end(),name);
+    return (it==header.fields.end()?-1:static_cast<int>(it-header.fields.begin()));
+  };
+  const int ivalue=ifield(funcl);
+  plumed_massert( ivalue>=0, "no column labelled " + funcl + " in in grid input");
+  std::vector<int> ider(nvar);
+  for(unsigned i=0; i<nvar; ++i) {
+    ider[i]=ifield("der_" + args[i]->getName());
+    if( doder && ider[i]<0 ) plumed_merror("missing derivatives from grid file");
+  }
+
+  if(readonly && !dosparse && !header.sparse && MappedGrid::isAvailable())
+    return std::unique_ptr<GridBase>(new MappedGrid(funcl,args,gmin,gmax,gbin,dospline,doder,path,offset,header));
+
+  std::unique_ptr<GridBase> grid;
+  if(!dosparse) {grid.reset(new Grid(funcl,args,gmin,gmax,gbin,dospline,doder));}
+  else {grid.reset(new SparseGrid(funcl,args,gmin,gmax,gbin,dospline,doder));}
+
+  plumed_massert(std::fseek(fp.get(),offset,SEEK_SET)==0,"file " + path + ": cannot read binary grid");
+  std::vector<uint64_t> indexes;
+  if(header.sparse) {
+    indexes.resize(header.npoints);
+    plumed_massert(std::fread(indexes.data(),sizeof(uint64_t),indexes.size(),fp.get())==indexes.size(),"file " + path + ": truncated binary grid");
+  }
+  const unsigned nfields=header.fields.size();
+  const uint64_t chunk=4096;
+  std::vector<double> buffer(chunk*nfields),dder(nvar);
+  for(uint64_t i0=0; i0<header.npoints; i0+=chunk) {
+    const uint64_t n=std::min(chunk,header.npoints-i0);
+    plumed_massert(std::fread(buffer.data(),sizeof(double),n*nfields,fp.get())==n*nfields,"file " + path + ": truncated binary grid");
+    for(uint64_t i=0; i<n; ++i) {
+      const uint64_t index=(header.sparse?indexes[i0+i]:i0+i);
+      plumed_massert(index<ntot,"file " + path + ": index out of range in binary grid");
+      const double* p=&buffer[i*nfields];
+      if(doder) {
+        for(unsigned j=0; j<nvar; ++j) dder[j]=p[ider[j]];
+        grid->setValueAndDerivatives(index,p[ivalue],dder);
+      } else grid->setValue(index,p[ivalue]);
+    }
+  }
+  return grid;
+}
+
+std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, bool dosparse, bool dospline, bool doder, bool readonly)
 {
+  if(BinaryGridHeader::isBinaryFile(ifile.getPath())) return createFromBinaryFile(funcl,args,ifile.getPath(),dosparse,dospline,doder,readonly);
   std::unique_ptr<GridBase> grid;
   unsigned nvar=args.size(); bool hasder=false; std::string pstring;
   std::vector<int> gbin1(nvar); std::vector<unsigned> gbin(nvar);
@@ -632,7 +872,7 @@ double Grid::getMinValue() const {
 
 double Grid::getMaxValue() const {
   double maxval;
-  maxval=DBL_MIN;
+  maxval=-std::numeric_limits<double>::max();
   for(index_t i=0; i<grid_.size(); ++i) {
     if(grid_[i]>maxval)maxval=grid_[i];
   }
@@ -768,8 +1008,54 @@ void Grid::addValueAndDerivatives
   for(unsigned int i=0; i<dimension_; ++i) der_[index*dimension_+i]+=der[i];
 }
 
+// hash function for grid indexes:
+// consecutive indexes (or indexes differing by a stride) are spread over the table
+static inline Grid::index_t sparseGridHash(Grid::index_t index) {
+  uint64_t h=static_cast<uint64_t>(index)*UINT64_C(0x9E3779B97F4A7C15);
+  return static_cast<Grid::index_t>(h^(h>>32));
+}
+
+const Grid::index_t SparseGrid::emptyKey_;
+
+long long SparseGrid::findSlot(index_t index) const {
+  const index_t mask=keys_.size()-1;
+  for(index_t i=sparseGridHash(index)&mask;; i=(i+1)&mask) {
+    if(keys_[i]==index) return i;
+    if(keys_[i]==emptyKey_) return -1;
+  }
+}
+
+Grid::index_t SparseGrid::findOrCreateSlot(index_t index) {
+// keep the load factor below 1/2
+  if(2*(nfilled_+1)>keys_.size()) rehash();
+  const index_t mask=keys_.size()-1;
+  for(index_t i=sparseGridHash(index)&mask;; i=(i+1)&mask) {
+    if(keys_[i]==index) return i;
+    if(keys_[i]==emptyKey_) {
+      keys_[i]=index;
+      nfilled_++;
+      return i;
+    }
+  }
+}
+
+void SparseGrid::rehash() {
+  vector<index_t> oldkeys(2*keys_.size(),emptyKey_);
+  vector<double> olddata(oldkeys.size()*stride_,0.0);
+  oldkeys.swap(keys_);
+  olddata.swap(data_);
+  const index_t mask=keys_.size()-1;
+  for(index_t j=0; j<oldkeys.size(); ++j) {
+    if(oldkeys[j]==emptyKey_) continue;
+    index_t i=sparseGridHash(oldkeys[j])&mask;
+    while(keys_[i]!=emptyKey_) i=(i+1)&mask;
+    keys_[i]=oldkeys[j];
+    for(unsigned k=0; k<stride_; ++k) data_[i*stride_+k]=olddata[j*stride_+k];
+  }
+}
+
 Grid::index_t SparseGrid::getSize() const {
-  return map_.size();
+  return nfilled_;
 }
 
 Grid::index_t SparseGrid::getMaxSize() const {
@@ -778,57 +1064,66 @@ Grid::index_t SparseGrid::getMaxSize() const {
 
 double SparseGrid::getValue(index_t index)const {
   plumed_assert(index<maxsize_);
-  double value=0.0;
-  const auto it=map_.find(index);
-  if(it!=map_.end()) value=it->second;
-  return value;
+  const long long i=findSlot(index);
+  if(i<0) return 0.0;
+  return data_[i*stride_];
 }
 
 double SparseGrid::getValueAndDerivatives
 (index_t index, vector<double>& der)const {
   plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
-  double value=0.0;
-  for(unsigned int i=0; i<dimension_; ++i) der[i]=0.0;
-  const auto it=map_.find(index);
-  if(it!=map_.end()) value=it->second;
-  const auto itder=der_.find(index);
-  if(itder!=der_.end()) der=itder->second;
-  return value;
+  const long long i=findSlot(index);
+  if(i<0) {
+    for(unsigned int j=0; j<dimension_; ++j) der[j]=0.0;
+    return 0.0;
+  }
+  const double* p=&data_[i*stride_];
+  for(unsigned int j=0; j<dimension_; ++j) der[j]=p[j+1];
+  return p[0];
 }
 
 void SparseGrid::setValue(index_t index, double value) {
   plumed_assert(index<maxsize_ && !usederiv_);
-  map_[index]=value;
+  data_[findOrCreateSlot(index)*stride_]=value;
 }
 
 void SparseGrid::setValueAndDerivatives
 (index_t index, double value, vector<double>& der) {
   plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
-  map_[index]=value;
-  der_[index]=der;
+  double* p=&data_[findOrCreateSlot(index)*stride_];
+  p[0]=value;
+  for(unsigned int j=0; j<dimension_; ++j) p[j+1]=der[j];
 }
 
 void SparseGrid::addValue(index_t index, double value) {
   plumed_assert(index<maxsize_ && !usederiv_);
-  map_[index]+=value;
+  data_[findOrCreateSlot(index)*stride_]+=value;
 }
 
 void SparseGrid::addValueAndDerivatives
 (index_t index, double value, vector<double>& der) {
   plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
-  map_[index]+=value;
-  der_[index].resize(dimension_);
-  for(unsigned int i=0; i<dimension_; ++i) der_[index][i]+=der[i];
+  double* p=&data_[findOrCreateSlot(index)*stride_];
+  p[0]+=value;
+  for(unsigned int j=0; j<dimension_; ++j) p[j+1]+=der[j];
 }
 
 void SparseGrid::writeToFile(OFile& ofile) {
+// points are written in increasing index order, as when they were stored in a std::map
+  vector<index_t> sorted;
+  sorted.reserve(nfilled_);
+  for(const auto & k : keys_) if(k!=emptyKey_) sorted.push_back(k);
+  std::sort(sorted.begin(),sorted.end());
+  if(useBinaryFormat(ofile.getPath())) {
+    writeBinaryToFile(ofile,&sorted);
+    return;
+  }
   vector<double> xx(dimension_);
   vector<double> der(dimension_);
   double f;
   writeHeader(ofile);
   ofile.fmtField(" "+fmt_);
-  for(const auto & it : map_) {
-    index_t i=it.first;
+  for(const auto & i : sorted) {
     xx=getPoint(i);
     if(usederiv_) {f=getValueAndDerivatives(i,der);}
     else {f=getValue(i);}
@@ -847,11 +1142,125 @@ void SparseGrid::writeToFile(OFile& ofile) {
   }
 }
 
+MappedGrid::MappedGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
+                       const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool dospline, bool usederiv,
+                       const std::string& path, uint64_t offset, const BinaryGridHeader& header):
+  GridBase(funcl,args,gmin,gmax,nbin,dospline,usederiv),
+  path_(path),
+  map_(nullptr),
+  mapLength_(0),
+  data_(nullptr),
+  stride_(header.fields.size()),
+  valueOffset_(0),
+  derOffset_(dimension_,0)
+{
+  plumed_massert(!header.sparse && header.npoints==maxsize_,"file " + path + ": only dense grids can be mapped in memory");
+  auto ifield=[&](const std::string&name) {
+    auto it=std::find(header.fields.begin(),header.fields.end(),name);
+    plumed_massert(it!=header.fields.end(),"file " + path + ": no column labelled " + name + " in grid");
+    return static_cast<unsigned>(it-header.fields.begin());
+  };
+  valueOffset_=ifield(funcname);
+  if(usederiv_) for(unsigned j=0; j<dimension_; ++j) derOffset_[j]=ifield("der_" + argnames[j]);
+#ifdef __PLUMED_GRID_MMAP
+  int fd=::open(path.c_str(),O_RDONLY);
+  plumed_massert(fd>=0,"cannot open file " + path);
+  struct stat st;
+  if(fstat(fd,&st)!=0 || static_cast<uint64_t>(st.st_size)<offset+header.dataSize()) {
+    ::close(fd);
+    plumed_merror("file " + path + ": truncated binary grid");
+  }
+  mapLength_=st.st_size;
+  void* p=mmap(nullptr,mapLength_,PROT_READ,MAP_SHARED,fd,0);
+// the mapping remains valid after the file descriptor is closed
+  ::close(fd);
+  plumed_massert(p!=MAP_FAILED,"cannot map file " + path + " in memory");
+  map_=p;
+  data_=reinterpret_cast<const double*>(static_cast<const char*>(map_)+offset);
+#else
+  plumed_merror("mapping files in memory is not supported on this system");
+#endif
+}
+
+MappedGrid::~MappedGrid() {
+#ifdef __PLUMED_GRID_MMAP
+  if(map_) munmap(map_,mapLength_);
+#endif
+}
+
+bool MappedGrid::isAvailable() {
+#ifdef __PLUMED_GRID_MMAP
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MappedGrid::readOnlyError() const {
+  plumed_merror("grid read from file " + path_ + " cannot be modified");
+}
+
+Grid::index_t MappedGrid::getSize() const {
+  return maxsize_;
+}
+
+double MappedGrid::getValue(index_t index) const {
+  plumed_dbg_assert(index<maxsize_);
+  return data_[index*stride_+valueOffset_];
+}
+
+double MappedGrid::getValueAndDerivatives
+(index_t index, vector<double>& der) const {
+  plumed_dbg_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+  der.resize(dimension_);
+  const double* p=&data_[index*stride_];
+  for(unsigned i=0; i<dimension_; i++) der[i]=p[derOffset_[i]];
+  return p[valueOffset_];
+}
+
+void MappedGrid::setValue(index_t index, double value) {
+  readOnlyError();
+}
+
+void MappedGrid::setValueAndDerivatives(index_t index, double value, vector<double>& der) {
+  readOnlyError();
+}
+
+void MappedGrid::addValue(index_t index, double value) {
+  readOnlyError();
+}
+
+void MappedGrid::addValueAndDerivatives(index_t index, double value, vector<double>& der) {
+  readOnlyError();
+}
+
+double MappedGrid::getMinValue() const {
+  double minval;
+  minval=DBL_MAX;
+  for(index_t i=0; i<maxsize_; ++i) {
+    if(getValue(i)<minval) minval=getValue(i);
+  }
+  return minval;
+}
+
+double MappedGrid::getMaxValue() const {
+  double maxval;
+  maxval=-std::numeric_limits<double>::max();
+  for(index_t i=0; i<maxsize_; ++i) {
+    if(getValue(i)>maxval) maxval=getValue(i);
+  }
+  return maxval;
+}
+
+void MappedGrid::writeToFile(OFile& ofile) {
+  writeDenseToFile(ofile);
+}
+
 double SparseGrid::getMinValue() const {
   double minval;
   minval=0.0;
-  for(auto const & i : map_) {
-    if(i.second<minval) minval=i.second;
+  for(index_t i=0; i<keys_.size(); ++i) {
+    if(keys_[i]!=emptyKey_ && data_[i*stride_]<minval) minval=data_[i*stride_];
   }
   return minval;
 }
@@ -859,8 +1268,8 @@ double SparseGrid::getMinValue() const {
 double SparseGrid::getMaxValue() const {
   double maxval;
   maxval=0.0;
-  for(auto const & i : map_) {
-    if(i.second>maxval) maxval=i.second;
+  for(index_t i=0; i<keys_.size(); ++i) {
+    if(keys_[i]!=emptyKey_ && data_[i*stride_]>maxval) maxval=data_[i*stride_];
   }
   return maxval;
 }
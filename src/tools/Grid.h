@@ -27,6 +27,8 @@
 #include <map>
 #include <cmath>
 #include <memory>
+#include <cstdio>
+#include <cstdint>
 
 namespace PLMD {
 
@@ -67,6 +69,49 @@ class OFile;
 class KernelFunctions;
 class Communicator;
 
+/// \ingroup TOOLBOX
+/// Header of a grid stored in binary format.
+///
+/// Grids are written in binary format when the name of the output file has
+/// extension .bin. The header is made of text lines, so that it can be inspected with
+/// standard tools, e.g.:
+/// \verbatim
+/// PLUMED_BINARY_GRID 1
+/// ENDIAN little
+/// VARIABLES 1
+/// VARIABLE phi -pi pi 100 true
+/// FIELDS 2 metad.bias der_phi
+/// POINTS 100 dense
+/// END
+/// \endverbatim
+/// The END line is padded with spaces so that the length of the header is a multiple of 8 bytes.
+/// For each variable, the number of bins is reported as in the text format.
+/// For sparse grids, the header is followed by the indexes of the stored points (64-bit integers).
+/// Then, for each point, the values of all the fields are stored as doubles in the
+/// byte order of the machine that wrote the file.
+/// Several grids can be written one after the other on the same file.
+struct BinaryGridHeader {
+  std::vector<std::string> names,min,max;
+  std::vector<unsigned> nbins;
+  std::vector<bool> periodic;
+  std::vector<std::string> fields;
+  std::vector<std::pair<std::string,std::string>> constants;
+  uint64_t npoints=0;
+  bool sparse=false;
+  bool littleEndian=true;
+/// Endianness of this machine
+  static bool isLittleEndian();
+/// Check if a file contains grids in binary format
+  static bool isBinaryFile(const std::string&path);
+/// Write the header
+  void write(OFile&) const;
+/// Read the header from the current position of fp.
+/// Returns false if the end of the file has been reached.
+  bool read(FILE*fp,const std::string&path);
+/// Size in bytes of the data following the header
+  uint64_t dataSize() const;
+};
+
 /// \ingroup TOOLBOX
 class GridBase
 {
@@ -91,6 +136,11 @@ protected:
   unsigned dimension_;
   bool dospline_, usederiv_;
   std::string fmt_; // format for output
+/// dump grid on file in binary format.
+/// If indexes is not null, only the listed points are written (sparse grids)
+  void writeBinaryToFile(OFile&,const std::vector<index_t>*indexes=nullptr);
+/// dump all the points of the grid on file, in text or binary format
+  void writeDenseToFile(OFile&);
 /// get "neighbors" for spline
   void getSplineNeighbors(const std::vector<unsigned> & indices, std::vector<index_t>& neigh, unsigned& nneigh )const;
 // std::vector<index_t> getSplineNeighbors(const std::vector<unsigned> & indices)const;
@@ -156,8 +206,13 @@ public:
 /// write header for grid file
   void writeHeader(OFile& file);
 
-/// read grid from file
-  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,IFile&,bool,bool,bool);
+/// check if grids written on a file with this name use the binary format (i.e. extension .bin)
+  static bool useBinaryFormat(const std::string&path);
+
+/// read grid from file.
+/// If the last argument is true, the returned grid cannot be modified: dense grids in
+/// binary format are then mapped in memory rather than copied, when the system allows it
+  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,IFile&,bool,bool,bool,bool readonly=false);
 /// read grid from file and check boundaries are what is expected from input
   static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&, IFile&,
                                           const std::vector<std::string>&,const std::vector<std::string>&,
@@ -290,14 +345,35 @@ public:
 class SparseGrid : public GridBase
 {
 
-  std::map<index_t,double> map_;
-  std::map< index_t,std::vector<double> > der_;
+/// Open addressing hash table (linear probing) with the indexes of the stored points.
+/// Empty slots are marked with emptyKey_
+  std::vector<index_t> keys_;
+/// Values and derivatives of the stored points, contiguous in memory.
+/// Slot i is stored in data_[i*stride_] (value) and data_[i*stride_+1...] (derivatives)
+  std::vector<double> data_;
+/// Number of doubles per slot (1, or 1+dimension_ if derivatives are stored)
+  unsigned stride_;
+/// Number of stored points
+  index_t nfilled_;
+  static const index_t emptyKey_=~index_t(0);
+/// Find the slot containing index, or -1 if it is not stored
+  long long findSlot(index_t index) const;
+/// Find the slot containing index, creating it (with zero value and derivatives) if needed
+  index_t findOrCreateSlot(index_t index);
+/// Double the size of the hash table
+  void rehash();
 
 public:
   SparseGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
              const std::vector<std::string> & gmax,
              const std::vector<unsigned> & nbin, bool dospline, bool usederiv):
-    GridBase(funcl,args,gmin,gmax,nbin,dospline,usederiv) {}
+    GridBase(funcl,args,gmin,gmax,nbin,dospline,usederiv),
+    keys_(16,emptyKey_),
+    stride_(usederiv?1+dimension_:1),
+    nfilled_(0)
+  {
+    data_.assign(keys_.size()*stride_,0.0);
+  }
 
   index_t getSize() const override;
   index_t getMaxSize() const;
@@ -333,6 +409,54 @@ public:
 
   virtual ~SparseGrid() {}
 };
+
+/// \ingroup TOOLBOX
+/// Read-only dense grid whose values are taken from a binary grid file mapped in memory.
+/// This avoids copying large grids that are never modified (e.g. external potentials),
+/// and allows several processes on the same node to share the same physical memory.
+class MappedGrid : public GridBase
+{
+  std::string path_;
+  void* map_;
+  size_t mapLength_;
+/// values of the first point
+  const double* data_;
+/// number of doubles stored for each point
+  unsigned stride_;
+/// position of the value and of the derivatives within the data of a point
+  unsigned valueOffset_;
+  std::vector<unsigned> derOffset_;
+  void readOnlyError() const;
+public:
+/// map the grid stored at position offset of file path. Fields are identified as in the header.
+  MappedGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
+             const std::vector<std::string> & gmax, const std::vector<unsigned> & nbin, bool dospline, bool usederiv,
+             const std::string& path, uint64_t offset, const BinaryGridHeader& header);
+  MappedGrid(const MappedGrid&) = delete;
+  MappedGrid& operator=(const MappedGrid&) = delete;
+/// true if grids can be mapped in memory on this system
+  static bool isAvailable();
+
+  index_t getSize() const override;
+  using GridBase::getValue;
+  using GridBase::getValueAndDerivatives;
+  using GridBase::setValue;
+  using GridBase::setValueAndDerivatives;
+  using GridBase::addValue;
+  using GridBase::addValueAndDerivatives;
+  double getValue(index_t index) const override;
+  double getValueAndDerivatives(index_t index, std::vector<double>& der) const override;
+/// these methods raise an error, since the grid cannot be modified
+  void setValue(index_t index, double value) override;
+  void setValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+  void addValue(index_t index, double value) override;
+  void addValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+  double getMinValue() const override;
+  double getMaxValue() const override;
+/// dump grid on file (text or binary, depending on the extension)
+  void writeToFile(OFile&) override;
+  ~MappedGrid();
+};
 }
 
 #endif
@@ -22,6 +22,7 @@
 #include "LinkCells.h"
 #include "Communicator.h"
 #include "Tools.h"
+#include <algorithm>
 
 namespace PLMD {
 
@@ -102,6 +103,23 @@ void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vecto
   }
 }
 
+void LinkCells::buildCellLists( const std::vector<Vector>& pos, const std::vector<unsigned>& indices ) {
+  plumed_assert( cutoffwasset );
+// the box is larger than the cutoff in each direction, so that no close pair can be missed.
+// atoms found across the fictitious periodic boundaries should then be discarded when computing distances.
+  Vector lower,upper;
+  if(pos.size()>0) lower=upper=pos[0];
+  for(unsigned i=1; i<pos.size(); ++i) for(unsigned k=0; k<3; ++k) {
+      lower[k]=std::min(lower[k],pos[i][k]);
+      upper[k]=std::max(upper[k],pos[i][k]);
+    }
+  Pbc boundingbox;
+  Tensor box;
+  for(unsigned k=0; k<3; ++k) box(k,k)=upper[k]-lower[k]+link_cutoff;
+  boundingbox.setBox(box);
+  buildCellLists( pos, indices, boundingbox );
+}
+
 #define LINKC_MIN(n) ((n<2)? 0 : -1)
 #define LINKC_MAX(n) ((n<3)? 1 : 2)
 #define LINKC_PBC(n,num) ((n<0)? num-1 : n%num )
@@ -20,4 +20,29 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "Log.h"
+#include "Exception.h"
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
 
+namespace PLMD {
+
+int Log::printf(const char*fmt,...) {
+// the line is formatted before taking the lock, then written as a whole
+  va_list arg;
+  va_start(arg, fmt);
+  std::vector<char> buffer(256);
+  int r=std::vsnprintf(buffer.data(),buffer.size(),fmt,arg);
+  va_end(arg);
+  plumed_massert(r>-1,"error using fmt string " + std::string(fmt));
+  if(r>=int(buffer.size())) {
+    buffer.resize(r+1);
+    va_start(arg, fmt);
+    std::vsnprintf(buffer.data(),buffer.size(),fmt,arg);
+    va_end(arg);
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  return OFile::printf("%s",buffer.data());
+}
+
+}
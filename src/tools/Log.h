@@ -23,6 +23,7 @@
 #define __PLUMED_tools_Log_h
 
 #include "OFile.h"
+#include <mutex>
 
 namespace PLMD {
 
@@ -31,12 +32,30 @@ namespace PLMD {
 /// It is similar to a FILE stream. It allows a printf() function, and
 /// also to write with a << operator. Moreover, it can prefix
 /// lines with the "PLUMED:" prefix, useful to grep out plumed
-/// log from output
+/// log from output.
+///
+/// The log is shared by all the actions, that can be calculated concurrently
+/// (see DEBUG TASK_GRAPH). Each call to printf() or << is thus
+/// protected by a mutex, so that the output of different threads is not mixed.
 class Log :
   public OFile
 {
+  std::mutex mtx;
+public:
+/// Formatted output with explicit format - a la printf
+  int printf(const char*fmt,...);
+  template <class T>
+  friend Log& operator<<(Log&,const T &);
 };
 
+/// Write using << syntax
+template <class T>
+Log& operator<<(Log&log,const T &t) {
+  std::lock_guard<std::mutex> lock(log.mtx);
+  static_cast<OFile&>(log)<<t;
+  return log;
+}
+
 }
 
 #endif
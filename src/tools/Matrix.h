@@ -25,14 +25,18 @@
 #include <string>
 #include <set>
 #include <cmath>
+#include <algorithm>
 #include "Exception.h"
 #include "MatrixSquareBracketsAccess.h"
 #include "Tools.h"
 #include "Log.h"
 #include "lapack/lapack.h"
+#include "blas/blas.h"
 
 namespace PLMD {
 
+struct MatrixWorkspace;
+
 /// Calculate the dot product between two vectors
 template <typename T> T dotProduct( const std::vector<T>& A, const std::vector<T>& B ) {
   plumed_assert( A.size()==B.size() );
@@ -61,18 +65,24 @@ class Matrix:
   template <typename U> friend void mult( const std::vector<U>&, const Matrix<U>&, std::vector<U>& );
   /// Matrix transpose
   template <typename U> friend void transpose( const Matrix<U>&, Matrix<U>& );
+  /// Scale a symmetric matrix and add the outer product of a vector with itself
+  template <typename U> friend void symmetricUpdate( const U&, const std::vector<U>&, const U&, Matrix<U>& );
+  /// Scale a symmetric matrix and add the product of the transpose of a matrix with the matrix itself
+  template <typename U> friend void symmetricUpdate( const U&, const Matrix<U>&, const U&, Matrix<U>& );
   /// Output the entire matrix on a single line
   template <typename U> friend Log& operator<<(Log&, const Matrix<U>& );
   /// Output the Matrix in matrix form
   template <typename U> friend void matrixOut( Log&, const Matrix<U>& );
   /// Diagonalize a symmetric matrix - returns zero if diagonalization worked
-  template <typename U> friend int diagMat( const Matrix<U>&, std::vector<double>&, Matrix<double>& );
+  template <typename U> friend int diagMat( const Matrix<U>&, std::vector<double>&, Matrix<double>&, MatrixWorkspace& );
+  /// Compute the largest eigenvalues of a symmetric matrix and their eigenvectors - returns zero if diagonalization worked
+  template <typename U> friend int diagMat( const Matrix<U>&, const unsigned&, std::vector<double>&, Matrix<double>&, MatrixWorkspace& );
   /// Calculate the Moore-Penrose Pseudoinverse of a matrix
-  template <typename U> friend int pseudoInvert( const Matrix<U>&, Matrix<double>& );
+  template <typename U> friend int pseudoInvert( const Matrix<U>&, Matrix<double>&, MatrixWorkspace& );
   /// Calculate the logarithm of the determinant of a symmetric matrix - returns zero if succesfull
-  template <typename U> friend int logdet( const Matrix<U>&, double& );
+  template <typename U> friend int logdet( const Matrix<U>&, double&, MatrixWorkspace& );
   /// Invert a matrix (works for both symmetric and asymmetric matrices) - returns zero if sucesfull
-  template <typename U> friend int Invert( const Matrix<U>&, Matrix<double>& );
+  template <typename U> friend int Invert( const Matrix<U>&, Matrix<double>&, MatrixWorkspace& );
   /// Do a cholesky decomposition of a matrix
   template <typename U> friend void cholesky( const Matrix<U>&, Matrix<U>& );
   /// Solve a system of equations using the cholesky decomposition
@@ -165,10 +175,42 @@ template <typename T> Matrix<T> operator*(T& v, const Matrix<T>& m ) {
   return new_m;
 }
 
+/// Scratch arrays for the LAPACK drivers used by diagMat(), Invert(), pseudoInvert() and logdet().
+/// Passing the same workspace to repeated calls avoids reallocating them every time.
+struct MatrixWorkspace {
+  std::vector<double> da, w, z, work, s, u, vt, eigenvals;
+  std::vector<int> iwork, isup;
+  Matrix<double> eigenvecs, scaled, ut;
+};
+
+/// Block size used by the loops that are not done with BLAS
+static const unsigned matrixBlockSize=64;
+
 template <typename T> void mult( const Matrix<T>& A, const Matrix<T>& B, Matrix<T>& C ) {
   plumed_assert(A.cl==B.rw);
   if( A.rw !=C.rw  || B.cl !=C.cl ) { C.resize( A.rw, B.cl ); } C=static_cast<T>( 0 );
-  for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<B.cl; ++j) for (unsigned k=0; k<A.cl; ++k) C(i,j)+=A(i,k)*B(k,j);
+  // Loops are blocked so that the rows of B that are used stay in cache, the order of the sums is unchanged
+  for(unsigned jj=0; jj<B.cl; jj+=matrixBlockSize) {
+    const unsigned jend=std::min(jj+matrixBlockSize,B.cl);
+    for(unsigned kk=0; kk<A.cl; kk+=matrixBlockSize) {
+      const unsigned kend=std::min(kk+matrixBlockSize,A.cl);
+      for(unsigned i=0; i<A.rw; ++i) for(unsigned k=kk; k<kend; ++k) {
+          const T aik=A(i,k);
+          for(unsigned j=jj; j<jend; ++j) C(i,j)+=aik*B(k,j);
+        }
+    }
+  }
+}
+
+template <> inline void mult( const Matrix<double>& A, const Matrix<double>& B, Matrix<double>& C ) {
+  plumed_assert(A.cl==B.rw);
+  if( A.rw !=C.rw  || B.cl !=C.cl ) { C.resize( A.rw, B.cl ); }
+  if( C.sz==0 ) return;
+  if( A.cl==0 ) { C=0.0; return; }
+  // Row-major matrices are seen by BLAS as their transposes, so C^T = B^T A^T is computed
+  int m=B.cl, n=A.rw, k=A.cl; double one=1.0, zero=0.0;
+  plumed_blas_dgemm("N","N",&m,&n,&k,&one,const_cast<double*>(B.data.data()),&m,
+                    const_cast<double*>(A.data.data()),&k,&zero,C.data.data(),&m);
 }
 
 template <typename T> void mult( const Matrix<T>& A, const std::vector<T>& B, std::vector<T>& C) {
@@ -178,11 +220,74 @@ template <typename T> void mult( const Matrix<T>& A, const std::vector<T>& B, st
   for(unsigned i=0; i<A.rw; ++i) for(unsigned k=0; k<A.cl; ++k) C[i]+=A(i,k)*B[k] ;
 }
 
+template <> inline void mult( const Matrix<double>& A, const std::vector<double>& B, std::vector<double>& C) {
+  plumed_assert( A.cl==B.size() );
+  if( C.size()!=A.rw  ) { C.resize(A.rw); }
+  if( A.rw==0 ) return;
+  if( A.cl==0 ) { for(unsigned i=0; i<A.rw; ++i) C[i]=0.0; return; }
+  int m=A.cl, n=A.rw, inc=1; double one=1.0, zero=0.0;
+  plumed_blas_dgemv("T",&m,&n,&one,const_cast<double*>(A.data.data()),&m,
+                    const_cast<double*>(B.data()),&inc,&zero,C.data(),&inc);
+}
+
 template <typename T> void mult( const std::vector<T>& A, const Matrix<T>& B, std::vector<T>& C) {
   plumed_assert( B.rw==A.size() );
   if( C.size()!=B.cl ) {C.resize( B.cl );}
   for(unsigned i=0; i<B.cl; ++i) { C[i]=static_cast<T>( 0 ); }
-  for(unsigned i=0; i<B.cl; ++i) for(unsigned k=0; k<B.rw; ++k) C[i]+=A[k]*B(k,i);
+  // Rows of B are accessed contiguously, the order of the sums is unchanged
+  for(unsigned k=0; k<B.rw; ++k) for(unsigned i=0; i<B.cl; ++i) C[i]+=A[k]*B(k,i);
+}
+
+template <> inline void mult( const std::vector<double>& A, const Matrix<double>& B, std::vector<double>& C) {
+  plumed_assert( B.rw==A.size() );
+  if( C.size()!=B.cl ) {C.resize( B.cl );}
+  if( B.cl==0 ) return;
+  if( B.rw==0 ) { for(unsigned i=0; i<B.cl; ++i) C[i]=0.0; return; }
+  int m=B.cl, n=B.rw, inc=1; double one=1.0, zero=0.0;
+  plumed_blas_dgemv("N",&m,&n,&one,const_cast<double*>(B.data.data()),&m,
+                    const_cast<double*>(A.data()),&inc,&zero,C.data(),&inc);
+}
+
+/// Set A to beta*A + alpha*x*x^T. A must be symmetric and stays exactly symmetric.
+template <typename T> void symmetricUpdate( const T& alpha, const std::vector<T>& x, const T& beta, Matrix<T>& A ) {
+  plumed_assert( A.rw==A.cl && A.rw==x.size() );
+  for(unsigned i=0; i<A.rw; ++i) {
+    for(unsigned j=0; j<=i; ++j) A(i,j)=beta*A(i,j)+alpha*x[i]*x[j];
+    for(unsigned j=0; j<i; ++j) A(j,i)=A(i,j);
+  }
+}
+
+template <> inline void symmetricUpdate( const double& alpha, const std::vector<double>& x, const double& beta, Matrix<double>& A ) {
+  plumed_assert( A.rw==A.cl && A.rw==x.size() );
+  if( A.rw==0 ) return;
+  int n=A.rw, inc=1; double halfalpha=0.5*alpha;
+  // Only the lower triangle is updated (upper in BLAS convention), and then copied
+  if( beta!=1.0 ) for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<=i; ++j) A(i,j)*=beta;
+  plumed_blas_dsyr2("U",&n,&halfalpha,const_cast<double*>(x.data()),&inc,const_cast<double*>(x.data()),&inc,A.data.data(),&n);
+  for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<i; ++j) A(j,i)=A(i,j);
+}
+
+/// Set A to beta*A + alpha*X^T*X, that is add the outer products of all the rows of X.
+/// A must be symmetric and stays exactly symmetric.
+template <typename T> void symmetricUpdate( const T& alpha, const Matrix<T>& X, const T& beta, Matrix<T>& A ) {
+  plumed_assert( A.rw==A.cl && A.rw==X.cl );
+  for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<=i; ++j) A(i,j)*=beta;
+  for(unsigned p=0; p<X.rw; ++p) for(unsigned i=0; i<A.rw; ++i) {
+      const T axi=alpha*X(p,i);
+      for(unsigned j=0; j<=i; ++j) A(i,j)+=axi*X(p,j);
+    }
+  for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<i; ++j) A(j,i)=A(i,j);
+}
+
+template <> inline void symmetricUpdate( const double& alpha, const Matrix<double>& X, const double& beta, Matrix<double>& A ) {
+  plumed_assert( A.rw==A.cl && A.rw==X.cl );
+  if( A.rw==0 ) return;
+  if( X.rw==0 ) { for(unsigned i=0; i<A.sz; ++i) A.data[i]*=beta; return; }
+  // X is seen by BLAS as the matrix whose columns are the rows of X
+  int n=A.rw, k=X.rw; double halfalpha=0.5*alpha, b=beta;
+  plumed_blas_dsyr2k("U","N",&n,&k,&halfalpha,const_cast<double*>(X.data.data()),&n,
+                     const_cast<double*>(X.data.data()),&n,&b,A.data.data(),&n);
+  for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<i; ++j) A(j,i)=A(i,j);
 }
 
 template <typename T> void transpose( const Matrix<T>& A, Matrix<T>& AT ) {
@@ -203,53 +308,54 @@ template <typename T> void matrixOut( Log& ostr, const Matrix<T>& mat) {
   return;
 }
 
-template <typename T> int diagMat( const Matrix<T>& A, std::vector<double>& eigenvals, Matrix<double>& eigenvecs ) {
+template <typename T> int diagMat( const Matrix<T>& A, const unsigned& nvals, std::vector<double>& eigenvals, Matrix<double>& eigenvecs, MatrixWorkspace& ws ) {
 
   // Check matrix is square and symmetric
-  plumed_assert( A.rw==A.cl ); plumed_assert( A.isSymmetric()==1 );
-  std::vector<double> da(A.sz);
+  plumed_assert( A.rw==A.cl ); plumed_assert( A.isSymmetric()==1 ); plumed_assert( nvals>0 && nvals<=A.cl );
+  ws.da.resize(A.sz);
   unsigned k=0;
-  std::vector<double> evals(A.cl);
+  ws.w.resize(A.cl);
   // Transfer the matrix to the local array
-  for (unsigned i=0; i<A.cl; ++i) for (unsigned j=0; j<A.rw; ++j) da[k++]=static_cast<double>( A(j,i) );
+  for (unsigned i=0; i<A.cl; ++i) for (unsigned j=0; j<A.rw; ++j) ws.da[k++]=static_cast<double>( A(j,i) );
 
-  int n=A.cl; int lwork=-1, liwork=-1, m, info, one=1;
-  std::vector<double> work(A.cl);
-  std::vector<int> iwork(A.cl);
+  // Only the nvals largest eigenvalues (indexes il to n in ascending order) are computed
+  int n=A.cl; int lwork=-1, liwork=-1, m, info, il=A.cl-nvals+1;
+  if( ws.work.size()<1 ) ws.work.resize(1);
+  if( ws.iwork.size()<1 ) ws.iwork.resize(1);
   double vl, vu, abstol=0.0;
-  std::vector<int> isup(2*A.cl);
-  std::vector<double> evecs(A.sz);
+  ws.isup.resize(2*A.cl);
+  ws.z.resize(A.rw*nvals);
 
-  plumed_lapack_dsyevr("V", "I", "U", &n, da.data(), &n, &vl, &vu, &one, &n,
-                       &abstol, &m, evals.data(), evecs.data(), &n,
-                       isup.data(), work.data(), &lwork, iwork.data(), &liwork, &info);
+  plumed_lapack_dsyevr("V", "I", "U", &n, ws.da.data(), &n, &vl, &vu, &il, &n,
+                       &abstol, &m, ws.w.data(), ws.z.data(), &n,
+                       ws.isup.data(), ws.work.data(), &lwork, ws.iwork.data(), &liwork, &info);
   if (info!=0) return info;
 
   // Retrieve correct sizes for work and iwork then reallocate
-  liwork=iwork[0]; iwork.resize(liwork);
-  lwork=static_cast<int>( work[0] ); work.resize(lwork);
+  liwork=ws.iwork[0]; if( ws.iwork.size()<static_cast<std::size_t>(liwork) ) ws.iwork.resize(liwork);
+  lwork=static_cast<int>( ws.work[0] ); if( ws.work.size()<static_cast<std::size_t>(lwork) ) ws.work.resize(lwork);
 
-  plumed_lapack_dsyevr("V", "I", "U", &n, da.data(), &n, &vl, &vu, &one, &n,
-                       &abstol, &m, evals.data(), evecs.data(), &n,
-                       isup.data(), work.data(), &lwork, iwork.data(), &liwork, &info);
+  plumed_lapack_dsyevr("V", "I", "U", &n, ws.da.data(), &n, &vl, &vu, &il, &n,
+                       &abstol, &m, ws.w.data(), ws.z.data(), &n,
+                       ws.isup.data(), ws.work.data(), &lwork, ws.iwork.data(), &liwork, &info);
   if (info!=0) return info;
 
-  if( eigenvals.size()!=A.cl ) { eigenvals.resize( A.cl ); }
-  if( eigenvecs.rw!=A.rw || eigenvecs.cl!=A.cl ) { eigenvecs.resize( A.rw, A.cl ); }
+  if( eigenvals.size()!=nvals ) { eigenvals.resize( nvals ); }
+  if( eigenvecs.rw!=nvals || eigenvecs.cl!=A.cl ) { eigenvecs.resize( nvals, A.cl ); }
   k=0;
-  for(unsigned i=0; i<A.cl; ++i) {
-    eigenvals[i]=evals[i];
+  for(unsigned i=0; i<nvals; ++i) {
+    eigenvals[i]=ws.w[i];
     // N.B. For ease of producing projectors we store the eigenvectors
     // ROW-WISE in the eigenvectors matrix.  The first index is the
     // eigenvector number and the second the component
-    for(unsigned j=0; j<A.rw; ++j) { eigenvecs(i,j)=evecs[k++]; }
+    for(unsigned j=0; j<A.rw; ++j) { eigenvecs(i,j)=ws.z[k++]; }
   }
 
   // This changes eigenvectors so that the first non-null element
   // of each of them is positive
   // We can do it because the phase is arbitrary, and helps making
   // the result reproducible
-  for(int i=0; i<n; ++i) {
+  for(unsigned i=0; i<nvals; ++i) {
     int j;
     for(j=0; j<n; j++) if(eigenvecs(i,j)*eigenvecs(i,j)>1e-14) break;
     if(j<n) if(eigenvecs(i,j)<0.0) for(j=0; j<n; j++) eigenvecs(i,j)*=-1;
@@ -257,89 +363,104 @@ template <typename T> int diagMat( const Matrix<T>& A, std::vector<double>& eige
   return 0;
 }
 
-template <typename T> int pseudoInvert( const Matrix<T>& A, Matrix<double>& pseudoinverse ) {
-  std::vector<double> da(A.sz);
+template <typename T> int diagMat( const Matrix<T>& A, std::vector<double>& eigenvals, Matrix<double>& eigenvecs, MatrixWorkspace& ws ) {
+  return diagMat( A, A.cl, eigenvals, eigenvecs, ws );
+}
+
+template <typename T> int diagMat( const Matrix<T>& A, std::vector<double>& eigenvals, Matrix<double>& eigenvecs ) {
+  MatrixWorkspace ws;
+  return diagMat( A, eigenvals, eigenvecs, ws );
+}
+
+template <typename T> int pseudoInvert( const Matrix<T>& A, Matrix<double>& pseudoinverse, MatrixWorkspace& ws ) {
+  ws.da.resize(A.sz);
   unsigned k=0;
   // Transfer the matrix to the local array
-  for (unsigned i=0; i<A.cl; ++i) for (unsigned j=0; j<A.rw; ++j) da[k++]=static_cast<double>( A(j,i) );
+  for (unsigned i=0; i<A.cl; ++i) for (unsigned j=0; j<A.rw; ++j) ws.da[k++]=static_cast<double>( A(j,i) );
 
   int nsv, info, nrows=A.rw, ncols=A.cl;
   if(A.rw>A.cl) {nsv=A.cl;} else {nsv=A.rw;}
 
   // Create some containers for stuff from single value decomposition
-  std::vector<double> S(nsv);
-  std::vector<double> U(nrows*nrows);
-  std::vector<double> VT(ncols*ncols);
-  std::vector<int> iwork(8*nsv);
+  ws.s.resize(nsv);
+  ws.u.resize(nrows*nrows);
+  ws.vt.resize(ncols*ncols);
+  ws.iwork.resize(std::max<std::size_t>(ws.iwork.size(),8*nsv));
 
   // This optimizes the size of the work array used in lapack singular value decomposition
   int lwork=-1;
-  std::vector<double> work(1);
-  plumed_lapack_dgesdd( "A", &nrows, &ncols, da.data(), &nrows, S.data(), U.data(), &nrows, VT.data(), &ncols, work.data(), &lwork, iwork.data(), &info );
+  if( ws.work.size()<1 ) ws.work.resize(1);
+  plumed_lapack_dgesdd( "A", &nrows, &ncols, ws.da.data(), &nrows, ws.s.data(), ws.u.data(), &nrows, ws.vt.data(), &ncols, ws.work.data(), &lwork, ws.iwork.data(), &info );
   if(info!=0) return info;
 
   // Retrieve correct sizes for work and rellocate
-  lwork=(int) work[0]; work.resize(lwork);
+  lwork=(int) ws.work[0]; if( ws.work.size()<static_cast<std::size_t>(lwork) ) ws.work.resize(lwork);
 
   // This does the singular value decomposition
-  plumed_lapack_dgesdd( "A", &nrows, &ncols, da.data(), &nrows, S.data(), U.data(), &nrows, VT.data(), &ncols, work.data(), &lwork, iwork.data(), &info );
+  plumed_lapack_dgesdd( "A", &nrows, &ncols, ws.da.data(), &nrows, ws.s.data(), ws.u.data(), &nrows, ws.vt.data(), &ncols, ws.work.data(), &lwork, ws.iwork.data(), &info );
   if(info!=0) return info;
 
   // Compute the tolerance on the singular values ( machine epsilon * number of singular values * maximum singular value )
-  double tol; tol=S[0]; for(int i=1; i<nsv; ++i) { if( S[i]>tol ) { tol=S[i]; } } tol*=nsv*epsilon;
-
-  // Get the inverses of the singlular values
-  Matrix<double> Si( ncols, nrows ); Si=0.0;
-  for(int i=0; i<nsv; ++i) { if( S[i]>tol ) { Si(i,i)=1./S[i]; } else { Si(i,i)=0.0; } }
+  double tol; tol=ws.s[0]; for(int i=1; i<nsv; ++i) { if( ws.s[i]>tol ) { tol=ws.s[i]; } } tol*=nsv*epsilon;
 
-  // Now extract matrices for pseudoinverse
-  Matrix<double> V( ncols, ncols ), UT( nrows, nrows ), tmp( ncols, nrows );
-  k=0; for(int i=0; i<nrows; ++i) { for(int j=0; j<nrows; ++j) { UT(i,j)=U[k++]; } }
-  k=0; for(int i=0; i<ncols; ++i) { for(int j=0; j<ncols; ++j) { V(i,j)=VT[k++]; } }
+  // The pseudoinverse is V times the inverses of the singular values times U^T. The first nsv columns of V
+  // are scaled by the inverses of the singular values, while the first nsv rows of U^T are stored contiguously in u
+  ws.scaled.resize( ncols, nsv ); ws.ut.resize( nsv, nrows );
+  for(int i=0; i<ncols; ++i) for(int j=0; j<nsv; ++j) ws.scaled(i,j)=( ws.s[j]>tol ? ws.vt[i*ncols+j]/ws.s[j] : 0.0 );
+  for(int i=0; i<nsv*nrows; ++i) ws.ut.data[i]=ws.u[i];
 
   // And do matrix algebra to construct the pseudoinverse
-  if( pseudoinverse.rw!=ncols || pseudoinverse.cl!=nrows ) pseudoinverse.resize( ncols, nrows );
-  mult( V, Si, tmp ); mult( tmp, UT, pseudoinverse );
+  mult( ws.scaled, ws.ut, pseudoinverse );
 
   return 0;
 }
 
-template <typename T> int Invert( const Matrix<T>& A, Matrix<double>& inverse ) {
+template <typename T> int pseudoInvert( const Matrix<T>& A, Matrix<double>& pseudoinverse ) {
+  MatrixWorkspace ws;
+  return pseudoInvert( A, pseudoinverse, ws );
+}
+
+template <typename T> int Invert( const Matrix<T>& A, Matrix<double>& inverse, MatrixWorkspace& ws ) {
 
   if( A.isSymmetric()==1 ) {
     // GAT -- I only ever use symmetric matrices so I can invert them like this.
     // I choose to do this as I have had problems with the more general way of doing this that
     // is implemented below.
-    std::vector<double> eval(A.rw); Matrix<double> evec(A.rw,A.cl), tevec(A.rw,A.cl);
-    int err; err=diagMat( A, eval, evec );
+    int err; err=diagMat( A, ws.eigenvals, ws.eigenvecs, ws );
     if(err!=0) return err;
-    for (unsigned i=0; i<A.rw; ++i) for (unsigned j=0; j<A.cl; ++j) tevec(i,j)=evec(j,i)/eval[j];
-    mult(tevec,evec,inverse);
+    ws.scaled.resize( A.rw, A.cl );
+    for (unsigned i=0; i<A.rw; ++i) for (unsigned j=0; j<A.cl; ++j) ws.scaled(i,j)=ws.eigenvecs(j,i)/ws.eigenvals[j];
+    mult(ws.scaled,ws.eigenvecs,inverse);
   } else {
-    std::vector<double> da(A.sz);
-    std::vector<int> ipiv(A.cl);
+    ws.da.resize(A.sz);
+    ws.iwork.resize(std::max<std::size_t>(ws.iwork.size(),A.cl));
     unsigned k=0; int n=A.rw, info;
-    for(unsigned i=0; i<A.cl; ++i) for(unsigned j=0; j<A.rw; ++j) da[k++]=static_cast<double>( A(j,i) );
+    for(unsigned i=0; i<A.cl; ++i) for(unsigned j=0; j<A.rw; ++j) ws.da[k++]=static_cast<double>( A(j,i) );
 
-    plumed_lapack_dgetrf(&n,&n,da.data(),&n,ipiv.data(),&info);
+    plumed_lapack_dgetrf(&n,&n,ws.da.data(),&n,ws.iwork.data(),&info);
     if(info!=0) return info;
 
     int lwork=-1;
-    std::vector<double> work(A.cl);
-    plumed_lapack_dgetri(&n,da.data(),&n,ipiv.data(),work.data(),&lwork,&info);
+    if( ws.work.size()<1 ) ws.work.resize(1);
+    plumed_lapack_dgetri(&n,ws.da.data(),&n,ws.iwork.data(),ws.work.data(),&lwork,&info);
     if(info!=0) return info;
 
-    lwork=static_cast<int>( work[0] ); work.resize(lwork);
-    plumed_lapack_dgetri(&n,da.data(),&n,ipiv.data(),work.data(),&lwork,&info);
+    lwork=static_cast<int>( ws.work[0] ); if( ws.work.size()<static_cast<std::size_t>(lwork) ) ws.work.resize(lwork);
+    plumed_lapack_dgetri(&n,ws.da.data(),&n,ws.iwork.data(),ws.work.data(),&lwork,&info);
     if(info!=0) return info;
 
     if( inverse.cl!=A.cl || inverse.rw!=A.rw ) { inverse.resize(A.rw,A.cl); }
-    k=0; for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<A.cl; ++j) inverse(j,i)=da[k++];
+    k=0; for(unsigned i=0; i<A.rw; ++i) for(unsigned j=0; j<A.cl; ++j) inverse(j,i)=ws.da[k++];
   }
 
   return 0;
 }
 
+template <typename T> int Invert( const Matrix<T>& A, Matrix<double>& inverse ) {
+  MatrixWorkspace ws;
+  return Invert( A, inverse, ws );
+}
+
 template <typename T> void cholesky( const Matrix<T>& A, Matrix<T>& B ) {
 
   plumed_assert( A.rw==A.cl && A.isSymmetric() );
@@ -372,42 +493,49 @@ template <typename T> void chol_elsolve( const Matrix<T>& M, const std::vector<T
   }
 }
 
-template <typename T> int logdet( const Matrix<T>& M, double& ldet ) {
+template <typename T> int logdet( const Matrix<T>& M, double& ldet, MatrixWorkspace& ws ) {
   // Check matrix is square and symmetric
   plumed_assert( M.rw==M.cl || M.isSymmetric() );
+  // ldet is left to zero if LAPACK fails
+  ldet=0.0;
 
-  std::vector<double> da(M.sz);
+  ws.da.resize(M.sz);
   unsigned k=0;
-  std::vector<double> evals(M.cl);
+  ws.w.resize(M.cl);
   // Transfer the matrix to the local array
-  for (unsigned i=0; i<M.rw; ++i) for (unsigned j=0; j<M.cl; ++j) da[k++]=static_cast<double>( M(j,i) );
+  for (unsigned i=0; i<M.rw; ++i) for (unsigned j=0; j<M.cl; ++j) ws.da[k++]=static_cast<double>( M(j,i) );
 
   int n=M.cl; int lwork=-1, liwork=-1, info, m, one=1;
-  std::vector<double> work(M.rw);
-  std::vector<int> iwork(M.rw);
+  if( ws.work.size()<1 ) ws.work.resize(1);
+  if( ws.iwork.size()<1 ) ws.iwork.resize(1);
   double vl, vu, abstol=0.0;
-  std::vector<int> isup(2*M.rw);
-  std::vector<double> evecs(M.sz);
-  plumed_lapack_dsyevr("N", "I", "U", &n, da.data(), &n, &vl, &vu, &one, &n,
-                       &abstol, &m, evals.data(), evecs.data(), &n,
-                       isup.data(), work.data(), &lwork, iwork.data(), &liwork, &info);
+  ws.isup.resize(2*M.rw);
+  ws.z.resize(M.sz);
+  plumed_lapack_dsyevr("N", "I", "U", &n, ws.da.data(), &n, &vl, &vu, &one, &n,
+                       &abstol, &m, ws.w.data(), ws.z.data(), &n,
+                       ws.isup.data(), ws.work.data(), &lwork, ws.iwork.data(), &liwork, &info);
   if (info!=0) return info;
 
   // Retrieve correct sizes for work and iwork then reallocate
-  lwork=static_cast<int>( work[0] ); work.resize(lwork);
-  liwork=iwork[0]; iwork.resize(liwork);
+  lwork=static_cast<int>( ws.work[0] ); if( ws.work.size()<static_cast<std::size_t>(lwork) ) ws.work.resize(lwork);
+  liwork=ws.iwork[0]; if( ws.iwork.size()<static_cast<std::size_t>(liwork) ) ws.iwork.resize(liwork);
 
-  plumed_lapack_dsyevr("N", "I", "U", &n, da.data(), &n, &vl, &vu, &one, &n,
-                       &abstol, &m, evals.data(), evecs.data(), &n,
-                       isup.data(), work.data(), &lwork, iwork.data(), &liwork, &info);
+  plumed_lapack_dsyevr("N", "I", "U", &n, ws.da.data(), &n, &vl, &vu, &one, &n,
+                       &abstol, &m, ws.w.data(), ws.z.data(), &n,
+                       ws.isup.data(), ws.work.data(), &lwork, ws.iwork.data(), &liwork, &info);
   if (info!=0) return info;
 
   // Transfer the eigenvalues and eigenvectors to the output
-  ldet=0; for(unsigned i=0; i<M.cl; i++) { ldet+=log(evals[i]); }
+  ldet=0; for(unsigned i=0; i<M.cl; i++) { ldet+=log(ws.w[i]); }
 
   return 0;
 }
 
+template <typename T> int logdet( const Matrix<T>& M, double& ldet ) {
+  MatrixWorkspace ws;
+  return logdet( M, ldet, ws );
+}
+
 
 
 }
@@ -23,6 +23,8 @@
 #include "Vector.h"
 #include "Pbc.h"
 #include "AtomNumber.h"
+#include "Communicator.h"
+#include "LinkCells.h"
 #include "Tools.h"
 #include <vector>
 #include <algorithm>
@@ -32,9 +34,11 @@ using namespace std;
 
 NeighborList::NeighborList(const vector<AtomNumber>& list0, const vector<AtomNumber>& list1,
                            const bool& do_pair, const bool& do_pbc, const Pbc& pbc,
-                           const double& distance, const unsigned& stride): reduced(false),
+                           const double& distance, const unsigned& stride,
+                           const double& skin): reduced(false),
   do_pair_(do_pair), do_pbc_(do_pbc), pbc_(&pbc),
-  distance_(distance), stride_(stride)
+  distance_(distance), stride_(stride), skin_(skin),
+  serialcomm_(new Communicator), linkcells_(new LinkCells(*serialcomm_))
 {
 // store full list of atoms needed
   fullatomlist_=list0;
@@ -55,9 +59,10 @@ NeighborList::NeighborList(const vector<AtomNumber>& list0, const vector<AtomNum
 
 NeighborList::NeighborList(const vector<AtomNumber>& list0, const bool& do_pbc,
                            const Pbc& pbc, const double& distance,
-                           const unsigned& stride): reduced(false),
+                           const unsigned& stride, const double& skin): reduced(false),
   do_pbc_(do_pbc), pbc_(&pbc),
-  distance_(distance), stride_(stride) {
+  distance_(distance), stride_(stride), skin_(skin),
+  serialcomm_(new Communicator), linkcells_(new LinkCells(*serialcomm_)) {
   fullatomlist_=list0;
   nlist0_=list0.size();
   twolists_=false;
@@ -66,6 +71,10 @@ NeighborList::NeighborList(const vector<AtomNumber>& list0, const bool& do_pbc,
   lastupdate_=0;
 }
 
+NeighborList::~NeighborList() {
+// destructor required to delete forward declared classes
+}
+
 void NeighborList::initialize() {
   neighbors_.clear();
   for(unsigned int i=0; i<nallpairs_; ++i) {
@@ -92,11 +101,40 @@ pair<unsigned,unsigned> NeighborList::getIndexPair(unsigned ipair) {
   return index;
 }
 
-void NeighborList::update(const vector<Vector>& positions) {
-  neighbors_.clear();
-  const double d2=distance_*distance_;
+bool NeighborList::update(const vector<Vector>& positions) {
 // check if positions array has the correct length
   plumed_assert(positions.size()==fullatomlist_.size());
+  if(!needsRebuild(positions)) {
+// the present list is still valid: go back to indexes in the full list
+    if(reduced) for(unsigned int i=0; i<size(); ++i) {
+        neighbors_[i]=pair<unsigned,unsigned>(requestindex_[neighbors_[i].first],requestindex_[neighbors_[i].second]);
+      }
+    reduced=false;
+    return false;
+  }
+  neighbors_.clear();
+// with PAIR there are only nlist0_ pairs, and without cutoff all pairs are needed
+  if((twolists_ && do_pair_) || distance_>=1.0e+30) updateAllPairs(positions);
+  else updateLinkCells(positions);
+  if(skin_>0.0) lastpositions_=positions;
+  setRequestList();
+  return true;
+}
+
+bool NeighborList::needsRebuild(const vector<Vector>& positions)const {
+  if(skin_<=0.0 || lastpositions_.size()!=positions.size()) return true;
+  const double maxdisp2=0.25*skin_*skin_;
+  for(unsigned i=0; i<positions.size(); ++i) {
+    Vector disp;
+    if(do_pbc_) disp=pbc_->distance(lastpositions_[i],positions[i]);
+    else disp=delta(lastpositions_[i],positions[i]);
+    if(modulo2(disp)>maxdisp2) return true;
+  }
+  return false;
+}
+
+void NeighborList::updateAllPairs(const vector<Vector>& positions) {
+  const double d2=(distance_+skin_)*(distance_+skin_);
   for(unsigned int i=0; i<nallpairs_; ++i) {
     pair<unsigned,unsigned> index=getIndexPair(i);
     unsigned index0=index.first;
@@ -110,7 +148,54 @@ void NeighborList::update(const vector<Vector>& positions) {
     double value=modulo2(distance);
     if(value<=d2) {neighbors_.push_back(index);}
   }
-  setRequestList();
+}
+
+void NeighborList::updateLinkCells(const vector<Vector>& positions) {
+  const double cutoff=distance_+skin_;
+// atoms put in the link cells are those of the second list, or all the atoms with one list
+  const unsigned first=(twolists_ ? nlist0_ : 0);
+  const unsigned ncellatoms=positions.size()-first;
+  cellpositions_.resize(ncellatoms);
+  cellindices_.resize(ncellatoms);
+  for(unsigned i=0; i<ncellatoms; ++i) {
+    cellpositions_[i]=positions[first+i];
+    cellindices_[i]=first+i;
+  }
+  cellatoms_.resize(ncellatoms+1);
+  linkcells_->setCutoff(cutoff);
+  if(do_pbc_ && pbc_->isSet()) {
+    linkcells_->buildCellLists(cellpositions_,cellindices_,*pbc_);
+  } else {
+// without pbc, pairs found across the fictitious periodic boundaries are discarded when computing distances.
+    linkcells_->buildCellLists(cellpositions_,cellindices_);
+  }
+// pairs are stored in the same order as when looping over all possible pairs
+  const unsigned nloop=(twolists_ ? nlist0_ : positions.size());
+  for(unsigned i=0; i<nloop; ++i) {
+    findCloseAtoms(positions,i,(twolists_ ? nlist0_ : i+1));
+    for(const auto & j : closeatoms_) neighbors_.push_back(pair<unsigned,unsigned>(i,j));
+  }
+}
+
+void NeighborList::findCloseAtoms(const vector<Vector>& positions, unsigned index, unsigned first) {
+  const double d2=(distance_+skin_)*(distance_+skin_);
+// first element is the central atom, which is never returned
+  unsigned natoms=1;
+  cellatoms_[0]=index;
+  linkcells_->retrieveNeighboringAtoms(positions[index],cells_,natoms,cellatoms_);
+  closeatoms_.clear();
+  for(unsigned k=1; k<natoms; ++k) {
+    const unsigned j=cellatoms_[k];
+    if(j<first) continue;
+    Vector distance;
+    if(do_pbc_) {
+      distance=pbc_->distance(positions[index],positions[j]);
+    } else {
+      distance=delta(positions[index],positions[j]);
+    }
+    if(modulo2(distance)<=d2) closeatoms_.push_back(j);
+  }
+  std::sort(closeatoms_.begin(),closeatoms_.end());
 }
 
 void NeighborList::setRequestList() {
@@ -120,10 +205,12 @@ void NeighborList::setRequestList() {
     requestlist_.push_back(fullatomlist_[neighbors_[i].second]);
   }
   Tools::removeDuplicates(requestlist_);
+  requestindex_.clear();
   reduced=false;
 }
 
 vector<AtomNumber>& NeighborList::getReducedAtomList() {
+  if(!reduced && skin_>0.0) requestindex_.assign(requestlist_.size(),0);
   if(!reduced)for(unsigned int i=0; i<size(); ++i) {
       unsigned newindex0=0,newindex1=0;
       AtomNumber index0=fullatomlist_[neighbors_[i].first];
@@ -131,6 +218,10 @@ vector<AtomNumber>& NeighborList::getReducedAtomList() {
 // I exploit the fact that requestlist_ is an ordered vector
       auto p = std::find(requestlist_.begin(), requestlist_.end(), index0); plumed_assert(p!=requestlist_.end()); newindex0=p-requestlist_.begin();
       p = std::find(requestlist_.begin(), requestlist_.end(), index1); plumed_assert(p!=requestlist_.end()); newindex1=p-requestlist_.begin();
+      if(skin_>0.0) {
+        requestindex_[newindex0]=neighbors_[i].first;
+        requestindex_[newindex1]=neighbors_[i].second;
+      }
       neighbors_[i]=pair<unsigned,unsigned>(newindex0,newindex1);
     }
   reduced=true;
@@ -141,6 +232,10 @@ unsigned NeighborList::getStride() const {
   return stride_;
 }
 
+double NeighborList::getSkin() const {
+  return skin_;
+}
+
 unsigned NeighborList::getLastUpdate() const {
   return lastupdate_;
 }
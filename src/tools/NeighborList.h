@@ -25,14 +25,23 @@
 #include "Vector.h"
 #include "AtomNumber.h"
 
+#include <memory>
 #include <vector>
 
 namespace PLMD {
 
+class Communicator;
+class LinkCells;
 class Pbc;
 
 /// \ingroup TOOLBOX
 /// A class that implements neighbor lists from two lists or a single list of atoms
+///
+/// When a finite cutoff is used, the list is rebuilt using link cells, so that the cost
+/// of an update scales linearly with the number of atoms. Optionally, a Verlet skin can be used.
+/// In this case the list contains all the pairs closer than cutoff+skin and
+/// update() only rebuilds it when at least one atom has moved by more than
+/// half the skin since the last rebuild.
 class NeighborList
 {
   bool reduced;
@@ -42,8 +51,30 @@ class NeighborList
   std::vector<std::pair<unsigned,unsigned> > neighbors_;
   double distance_;
   unsigned stride_,nlist0_,nlist1_,nallpairs_,lastupdate_;
+/// Width of the Verlet skin
+  double skin_;
+/// Positions at the last rebuild, used to check displacements when skin_>0
+  std::vector<PLMD::Vector> lastpositions_;
+/// Index in fullatomlist_ of the atoms in requestlist_
+  std::vector<unsigned> requestindex_;
+/// Link cells used to rebuild the list.
+/// A serial communicator is used since all the atoms are available
+  std::unique_ptr<Communicator> serialcomm_;
+  std::unique_ptr<LinkCells> linkcells_;
+/// Work arrays for link cells
+  std::vector<PLMD::Vector> cellpositions_;
+  std::vector<unsigned> cellindices_,cells_,cellatoms_,closeatoms_;
 /// Initialize the neighbor list with all possible pairs
   void initialize();
+/// Check if the list should be rebuilt
+  bool needsRebuild(const std::vector<PLMD::Vector>& positions)const;
+/// Rebuild the list looping over all possible pairs
+  void updateAllPairs(const std::vector<PLMD::Vector>& positions);
+/// Rebuild the list using link cells
+  void updateLinkCells(const std::vector<PLMD::Vector>& positions);
+/// Collect in closeatoms_ the atoms with index larger or equal to first
+/// that are closer than the cutoff to the atom index
+  void findCloseAtoms(const std::vector<PLMD::Vector>& positions, unsigned index, unsigned first);
 /// Return the pair of indexes in the positions array
 /// of the two atoms forming the i-th pair among all possible pairs
   std::pair<unsigned,unsigned> getIndexPair(unsigned i);
@@ -53,10 +84,11 @@ public:
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const std::vector<PLMD::AtomNumber>& list1,
                const bool& do_pair, const bool& do_pbc, const PLMD::Pbc& pbc,
-               const double& distance=1.0e+30, const unsigned& stride=0);
+               const double& distance=1.0e+30, const unsigned& stride=0,
+               const double& skin=0.0);
   NeighborList(const std::vector<PLMD::AtomNumber>& list0, const bool& do_pbc,
                const PLMD::Pbc& pbc, const double& distance=1.0e+30,
-               const unsigned& stride=0);
+               const unsigned& stride=0, const double& skin=0.0);
 /// Return the list of all atoms. These are needed to rebuild the neighbor list.
   std::vector<PLMD::AtomNumber>& getFullAtomList();
 /// Update the indexes in the neighbor list to match the
@@ -64,10 +96,14 @@ public:
 /// and return the new list of atoms that must be requested to the main code
   std::vector<PLMD::AtomNumber>& getReducedAtomList();
 /// Update the neighbor list and prepare the new
-/// list of atoms that will be requested to the main code
-  void update(const std::vector<PLMD::Vector>& positions);
+/// list of atoms that will be requested to the main code.
+/// When a skin is used, the list is only rebuilt if needed.
+/// Returns true if the list was rebuilt
+  bool update(const std::vector<PLMD::Vector>& positions);
 /// Get the update stride of the neighbor list
   unsigned getStride() const;
+/// Get the width of the Verlet skin
+  double getSkin() const;
 /// Get the last step in which the neighbor list was updated
   unsigned getLastUpdate() const;
 /// Set the step of the last update
@@ -78,7 +114,7 @@ public:
   std::pair<unsigned,unsigned> getClosePair(unsigned i) const;
 /// Get the list of neighbors of the i-th atom
   std::vector<unsigned> getNeighbors(unsigned i);
-  ~NeighborList() {}
+  ~NeighborList();
 /// Get the i-th pair of AtomNumbers from the neighbor list
   std::pair<AtomNumber,AtomNumber> getClosePairAtomNumber(unsigned i) const;
 };
@@ -322,6 +322,12 @@ OFile& OFile::open(const std::string&path) {
   return *this;
 }
 
+OFile& OFile::writeBinary(const void*ptr,size_t size) {
+  plumed_massert(actual_buffer_length==0,"file " + getPath() + ": binary data cannot be written in the middle of a line");
+  llwrite(static_cast<const char*>(ptr),size);
+  return *this;
+}
+
 OFile& OFile::rewind() {
 // we use here "hard" rewind, which means close/reopen
 // the reason is that normal rewind does not work when in append mode
@@ -254,6 +254,9 @@ public:
 /// Formatted output with << operator
   template <class T>
   friend OFile& operator<<(OFile&,const T &);
+/// Write raw bytes (e.g. for binary files).
+/// It cannot be used when a line written with printf() has not been completed yet.
+  OFile& writeBinary(const void*ptr,size_t size);
 /// Rewind a file
   OFile&rewind();
 /// Flush a file
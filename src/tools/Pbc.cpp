@@ -26,6 +26,7 @@
 #include <iostream>
 #include "Random.h"
 #include <cmath>
+#include <algorithm>
 
 namespace PLMD {
 
@@ -173,7 +174,7 @@ void Pbc::apply(std::vector<Vector>& dlist, unsigned max_index) const {
     for(unsigned k=0; k<max_index; ++k) for(int i=0; i<3; i++) dlist[k][i]=Tools::pbc(dlist[k][i]*invBox(i,i))*box(i,i);
 #endif
   } else if(type==generic) {
-    for(unsigned k=0; k<max_index; ++k) dlist[k]=distance(Vector(0.0,0.0,0.0),dlist[k]);
+    distancesImpl([](std::size_t) {return Vector(0.0,0.0,0.0);},[&dlist](std::size_t k) {return dlist[k];},max_index,dlist.data());
   } else plumed_merror("unknown pbc type");
 }
 
@@ -201,27 +202,75 @@ Vector Pbc::distance(const Vector&v1,const Vector&v2,int*nshifts)const {
 // bring to -0.5,+0.5 region in scaled coordinates:
       for(int i=0; i<3; i++) s[i]=Tools::pbc(s[i]);
       d=matmul(s,reduced);
+      searchShifts(s,d,nshifts);
+    }
+  } else plumed_merror("unknown pbc type");
+  return d;
+}
+
+void Pbc::searchShifts(const Vector&s,Vector&d,int*nshifts)const {
 // check if shifts have to be attempted:
-      if((std::fabs(s[0])+std::fabs(s[1])+std::fabs(s[2])>0.5)) {
+  if((std::fabs(s[0])+std::fabs(s[1])+std::fabs(s[2])>0.5)) {
 // list of shifts is specific for that "octant" (depends on signs of s[i]):
-        const std::vector<Vector> & myshifts(shifts[(s[0]>0?1:0)][(s[1]>0?1:0)][(s[2]>0?1:0)]);
-        Vector best(d);
-        double lbest(modulo2(best));
+    const std::vector<Vector> & myshifts(shifts[(s[0]>0?1:0)][(s[1]>0?1:0)][(s[2]>0?1:0)]);
+    Vector best(d);
+    double lbest(modulo2(best));
 // loop over possible shifts:
-        if(nshifts) *nshifts+=myshifts.size();
-        for(unsigned i=0; i<myshifts.size(); i++) {
-          Vector trial=d+myshifts[i];
-          double ltrial=modulo2(trial);
-          if(ltrial<lbest) {
-            lbest=ltrial;
-            best=trial;
-          }
-        }
-        d=best;
+    if(nshifts) *nshifts+=myshifts.size();
+    for(unsigned i=0; i<myshifts.size(); i++) {
+      Vector trial=d+myshifts[i];
+      double ltrial=modulo2(trial);
+      if(ltrial<lbest) {
+        lbest=ltrial;
+        best=trial;
       }
     }
+    d=best;
+  }
+}
+
+template<class P1,class P2>
+void Pbc::distancesImpl(P1 p1,P2 p2,std::size_t n,Vector*d)const {
+  if(type==unset) {
+    #pragma omp simd
+    for(std::size_t k=0; k<n; k++) d[k]=delta(p1(k),p2(k));
+  } else if(type==orthorombic) {
+#ifdef __PLUMED_PBC_WHILE
+    for(std::size_t k=0; k<n; k++) d[k]=distance(p1(k),p2(k));
+#else
+    const Vector b(box(0,0),box(1,1),box(2,2));
+    const Vector ib(invBox(0,0),invBox(1,1),invBox(2,2));
+    #pragma omp simd
+    for(std::size_t k=0; k<n; k++) {
+      const Vector dd=delta(p1(k),p2(k));
+      for(int i=0; i<3; i++) d[k][i]=Tools::pbc(dd[i]*ib[i])*b[i];
+    }
+#endif
+  } else if(type==generic) {
+// pairs are processed in chunks: first all of them are brought to the -0.5,+0.5
+// region in scaled coordinates (vectorized), then shifts are attempted where needed
+    const std::size_t chunk=64;
+    Vector s[chunk];
+    for(std::size_t k0=0; k0<n; k0+=chunk) {
+      const std::size_t m=std::min(chunk,n-k0);
+      #pragma omp simd
+      for(std::size_t k=0; k<m; k++) {
+        Vector ss=matmul(delta(p1(k0+k),p2(k0+k)),invReduced);
+        for(int i=0; i<3; i++) ss[i]=Tools::pbc(ss[i]);
+        s[k]=ss;
+        d[k0+k]=matmul(ss,reduced);
+      }
+      for(std::size_t k=0; k<m; k++) searchShifts(s[k],d[k0+k],NULL);
+    }
   } else plumed_merror("unknown pbc type");
-  return d;
+}
+
+void Pbc::distances(const Vector*v1,const Vector*v2,std::size_t n,Vector*d)const {
+  distancesImpl([v1](std::size_t k) {return v1[k];},[v2](std::size_t k) {return v2[k];},n,d);
+}
+
+void Pbc::distances(const Vector*pos,const unsigned*i1,const unsigned*i2,std::size_t n,Vector*d)const {
+  distancesImpl([pos,i1](std::size_t k) {return pos[i1[k]];},[pos,i2](std::size_t k) {return pos[i2[k]];},n,d);
 }
 
 Vector Pbc::realToScaled(const Vector&d)const {
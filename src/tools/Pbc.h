@@ -62,6 +62,12 @@ class Pbc {
 /// depending on the sign of the scaled coordinates representing
 /// a distance vector.
   void buildShifts(std::vector<Vector> shifts[2][2][2])const;
+/// Search the shortest image of d among the shifts appropriate for scaled coordinates s.
+/// Only used for generic boxes.
+  void searchShifts(const Vector&s,Vector&d,int*nshifts)const;
+/// Implementation of distances(); positions are accessed through p1(k) and p2(k)
+  template<class P1,class P2>
+  void distancesImpl(P1 p1,P2 p2,std::size_t n,Vector*d)const;
 public:
 /// Constructor
   Pbc();
@@ -72,6 +78,12 @@ public:
 /// version of distance which also returns the number
 /// of attempted shifts
   Vector distance(const Vector&,const Vector&,int*nshifts)const;
+/// Computes v2[k]-v1[k] for k=0..n-1, using minimal image convention, and stores them in d[k].
+/// Results are identical to those of distance(), but the loop is vectorized.
+  void distances(const Vector*v1,const Vector*v2,std::size_t n,Vector*d)const;
+/// Computes pos[i2[k]]-pos[i1[k]] for k=0..n-1, using minimal image convention, and stores them in d[k].
+/// Useful for lists of pairs of atoms, e.g. from a NeighborList.
+  void distances(const Vector*pos,const unsigned*i1,const unsigned*i2,std::size_t n,Vector*d)const;
 /// Apply PBC to a set of positions or distance vectors
   void apply(std::vector<Vector>&dlist, unsigned max_index=0) const;
 /// Set the lattice vectors.
@@ -25,6 +25,7 @@
 #include "Exception.h"
 #include <cmath>
 #include <iostream>
+#include <algorithm>
 #include "Tools.h"
 using namespace std;
 namespace PLMD {
@@ -409,6 +410,132 @@ double RMSD::simpleAlignment(const  std::vector<double>  & align,
 
 // this below enable the standard case for rmsd where the rmsd is calculated and the derivative of rmsd respect to positions is retrieved
 // additionally this assumes that the com of the reference is already subtracted.
+namespace {
+/// Adjugate of a 4x4 matrix, computed from its 2x2 minors. Returns the determinant.
+double adjugate4(const Tensor4d& a,Tensor4d& adj) {
+  const double s0=a[0][0]*a[1][1]-a[1][0]*a[0][1];
+  const double s1=a[0][0]*a[1][2]-a[1][0]*a[0][2];
+  const double s2=a[0][0]*a[1][3]-a[1][0]*a[0][3];
+  const double s3=a[0][1]*a[1][2]-a[1][1]*a[0][2];
+  const double s4=a[0][1]*a[1][3]-a[1][1]*a[0][3];
+  const double s5=a[0][2]*a[1][3]-a[1][2]*a[0][3];
+  const double c5=a[2][2]*a[3][3]-a[3][2]*a[2][3];
+  const double c4=a[2][1]*a[3][3]-a[3][1]*a[2][3];
+  const double c3=a[2][1]*a[3][2]-a[3][1]*a[2][2];
+  const double c2=a[2][0]*a[3][3]-a[3][0]*a[2][3];
+  const double c1=a[2][0]*a[3][2]-a[3][0]*a[2][2];
+  const double c0=a[2][0]*a[3][1]-a[3][0]*a[2][1];
+  adj[0][0]=+a[1][1]*c5-a[1][2]*c4+a[1][3]*c3;
+  adj[0][1]=-a[0][1]*c5+a[0][2]*c4-a[0][3]*c3;
+  adj[0][2]=+a[3][1]*s5-a[3][2]*s4+a[3][3]*s3;
+  adj[0][3]=-a[2][1]*s5+a[2][2]*s4-a[2][3]*s3;
+  adj[1][0]=-a[1][0]*c5+a[1][2]*c2-a[1][3]*c1;
+  adj[1][1]=+a[0][0]*c5-a[0][2]*c2+a[0][3]*c1;
+  adj[1][2]=-a[3][0]*s5+a[3][2]*s2-a[3][3]*s1;
+  adj[1][3]=+a[2][0]*s5-a[2][2]*s2+a[2][3]*s1;
+  adj[2][0]=+a[1][0]*c4-a[1][1]*c2+a[1][3]*c0;
+  adj[2][1]=-a[0][0]*c4+a[0][1]*c2-a[0][3]*c0;
+  adj[2][2]=+a[3][0]*s4-a[3][1]*s2+a[3][3]*s0;
+  adj[2][3]=-a[2][0]*s4+a[2][1]*s2-a[2][3]*s0;
+  adj[3][0]=-a[1][0]*c3+a[1][1]*c1-a[1][2]*c0;
+  adj[3][1]=+a[0][0]*c3-a[0][1]*c1+a[0][2]*c0;
+  adj[3][2]=-a[3][0]*s3+a[3][1]*s1-a[3][2]*s0;
+  adj[3][3]=+a[2][0]*s3-a[2][1]*s1+a[2][2]*s0;
+  return s0*c5-s1*c4+s2*c3+s3*c2-s4*c1+s5*c0;
+}
+
+/// Eigenvector of m for the (simple) eigenvalue eval, taken from the largest column of adj(m-eval).
+/// Returns false if the eigenvalue is nearly degenerate, i.e. if the adjugate nearly vanishes.
+bool adjugateEigenvector(const Tensor4d& m,double eval,double scale3,Vector4d& q) {
+  Tensor4d a(m),adj;
+  for(unsigned i=0; i<4; i++) a[i][i]-=eval;
+  adjugate4(a,adj);
+// the adjugate is g*q*q^T, where g is the product of the gaps to the other eigenvalues
+  unsigned imax=0;
+  for(unsigned i=1; i<4; i++) if(adj[i][i]>adj[imax][imax]) imax=i;
+  if(!(adj[imax][imax]>1e-6*scale3)) return false;
+  for(unsigned i=0; i<4; i++) q[i]=adj[i][imax];
+  q/=q.modulo();
+  return true;
+}
+}
+
+double RMSD::lowestQuaternion(const Tensor4d& m, double lower, Vector4d& q, Tensor4d* resolvent) {
+// scale of the eigenvalues, from Gershgorin circles
+  double scale=0.0;
+  for(unsigned i=0; i<4; i++) {
+    double row=0.0;
+    for(unsigned j=0; j<4; j++) row+=std::fabs(m[i][j]);
+    scale=std::max(scale,row);
+  }
+  double eval=std::max(lower,-scale);
+  bool found=false;
+  if(scale>0.0) {
+// characteristic polynomial det(x-m) = x^4 - e1 x^3 + e2 x^2 - e3 x + e4
+    const Tensor4d m2=matmul(m,m);
+    double tr1=0.0,tr2=0.0,tr3=0.0;
+    for(unsigned i=0; i<4; i++) {
+      tr1+=m[i][i];
+      tr2+=m2[i][i];
+      for(unsigned j=0; j<4; j++) tr3+=m2[i][j]*m[j][i];
+    }
+    Tensor4d adj;
+    const double e1=tr1;
+    const double e2=0.5*(tr1*tr1-tr2);
+    const double e3=(tr1*tr1*tr1-3.0*tr1*tr2+2.0*tr3)/6.0;
+    const double e4=adjugate4(m,adj);
+// Newton's method from a lower bound converges monotonically to the smallest root,
+// since the polynomial is convex below it
+    for(unsigned iter=0; iter<100; iter++) {
+      const double p=(((eval-e1)*eval+e2)*eval-e3)*eval+e4;
+      const double dp=((4.0*eval-3.0*e1)*eval+2.0*e2)*eval-e3;
+      if(dp==0.0) break;
+      const double step=p/dp;
+      eval-=step;
+      if(std::fabs(step)<=1e-11*scale) {found=true; break;}
+    }
+// the eigenvalue is then refined with the Rayleigh quotient of the eigenvector
+    const double scale3=scale*scale*scale;
+    if(found) found=adjugateEigenvector(m,eval,scale3,q);
+    if(found) {
+      eval=matmul(q,matmul(m,q));
+      found=adjugateEigenvector(m,eval,scale3,q);
+    }
+    if(found && resolvent) {
+// sum_l v_l v_l^T/(lambda_0-lambda_l) = q q^T - (m - lambda_0 + q q^T)^-1
+      Tensor4d b(m);
+      for(unsigned i=0; i<4; i++) for(unsigned j=0; j<4; j++) b[i][j]+=q[i]*q[j]-(i==j?eval:0.0);
+      const double det=adjugate4(b,adj);
+      for(unsigned i=0; i<4; i++) for(unsigned j=0; j<4; j++) (*resolvent)[i][j]=q[i]*q[j]-adj[i][j]/det;
+    }
+  }
+  if(found) {
+// same phase convention as diagMatSym
+    unsigned j=0;
+    for(j=0; j<4; j++) if(q[j]*q[j]>1e-14) break;
+    if(j<4) if(q[j]<0.0) q*=-1.0;
+    return eval;
+  }
+// nearly degenerate eigenvalues
+  if(resolvent) {
+    Vector4d eigenvals;
+    Tensor4d eigenvecs;
+    diagMatSym(m, eigenvals, eigenvecs );
+    for(unsigned i=0; i<4; i++) for(unsigned j=0; j<4; j++) {
+        double tmp=0.0;
+        for(unsigned l=1; l<4; l++) tmp+=eigenvecs[l][j]*eigenvecs[l][i]/(eigenvals[0]-eigenvals[l]);
+        (*resolvent)[i][j]=tmp;
+      }
+    q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
+    return eigenvals[0];
+  }
+  VectorGeneric<1> eigenvals;
+  TensorGeneric<1,4> eigenvecs;
+  diagMatSym(m, eigenvals, eigenvecs );
+  q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
+  return eigenvals[0];
+}
+
 #define OLDRMSD
 #ifdef OLDRMSD
 // notice that in the current implementation the safe argument only makes sense for
@@ -488,32 +615,19 @@ double RMSD::optimalAlignment(const  std::vector<double>  & align,
 
   Tensor dq_drr01[4];
   if(!alEqDis) {
-    Vector4d eigenvals;
-    Tensor4d eigenvecs;
-    diagMatSym(m, eigenvals, eigenvecs );
-    dist=eigenvals[0]+rr00+rr11;
-    q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
-    double dq_dm[4][4][4];
-    for(unsigned i=0; i<4; i++) for(unsigned j=0; j<4; j++) for(unsigned k=0; k<4; k++) {
-          double tmp=0.0;
-// perturbation theory for matrix m
-          for(unsigned l=1; l<4; l++) tmp+=eigenvecs[l][j]*eigenvecs[l][i]/(eigenvals[0]-eigenvals[l])*eigenvecs[0][k];
-          dq_dm[i][j][k]=tmp;
-        }
+    Tensor4d resolvent;
+    dist=lowestQuaternion(m,-(rr00+rr11),q,&resolvent)+rr00+rr11;
+// perturbation theory for matrix m: dq_i/dm_jk = resolvent_ij q_k
+    Tensor dm_drr01_q[4];
+    for(unsigned j=0; j<4; j++) for(unsigned k=0; k<4; k++) dm_drr01_q[j]+=q[k]*dm_drr01[j][k];
 // propagation to _drr01
     for(unsigned i=0; i<4; i++) {
       Tensor tmp;
-      for(unsigned j=0; j<4; j++) for(unsigned k=0; k<4; k++) {
-          tmp+=dq_dm[i][j][k]*dm_drr01[j][k];
-        }
+      for(unsigned j=0; j<4; j++) tmp+=resolvent[i][j]*dm_drr01_q[j];
       dq_drr01[i]=tmp;
     }
   } else {
-    VectorGeneric<1> eigenvals;
-    TensorGeneric<1,4> eigenvecs;
-    diagMatSym(m, eigenvals, eigenvecs );
-    dist=eigenvals[0]+rr00+rr11;
-    q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
+    dist=lowestQuaternion(m,-(rr00+rr11),q)+rr00+rr11;
   }
 
 
@@ -1025,31 +1139,21 @@ void RMSDCoreData::doCoreCalc(bool safe,bool alEqDis, bool only_rotation) {
 
   Tensor dq_drr01[4];
   if(!alEqDis or !only_rotation) {
-    diagMatSym(m, eigenvals, eigenvecs );
-    q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
-    double dq_dm[4][4][4];
-    for(unsigned i=0; i<4; i++) for(unsigned j=0; j<4; j++) for(unsigned k=0; k<4; k++) {
-          double tmp=0.0;
-// perturbation theory for matrix m
-          for(unsigned l=1; l<4; l++) tmp+=eigenvecs[l][j]*eigenvecs[l][i]/(eigenvals[0]-eigenvals[l])*eigenvecs[0][k];
-          dq_dm[i][j][k]=tmp;
-        }
+    Tensor4d resolvent;
+    eigenvals[0]=RMSD::lowestQuaternion(m,-(rr00+rr11),q,&resolvent);
+// perturbation theory for matrix m: dq_i/dm_jk = resolvent_ij q_k
+    Tensor dm_drr01_q[4];
+    for(unsigned j=0; j<4; j++) for(unsigned k=0; k<4; k++) dm_drr01_q[j]+=q[k]*dm_drr01[j][k];
 // propagation to _drr01
     for(unsigned i=0; i<4; i++) {
       Tensor tmp;
-      for(unsigned j=0; j<4; j++) for(unsigned k=0; k<4; k++) {
-          tmp+=dq_dm[i][j][k]*dm_drr01[j][k];
-        }
+      for(unsigned j=0; j<4; j++) tmp+=resolvent[i][j]*dm_drr01_q[j];
       dq_drr01[i]=tmp;
     }
   } else {
-    TensorGeneric<1,4> here_eigenvecs;
-    VectorGeneric<1> here_eigenvals;
-    diagMatSym(m, here_eigenvals, here_eigenvecs );
-    for(unsigned i=0; i<4; i++) eigenvecs[0][i]=here_eigenvecs[0][i];
-    eigenvals[0]=here_eigenvals[0];
-    q=Vector4d(eigenvecs[0][0],eigenvecs[0][1],eigenvecs[0][2],eigenvecs[0][3]);
+    eigenvals[0]=RMSD::lowestQuaternion(m,-(rr00+rr11),q);
   }
+  for(unsigned i=0; i<4; i++) eigenvecs[0][i]=q[i];
 
 // This is the rotation matrix that brings reference to positions
 // i.e. matmul(rotation,reference[iat])+shift is fitted to positions[iat]
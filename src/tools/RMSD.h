@@ -247,6 +247,15 @@ public:
   double calc_Rot( const std::vector<Vector>& positions, std::vector<Vector> &DDistDPos, Tensor & Rotation, const bool squared=false   );
 ///calculate with close structure, i.e. approximate the RMSD without expensive computation of rotation matrix by reusing saved rotation matrices from previous iterations
   double calculateWithCloseStructure( const std::vector<Vector>& positions, std::vector<Vector> &DDistDPos, Tensor & rotationPosClose, Tensor & rotationRefClose, std::array<std::array<Tensor,3>,3> & drotationPosCloseDrr01, const bool squared=false   );
+/// Lowest eigenvalue of the symmetric 4x4 matrix m used in optimal alignments, and the corresponding
+/// eigenvector q (the quaternion of the rotation). lower must be a lower bound for the eigenvalue,
+/// e.g. minus the sum of the second moments of positions and reference.
+/// The eigenvalue is the smallest root of the characteristic polynomial, found with Newton's method,
+/// and the eigenvector is obtained from the adjugate of m minus the eigenvalue. LAPACK is only used for
+/// nearly degenerate eigenvalues.
+/// If resolvent is not null, it is set to sum_l v_l v_l^T/(lambda_0-lambda_l), where the sum runs
+/// over the other eigenvectors. This is the matrix needed to compute derivatives of q.
+  static double lowestQuaternion(const Tensor4d& m, double lower, Vector4d& q, Tensor4d* resolvent=nullptr);
 /// static convenience method to get the matrix i,a from drotdpos (which is a bit tricky)
   static  Tensor getMatrixFromDRot(Matrix< std::vector<Vector> > &drotdpos, const unsigned &i, const unsigned &a) {
     Tensor t;
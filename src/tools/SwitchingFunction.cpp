@@ -182,6 +182,13 @@ void SwitchingFunction::registerKeywords( Keywords& keys ) {
   keys.add("compulsory","B","the value of b in the switching function (only needed for TYPE=SMAP)");
 }
 
+/// True if the lepton expression starting at node contains the variable name
+static bool leptonUsesVariable(const lepton::ExpressionTreeNode & node,const std::string & name) {
+  if(node.getOperation().getId()==lepton::Operation::VARIABLE && node.getOperation().getName()==name) return true;
+  for(const auto & c : node.getChildren()) if(leptonUsesVariable(c,name)) return true;
+  return false;
+}
+
 void SwitchingFunction::set(const std::string & definition,std::string& errormsg) {
   vector<string> data=Tools::getWords(definition);
   if( data.size()<1 ) {
@@ -265,39 +272,29 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
     Tools::parse(data,"FUNC",func);
     lepton::ParsedExpression pe=lepton::Parser::parse(func).optimize(lepton::Constants());
     lepton_func=func;
+    std::string arg="x";
+// if lepton only uses x2, the square root can be avoided (see calculateSqr())
+    if(!leptonUsesVariable(pe.getRootNode(),"x") && leptonUsesVariable(pe.getRootNode(),"x2")) {
+      leptonx2=true;
+      arg="x2";
+    }
+    lepton::ParsedExpression ped=lepton::Parser::parse(func).differentiate(arg).optimize(lepton::Constants());
+// function and derivative are compiled together, so that
+// subexpressions they have in common are only computed once
+    const std::vector<lepton::ParsedExpression> pes{pe,ped};
     expression.resize(OpenMP::getNumThreads());
-    for(auto & e : expression) e=pe.createCompiledExpression();
+    for(auto & e : expression) e=lepton::CompiledExpression(pes);
     lepton_ref.resize(expression.size());
+    arrayBuffers.resize(expression.size());
     for(unsigned t=0; t<lepton_ref.size(); t++) {
       try {
-        lepton_ref[t]=&const_cast<lepton::CompiledExpression*>(&expression[t])->getVariableReference("x");
+        lepton_ref[t]=&expression[t].getVariableReference(arg);
       } catch(const PLMD::lepton::Exception& exc) {
-        try {
-          lepton_ref[t]=&const_cast<lepton::CompiledExpression*>(&expression[t])->getVariableReference("x2");
-          leptonx2=true;
-        } catch(const PLMD::lepton::Exception& exc) {
 // this is necessary since in some cases lepton things a variable is not present even though it is present
 // e.g. func=0*x
-          lepton_ref[t]=nullptr;
-        }
+        lepton_ref[t]=nullptr;
       }
     }
-    std::string arg="x";
-    if(leptonx2) arg="x2";
-    lepton::ParsedExpression ped=lepton::Parser::parse(func).differentiate(arg).optimize(lepton::Constants());
-    expression_deriv.resize(OpenMP::getNumThreads());
-    for(auto & e : expression_deriv) e=ped.createCompiledExpression();
-    lepton_ref_deriv.resize(expression_deriv.size());
-    for(unsigned t=0; t<lepton_ref_deriv.size(); t++) {
-      try {
-        lepton_ref_deriv[t]=&const_cast<lepton::CompiledExpression*>(&expression_deriv[t])->getVariableReference(arg);
-      } catch(const PLMD::lepton::Exception& exc) {
-// this is necessary since in some cases lepton things a variable is not present even though it is present
-// e.g. func=3*x
-        lepton_ref_deriv[t]=nullptr;
-      }
-    }
-
   }
   else errormsg="cannot understand switching function type '"+name+"'";
   if( !data.empty() ) {
@@ -404,9 +401,9 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
     const double rdist_2 = distance2*invr0_2;
     plumed_assert(t<expression.size());
     if(lepton_ref[t]) *lepton_ref[t]=rdist_2;
-    if(lepton_ref_deriv[t]) *lepton_ref_deriv[t]=rdist_2;
-    double result=expression[t].evaluate();
-    dfunc=expression_deriv[t].evaluate();
+    const auto & res=expression[t].evaluateAll();
+    double result=res[0];
+    dfunc=res[1];
 // chain rule:
     dfunc*=2*invr0_2;
 // stretch:
@@ -419,6 +416,59 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
   }
 }
 
+void SwitchingFunction::calculateSqr(const double* distance2,double* result,double* dfunc,unsigned n)const {
+  const unsigned t=OpenMP::getThreadNum();
+// only lepton functions of x (or x2) are evaluated in a single call
+  if(type!=leptontype || t>=expression.size() || expression[t].getVariables().size()!=(lepton_ref[t]?1:0)) {
+    for(unsigned k=0; k<n; k++) result[k]=calculateSqr(distance2[k],dfunc[k]);
+    return;
+  }
+  plumed_massert(init,"you are trying to use an unset SwitchingFunction");
+// arguments of the lepton function, only for the distances where it has to be evaluated
+  auto & index=arrayBuffers[t].index;
+  auto & x=arrayBuffers[t].x;
+  index.clear();
+  x.clear();
+  for(unsigned k=0; k<n; k++) {
+    result[k]=0.0;
+    dfunc[k]=0.0;
+    if(leptonx2) {
+      if(distance2[k]>dmax_2) continue;
+      x.push_back(distance2[k]*invr0_2);
+    } else {
+      const double distance=std::sqrt(distance2[k]);
+      if(distance>dmax) continue;
+      const double rdist=(distance-d0)*invr0;
+      if(rdist<=0.) {
+        result[k]=stretch+shift;
+        continue;
+      }
+      x.push_back(rdist);
+    }
+    index.push_back(k);
+  }
+  auto & f=arrayBuffers[t].f;
+  auto & df=arrayBuffers[t].df;
+  f.resize(x.size());
+  df.resize(x.size());
+  const double* var[1]= {x.data()};
+  double* res[2]= {f.data(),df.data()};
+  expression[t].evaluateArrays(x.size(),var,res);
+  for(unsigned m=0; m<index.size(); m++) {
+    const unsigned k=index[m];
+    double d=df[m];
+// chain rule, as in calculateSqr() and calculate():
+    if(leptonx2) {
+      d*=2*invr0_2;
+    } else {
+      d*=invr0;
+      d/=std::sqrt(distance2[k]);
+    }
+    result[k]=f[m]*stretch+shift;
+    dfunc[k]=d*stretch;
+  }
+}
+
 double SwitchingFunction::calculate(double distance,double&dfunc)const {
   plumed_massert(init,"you are trying to use an unset SwitchingFunction");
   if(distance>dmax) {
@@ -482,9 +532,9 @@ double SwitchingFunction::calculate(double distance,double&dfunc)const {
       const unsigned t=OpenMP::getThreadNum();
       plumed_assert(t<expression.size());
       if(lepton_ref[t]) *lepton_ref[t]=rdist;
-      if(lepton_ref_deriv[t]) *lepton_ref_deriv[t]=rdist;
-      result=expression[t].evaluate();
-      dfunc=expression_deriv[t].evaluate();
+      const auto & res=expression[t].evaluateAll();
+      result=res[0];
+      dfunc=res[1];
     } else plumed_merror("Unknown switching function type");
 // this is for the chain rule:
     dfunc*=invr0;
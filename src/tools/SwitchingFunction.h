@@ -75,14 +75,16 @@ class SwitchingFunction {
   double do_rational(double rdist,double&dfunc,int nn,int mm)const;
 /// Function for lepton;
   std::string lepton_func;
-/// Lepton expression.
+/// Lepton expression, computing both the function and its derivative.
 /// \warning Since lepton::CompiledExpression is mutable, a vector is necessary for multithreading!
   std::vector<lepton::CompiledExpression> expression;
-/// Lepton expression for derivative
-/// \warning Since lepton::CompiledExpression is mutable, a vector is necessary for multithreading!
-  std::vector<lepton::CompiledExpression> expression_deriv;
   std::vector<double*> lepton_ref;
-  std::vector<double*> lepton_ref_deriv;
+/// Buffers used when lepton is evaluated on arrays, one per thread as for expression
+  struct ArrayBuffers {
+    std::vector<unsigned> index;
+    std::vector<double> x,f,df;
+  };
+  mutable std::vector<ArrayBuffers> arrayBuffers;
 /// Set to true for fast rational functions (depending on x**2 only)
   bool fastrational=false;
 /// Set to true if lepton only uses x2
@@ -110,6 +112,10 @@ public:
 /// The advantage is that in some case the expensive square root can be avoided
 /// (namely for rational functions, if nn and mm are even and d0 is zero)
   double calculateSqr(double distance2,double&dfunc)const;
+/// Compute the switching function for n squared distances.
+/// Results and derivatives are the same as those of calculateSqr(), but lepton
+/// functions are evaluated on all the distances with a single call.
+  void calculateSqr(const double* distance2,double* result,double* dfunc,unsigned n)const;
 /// Returns d0
   double get_d0() const;
 /// Returns r0
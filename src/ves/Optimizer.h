@@ -157,6 +157,7 @@ protected:
   void setupOFiles(std::vector<std::string>&, std::vector<OFile*>&, const bool multi_sim_single_files=false);
 public:
   static void registerKeywords(Keywords&);
+  bool dependsOnPreviousSteps()const override {return true;}
   static void useMultipleWalkersKeywords(Keywords&);
   static void useHessianKeywords(Keywords&);
   static void useFixedStepSizeKeywords(Keywords&);
@@ -146,6 +146,7 @@ protected:
   //
 public:
   static void registerKeywords(Keywords&);
+  bool dependsOnPreviousSteps()const override {return true;}
   explicit VesBias(const ActionOptions&ao);
   ~VesBias();
   //
@@ -77,6 +77,7 @@ protected:
   bool storeThenAverage() const ;
 public:
   static void registerKeywords( Keywords& keys );
+  bool dependsOnPreviousSteps()const override {return true;}
   explicit ActionWithAveraging( const ActionOptions& );
   void lockRequests() override;
   void unlockRequests() override;
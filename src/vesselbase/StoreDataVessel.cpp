@@ -24,6 +24,8 @@
 namespace PLMD {
 namespace vesselbase {
 
+const unsigned StoreDataVessel::nostore;
+
 void StoreDataVessel::registerKeywords( Keywords& keys ) {
   Vessel::registerKeywords(keys); keys.remove("LABEL");
 }
@@ -32,7 +34,9 @@ StoreDataVessel::StoreDataVessel( const VesselOptions& da ):
   Vessel(da),
   max_lowmem_stash(3),
   vecsize(0),
-  nspace(0)
+  nspace(0),
+  der_list_size(0),
+  gathered_der(NULL)
 {
   ActionWithValue* myval=dynamic_cast<ActionWithValue*>( getAction() );
   if( !myval ) hasderiv=false;
@@ -46,18 +50,21 @@ void StoreDataVessel::addActionThatUses( ActionWithVessel* actionThatUses ) {
 void StoreDataVessel::resize() {
   if( getAction()->lowmem || !getAction()->derivativesAreRequired() ) {
     nspace = 1;
-    active_der.resize( max_lowmem_stash * ( 1 + getAction()->getNumberOfDerivatives() ) );
+    der_list_size = max_lowmem_stash * ( 1 + getAction()->getNumberOfDerivatives() );
   } else {
     if( getAction()->getNumberOfDerivatives()>getAction()->maxderivatives ) {
       error("not enough memory to store derivatives for action " + getAction()->getLabel() + " use LOWMEM option");
     }
     nspace = 1 + getAction()->maxderivatives;
-    active_der.resize( getNumberOfStoredValues() * ( 1 + getAction()->maxderivatives ) );
+    der_list_size = getNumberOfStoredValues() * ( 1 + getAction()->maxderivatives );
   }
   vecsize=getAction()->getNumberOfQuantities();
   plumed_dbg_assert( vecsize>0 );
   resizeBuffer( getNumberOfStoredValues()*vecsize*nspace );
-  local_buffer.resize( getNumberOfStoredValues()*vecsize*nspace );
+  if( store_slot.size()!=getNumberOfStoredValues() ) {
+    store_slot.assign( getNumberOfStoredValues(), nostore ); slot_elem.resize(0);
+    local_values.resize(0); der_start.assign( 1, 0 ); active_der.resize(0); local_derivs.resize(0);
+  }
 }
 
 void StoreDataVessel::storeValues( const unsigned& myelem, MultiValue& myvals, std::vector<double>& buffer ) const {
@@ -101,9 +108,10 @@ void StoreDataVessel::storeDerivatives( const unsigned& myelem, MultiValue& myva
 }
 
 void StoreDataVessel::retrieveSequentialValue( const unsigned& jelem, const bool& normed, std::vector<double>& values ) const {
-  plumed_dbg_assert( values.size()==vecsize );
-  unsigned ibuf = jelem * vecsize * nspace;
-  for(unsigned i=0; i<vecsize; ++i) { values[i]=local_buffer[ibuf]; ibuf+=nspace; }
+  plumed_dbg_assert( values.size()==vecsize && jelem<store_slot.size() );
+  unsigned islot = store_slot[jelem];
+  if( islot==nostore ) { for(unsigned i=0; i<vecsize; ++i) values[i]=0.0; }
+  else { for(unsigned i=0; i<vecsize; ++i) values[i]=local_values[islot*vecsize+i]; }
   if( normed && values.size()>2 ) getAction()->normalizeVector( values );
 }
 
@@ -115,32 +123,45 @@ void StoreDataVessel::retrieveValueWithIndex( const unsigned& myelem, const bool
 
 double StoreDataVessel::retrieveWeightWithIndex( const unsigned& myelem ) const {
   plumed_dbg_assert( vecsize>0 );
-  unsigned jelem = getStoreIndex( myelem ); unsigned ibuf = jelem * vecsize * nspace; return local_buffer[ibuf];
+  unsigned islot = store_slot[ getStoreIndex( myelem ) ];
+  if( islot==nostore ) return 0.0;
+  return local_values[islot*vecsize];
 }
 
 void StoreDataVessel::retrieveDerivatives( const unsigned& myelem, const bool& normed, MultiValue& myvals ) {
   plumed_dbg_assert( myvals.getNumberOfValues()==vecsize && myvals.getNumberOfDerivatives()==getAction()->getNumberOfDerivatives() );
 
-  myvals.clearAll();
   if( getAction()->lowmem ) {
+    myvals.clearAll();
     recalculateStoredQuantity( myelem, myvals );
     if( normed ) getAction()->normalizeVectorDerivatives( myvals );
   } else {
-    unsigned jelem = getAction()->getPositionInCurrentTaskList( myelem );
+    retrieveSequentialDerivatives( getAction()->getPositionInCurrentTaskList( myelem ), normed, myvals );
+  }
+}
+
+void StoreDataVessel::retrieveSequentialDerivatives( const unsigned& jelem, const bool& normed, MultiValue& myvals ) {
+  plumed_dbg_assert( myvals.getNumberOfValues()==vecsize && myvals.getNumberOfDerivatives()==getAction()->getNumberOfDerivatives() );
+
+  myvals.clearAll();
+  if( getAction()->lowmem ) {
+    recalculateStoredQuantity( getTrueIndex( jelem ), myvals );
+    if( normed ) getAction()->normalizeVectorDerivatives( myvals );
+  } else {
+    // Values that are zero are not in the compressed store and have no derivatives
+    unsigned islot = store_slot[jelem], kstart=0, nder=0;
+    if( islot!=nostore ) { kstart=der_start[islot]; nder=der_start[islot+1]-kstart; }
     // Retrieve the derivatives for elements 0 and 1 - weight and norm
     for(unsigned icomp=0; icomp<vecsize; ++icomp) {
-      unsigned ibuf = jelem * ( vecsize*nspace ) + icomp*nspace + 1;
-      unsigned kder = getNumberOfStoredValues() + jelem * ( nspace - 1 );
-      for(unsigned j=0; j<active_der[jelem]; ++j) {
-        myvals.addDerivative( icomp, active_der[kder], local_buffer[ibuf] );
-        kder++; ibuf++;
+      unsigned ibuf = vecsize*kstart + icomp*nder;
+      for(unsigned j=0; j<nder; ++j) {
+        myvals.addDerivative( icomp, active_der[kstart+j], local_derivs[ibuf] ); ibuf++;
       }
     }
     if( normed ) getAction()->normalizeVectorDerivatives( myvals );
     // Now ensure appropriate parts of list are activated
     myvals.emptyActiveMembers();
-    unsigned kder = getNumberOfStoredValues() + jelem * ( nspace - 1 );
-    for(unsigned j=0; j<active_der[jelem]; ++j) { myvals.putIndexInActiveArray( active_der[kder] ); kder++; }
+    for(unsigned j=0; j<nder; ++j) myvals.putIndexInActiveArray( active_der[kstart+j] );
     myvals.sortActiveList();
   }
 }
@@ -156,15 +177,38 @@ void StoreDataVessel::calculate( const unsigned& current, MultiValue& myvals, st
 }
 
 void StoreDataVessel::finish( const std::vector<double>& buffer ) {
-  // Store the buffer locally
-  for(unsigned i=0; i<local_buffer.size(); ++i) local_buffer[i]=buffer[bufstart+i];
+  // Store the non-zero values and their derivatives locally. Only the values that are zero are
+  // dropped, so that the values retrieved are exactly those in the buffer. The buffer itself is
+  // still sized by the number of tasks, so the cost of this loop and of the reduction scale with it
+  store_slot.assign( getNumberOfStoredValues(), nostore ); slot_elem.resize(0);
+  local_values.resize(0); der_start.assign( 1, 0 ); active_der.resize(0); local_derivs.resize(0);
+  for(unsigned jelem=0; jelem<getNumberOfStoredValues(); ++jelem) {
+    unsigned ibuf = bufstart + jelem * vecsize * nspace;
+    bool nonzero=false;
+    for(unsigned icomp=0; icomp<vecsize; ++icomp) if( buffer[ibuf+icomp*nspace]!=0.0 ) { nonzero=true; break; }
+    if( !nonzero ) continue;
+    store_slot[jelem]=slot_elem.size(); slot_elem.push_back( jelem );
+    for(unsigned icomp=0; icomp<vecsize; ++icomp) local_values.push_back( buffer[ibuf+icomp*nspace] );
+    if( gathered_der ) compressDerivatives( jelem, buffer );
+    der_start.push_back( active_der.size() );
+  }
+  gathered_der=NULL;
 }
 
+void StoreDataVessel::compressDerivatives( const unsigned& jelem, const std::vector<double>& buffer ) {
+  const std::vector<unsigned>& der_index( *gathered_der );
+  unsigned nder=der_index[jelem], kder = getNumberOfStoredValues() + jelem * ( nspace - 1 );
+  plumed_dbg_assert( nder<nspace );
+  for(unsigned j=0; j<nder; ++j) active_der.push_back( der_index[kder+j] );
+  for(unsigned icomp=0; icomp<vecsize; ++icomp) {
+    unsigned ibuf = bufstart + jelem * ( vecsize*nspace ) + icomp*nspace + 1;
+    for(unsigned j=0; j<nder; ++j) local_derivs.push_back( buffer[ibuf+j] );
+  }
+}
 
 void StoreDataVessel::setActiveValsAndDerivatives( const std::vector<unsigned>& der_index ) {
-  if( !getAction()->lowmem && getAction()->derivativesAreRequired() ) {
-    for(unsigned i=0; i<der_index.size(); ++i) active_der[i]=der_index[i];
-  }
+  // The list is only read in finish, when the non-zero values are known
+  if( !getAction()->lowmem && getAction()->derivativesAreRequired() ) gathered_der=&der_index;
 }
 
 void StoreDataVessel::resizeTemporyMultiValues( const unsigned& nvals ) {
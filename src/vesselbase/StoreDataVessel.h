@@ -25,6 +25,7 @@
 #include <string>
 #include <cstring>
 #include <vector>
+#include <limits>
 #include "Vessel.h"
 
 namespace PLMD {
@@ -41,6 +42,8 @@ second step.
 class StoreDataVessel : public Vessel {
   friend class Moments;
 private:
+/// The slot of a stored value that is not in the compressed store
+  static const unsigned nostore=std::numeric_limits<unsigned>::max();
 /// Do the quantities being stored in here need derivatives
   bool hasderiv;
 /// What is the maximum number of vectors we are going to
@@ -50,12 +53,24 @@ private:
   unsigned vecsize;
 /// The amount of data per vector element
   unsigned nspace;
-/// The currently active values
-//  std::vector<unsigned> active_val;
-/// The active derivative elements
-  std::vector<unsigned> active_der;
-/// The buffer
-  std::vector<double> local_buffer;
+/// The size of the list of active derivatives that is gathered while the tasks are run
+  unsigned der_list_size;
+/// The list of active derivatives that was gathered while the tasks were run
+  const std::vector<unsigned>* gathered_der;
+/// Only the non-zero values are kept after the calculation, so that the
+/// memory used scales with the number of these values rather than with the number of tasks.
+/// store_slot gives the position of each stored value in the compressed store (or nostore)
+/// and slot_elem the index in the store of each value in the compressed store
+  std::vector<unsigned> store_slot, slot_elem;
+/// The values (vecsize for each element in the compressed store)
+  std::vector<double> local_values;
+/// The indices of the active derivatives of element k of the compressed store are in active_der
+/// from der_start[k] to der_start[k+1], the derivatives of component icomp with respect to these
+/// are in local_derivs from vecsize*der_start[k]+icomp*(der_start[k+1]-der_start[k])
+  std::vector<unsigned> der_start, active_der;
+  std::vector<double> local_derivs;
+/// The derivatives of the jelem th value are copied into the compressed store
+  void compressDerivatives( const unsigned& jelem, const std::vector<double>& buffer );
 /// The actions that are going to use the stored data
   std::vector<ActionWithVessel*> userActions;
 /// We create a vector of tempory MultiValues here so as to avoid
@@ -76,15 +91,15 @@ protected:
   void storeValues( const unsigned&, MultiValue&, std::vector<double>& ) const ;
 /// This stores the data we get from the calculation
   void storeDerivatives( const unsigned&, MultiValue& myvals, std::vector<double>&, std::vector<unsigned>& ) const ;
-/// Get the ibuf'th local derivative value
-  double getLocalDerivative( const unsigned& ibuf );
-/// Set the ibuf'th local derivative value
-  void setLocalDerivative( const unsigned& ibuf, const double& val );
 public:
   static void registerKeywords( Keywords& keys );
   explicit StoreDataVessel( const VesselOptions& );
 /// Get the number of values that have been stored
   virtual unsigned getNumberOfStoredValues() const ;
+/// Get the number of stored values that are not zero
+  unsigned getNumberOfNonZeroValues() const ;
+/// Get the index in the store of the kth value that is not zero
+  unsigned getNonZeroValueIndex( const unsigned& k ) const ;
 /// Get the index to store a particular index inside
   unsigned getStoreIndex( const unsigned& ) const ;
 /// Get the true index of a quantity from the index it is stored in
@@ -103,6 +118,8 @@ public:
   double retrieveWeightWithIndex( const unsigned& myelem ) const ;
 /// Get the derivatives for one of the components in the vector
   void retrieveDerivatives( const unsigned& myelem, const bool& normed, MultiValue& myvals );
+/// Get the derivatives for the jelem th stored value, without searching for its position in the store
+  void retrieveSequentialDerivatives( const unsigned& jelem, const bool& normed, MultiValue& myvals );
 /// Do all resizing of data
   void resize() override;
 ///
@@ -153,12 +170,23 @@ bool StoreDataVessel::storedValueIsActive( const unsigned& iatom ) const {
   if( !getAction()->taskIsCurrentlyActive( iatom ) ) return false;
   unsigned jatom = getStoreIndex( iatom );
   plumed_dbg_assert( jatom<getNumberOfStoredValues() );
-  return local_buffer[jatom*vecsize*nspace]>epsilon;
+  return store_slot[jatom]!=nostore && local_values[store_slot[jatom]*vecsize]>epsilon;
 }
 
 inline
 unsigned StoreDataVessel::getSizeOfDerivativeList() const {
-  return active_der.size();
+  return der_list_size;
+}
+
+inline
+unsigned StoreDataVessel::getNumberOfNonZeroValues() const {
+  return slot_elem.size();
+}
+
+inline
+unsigned StoreDataVessel::getNonZeroValueIndex( const unsigned& k ) const {
+  plumed_dbg_assert( k<slot_elem.size() );
+  return slot_elem[k];
 }
 
 inline
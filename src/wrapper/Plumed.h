@@ -593,6 +593,21 @@ typedef struct {
   void (*handler)(void*,int,const char*,const void*);
 } plumed_nothrow_handler;
 
+/**
+  \brief Handle to a command resolved with \ref plumed_cmd_resolve. Available as of PLUMED 2.7
+
+  Commands executed through a handle are dispatched without any string parsing or memory
+  allocation within PLUMED. If the kernel cannot resolve the command (e.g. because it is
+  older than 2.7, because the command contains more than one word or because it needs further words,
+  as "GREX" or "checkAction") index is set to -1 and the handle falls back to the usual \ref plumed_cmd using key.
+*/
+typedef struct {
+  /** The key used to resolve the command. It is not copied, so it should remain valid as long as the handle is used. */
+  const char* key;
+  /** Index of the command within the kernel. -1 if the command could not be resolved. */
+  int index;
+} plumed_cmd_handle;
+
 /** \relates plumed
     \brief Constructor
 
@@ -774,6 +789,48 @@ __PLUMED_WRAPPER_C_BEGIN
 void plumed_cmd_nothrow(plumed p,const char*key,const void*val,plumed_nothrow_handler nothrow);
 __PLUMED_WRAPPER_C_END
 
+/** \relates plumed
+    \brief Resolve a command once, so that it can be executed many times with \ref plumed_cmd_resolved. Available as of PLUMED 2.7
+
+    This is meant for commands called at every step (e.g. "setPositions", "setForces", or "calc").
+    Only commands made of a single word, and that do not need further words, can be resolved. The returned handle should only be used
+    with the object p (or with other objects using the same kernel).
+
+\verbatim
+    plumed_cmd_handle setPositions=plumed_cmd_resolve(p,"setPositions");
+    plumed_cmd_handle calc=plumed_cmd_resolve(p,"calc");
+    for(step=0;step<nsteps;step++){
+      ...
+      plumed_cmd_resolved(p,setPositions,pos);
+      plumed_cmd_resolved(p,calc,NULL);
+    }
+\endverbatim
+
+    \param p The plumed object
+    \param key The name of the command. Not copied, so it should remain valid as long as the handle is used
+    \return A handle that can be passed to \ref plumed_cmd_resolved
+*/
+
+__PLUMED_WRAPPER_C_BEGIN
+plumed_cmd_handle plumed_cmd_resolve(plumed p,const char*key);
+__PLUMED_WRAPPER_C_END
+
+/** \relates plumed
+    \brief Same as \ref plumed_cmd, but using a command resolved with \ref plumed_cmd_resolve. Available as of PLUMED 2.7
+*/
+
+__PLUMED_WRAPPER_C_BEGIN
+void plumed_cmd_resolved(plumed p,plumed_cmd_handle h,const void*val);
+__PLUMED_WRAPPER_C_END
+
+/** \relates plumed
+    \brief Same as \ref plumed_cmd_nothrow, but using a command resolved with \ref plumed_cmd_resolve. Available as of PLUMED 2.7
+*/
+
+__PLUMED_WRAPPER_C_BEGIN
+void plumed_cmd_resolved_nothrow(plumed p,plumed_cmd_handle h,const void*val,plumed_nothrow_handler nothrow);
+__PLUMED_WRAPPER_C_END
+
 /** \relates plumed
     \brief Destructor.
 
@@ -1738,6 +1795,40 @@ Plumed(Plumed&&p)__PLUMED_WRAPPER_CXX_NOEXCEPT :
     if(h.code!=0) rethrow(h);
   }
 
+  /**
+     Handle to a resolved command. See \ref plumed_cmd_handle.
+  */
+  typedef plumed_cmd_handle CmdHandle;
+
+  /**
+     Resolve a command once, so that it can be executed many times with cmd(const CmdHandle&,const void*)
+      \param key The name of the command. Not copied, so it should remain valid as long as the handle is used
+      \note Similar to \ref plumed_cmd_resolve().
+  */
+  CmdHandle resolve(const char*key) const __PLUMED_WRAPPER_CXX_NOEXCEPT {
+    return plumed_cmd_resolve(main,key);
+  }
+
+  /**
+     Send a resolved command to this plumed object
+      \param h The handle returned by resolve()
+      \param val The argument
+      \note Similar to \ref plumed_cmd_resolved(). It actually called \ref plumed_cmd_resolved_nothrow() and
+            rethrow any exception raised within PLUMED.
+  */
+  void cmd(const CmdHandle&h,const void*val=NULL) {
+    NothrowHandler nh;
+    nh.code=0;
+    plumed_nothrow_handler nothrow= {&nh,nothrow_handler};
+    try {
+      plumed_cmd_resolved_nothrow(main,h,val,nothrow);
+    } catch (...) {
+      /* See cmd(const char*,const void*) */
+      rethrow();
+    }
+    if(nh.code!=0) rethrow(nh);
+  }
+
   /**
      Destructor
 
@@ -1969,6 +2060,12 @@ typedef struct {
   is very risky since and object created in that way would not report any error if manipulated from the C interface.
   So, it looks like this is the only possibility.
 
+  version=3, cmd_resolve, cmd_resolved, and cmd_resolved_nothrow.
+
+  These functions allow a command to be resolved once and then executed many times without
+  any string parsing or memory allocation. This could not be done by adding cmd strings, since
+  the cost to be removed is the parsing of the string itself.
+
 */
 typedef struct {
   /**
@@ -1989,6 +2086,24 @@ typedef struct {
     Available with version>=2.
   */
   void (*cmd_nothrow)(void*plumed,const char*key,const void*val,plumed_nothrow_handler);
+  /**
+    Pointer to a function resolving a command. Returns -1 if the command cannot be resolved.
+
+    Available with version>=3.
+  */
+  int (*cmd_resolve)(void*plumed,const char*key);
+  /**
+    Pointer to a function executing a resolved command.
+
+    Available with version>=3.
+  */
+  void (*cmd_resolved)(void*plumed,int index,const void*val);
+  /**
+    Pointer to a function executing a resolved command, guaranteed not to throw exceptions.
+
+    Available with version>=3.
+  */
+  void (*cmd_resolved_nothrow)(void*plumed,int index,const void*val,plumed_nothrow_handler);
 } plumed_symbol_table_type;
 
 /* Utility to convert function pointers to pointers, just for the sake of printing them */
@@ -2527,6 +2642,57 @@ void plumed_cmd_nothrow(plumed p,const char*key,const void*val,plumed_nothrow_ha
 }
 __PLUMED_WRAPPER_C_END
 
+__PLUMED_WRAPPER_C_BEGIN
+plumed_cmd_handle plumed_cmd_resolve(plumed p,const char*key) {
+  plumed_implementation* pimpl;
+  plumed_cmd_handle h;
+  h.key=key;
+  h.index=-1;
+  /* obtain pimpl */
+  pimpl=(plumed_implementation*) p.p;
+  assert(plumed_check_pimpl(pimpl));
+  /* invalid objects and kernels <2.7 use the fallback */
+  if(pimpl->p && pimpl->table && pimpl->table->version>2) h.index=(*(pimpl->table->cmd_resolve))(pimpl->p,key);
+  return h;
+}
+__PLUMED_WRAPPER_C_END
+
+__PLUMED_WRAPPER_C_BEGIN
+void plumed_cmd_resolved(plumed p,plumed_cmd_handle h,const void*val) {
+  plumed_implementation* pimpl;
+  if(h.index<0) {
+    plumed_cmd(p,h.key,val);
+    return;
+  }
+  /* obtain pimpl */
+  pimpl=(plumed_implementation*) p.p;
+  assert(plumed_check_pimpl(pimpl));
+  /* a resolved handle implies a valid object with a kernel >=2.7 */
+  assert(pimpl->p);
+  assert(pimpl->table && pimpl->table->version>2);
+  /* execute */
+  (*(pimpl->table->cmd_resolved))(pimpl->p,h.index,val);
+}
+__PLUMED_WRAPPER_C_END
+
+__PLUMED_WRAPPER_C_BEGIN
+void plumed_cmd_resolved_nothrow(plumed p,plumed_cmd_handle h,const void*val,plumed_nothrow_handler nothrow) {
+  plumed_implementation* pimpl;
+  if(h.index<0) {
+    plumed_cmd_nothrow(p,h.key,val,nothrow);
+    return;
+  }
+  /* obtain pimpl */
+  pimpl=(plumed_implementation*) p.p;
+  assert(plumed_check_pimpl(pimpl));
+  /* a resolved handle implies a valid object with a kernel >=2.7 */
+  assert(pimpl->p);
+  assert(pimpl->table && pimpl->table->version>2);
+  /* execute */
+  (*(pimpl->table->cmd_resolved_nothrow))(pimpl->p,h.index,val,nothrow);
+}
+__PLUMED_WRAPPER_C_END
+
 
 
 __PLUMED_WRAPPER_C_BEGIN